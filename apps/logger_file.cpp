@@ -18,18 +18,38 @@ void signal_interrupt_handler(int) {
 
 int main(int arg_c, char **arg_v){
     if(arg_c < 2){
-        std::cout << " Usage : " << arg_v[0] << " <log filename> [binding addr:port]\n";
+        std::cout << " Usage : " << arg_v[0] << " <log filename> [binding addr:port] [segment MB] [rotate s] [fsync s]\n";
+        std::cout << "   with a segment size the log goes to mmap'd segments <log filename>.NNNNNN.log\n";
     }
     std::string filename("logger_file.log");
     std::string frontend("tcp://127.0.0.1:40000");
+    double segment_mb = 0, rotate_s = 3600, fsync_s = 1.0;
+    if(arg_c >= 6)
+        fsync_s = atof(arg_v[5]);
+    if(arg_c >= 5)
+        rotate_s = atof(arg_v[4]);
+    if(arg_c >= 4)
+        segment_mb = atof(arg_v[3]);
     if(arg_c >= 3)
         frontend = std::string(arg_v[2]);
     if(arg_c >= 2)
         filename = std::string(arg_v[1]);
-    std::fstream fout{filename, fout.binary | fout.trunc | fout.in | fout.out};
+    log_sink sink = nullptr;
+    std::fstream fout;
+    if(segment_mb > 0){
+        sink = log_sink_create(filename.c_str(), (uint64_t)(segment_mb*1024*1024), rotate_s, fsync_s);
+        if(sink == nullptr){
+            std::cout << "could not open log segment " << filename << std::endl;
+            return 1;
+        }
+    }
+    else{
+        fout.open(filename, fout.binary | fout.trunc | fout.in | fout.out);
+    }
     std::signal(SIGINT, &signal_interrupt_handler);
     std::cout << "Starting the logger server -- spinning up workers\n";
-    logger_server log_s("",fout,frontend,"tcp://127.0.1.1:40001");
+    logger_server log_s("",(sink) ? std::cout : fout,frontend,"tcp://127.0.1.1:40001");
+    log_s.set_sink(sink);
     log_s << logger::set_level(logger::INFO) << "logger server -- started\n";
     log_s.commit();log_s.flush();
 
@@ -48,10 +68,12 @@ int main(int arg_c, char **arg_v){
     }
 
     log_s << logger::set_level(logger::INFO) << "Stopping the logger server workers\n";
-    log_s.commit();log_s.flush();
+    log_s.commit();log_s.flush_all();
     log_s.stop();
     std::cout << "logger server -- stopped\n";
     log_s.wait();
+    log_s.set_sink(nullptr);
+    log_sink_destroy(&sink);
     std::cout << "logger server -- finished\n";
 
     return 0;
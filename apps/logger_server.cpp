@@ -47,7 +47,7 @@ int main(int arg_c, char **arg_v){
     }
 
     log_s << logger::set_level(logger::INFO) << "Stopping the logger server workers\n";
-    log_s.commit();log_s.flush();
+    log_s.commit();log_s.flush_all();
     log_s.stop();
     std::cout << "logger server -- stopped\n";
     log_s.wait();
@@ -260,7 +260,7 @@ int main (int argc, char **argv)
         if(wav_reader_set_offset(wav, wav_offset)){throw std::runtime_error("Something is wrong.");}
         // counter = 0;
         printf("Starting file position: %lu/%lu   %lf\n",
-            wav_reader_get_offset(wav)-cbufferf_max_size(wav->buffer)/2,
+            wav_reader_get_offset(wav),
             wav_samples,
             get_time());
         gen_peek = (void*)wav_source_create(MONO, wav, 20000);
@@ -0,0 +1,99 @@
+// render scenario files to IQ and labels offline, many at once
+#include <getopt.h>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <exception>
+
+#include "batch.hh"
+
+double get_time(){
+    return std::chrono::system_clock::now().time_since_epoch().count()*double(1e-9);
+}
+
+int main (int argc, char **argv)
+{
+    srand(std::random_device()());
+    std::string  out_dir{"."};
+    std::string  list_file{""};
+    unsigned int num_workers = 0;       // 0 uses all cores
+    double       duration    = -1.0;    // overrides the scenarios' if > 0
+    uint8_t      dry_run     = 0;
+
+    int dopt;
+    char *strend = NULL;
+    while ((dopt = getopt(argc,argv,"ho:l:P:d:z:")) != EOF) {
+        switch (dopt) {
+        case 'h':
+            printf("Usage of %s [options] <scenario.json> ...\n",argv[0]);
+            printf("  [ -o <out_dir:%s> ] [ -l <list of scenario files:%s> ]\n", out_dir.c_str(), list_file.c_str());
+            printf("  [ -P <workers:%u> ] [ -d <duration override:%.3f s> ] [ -z <dry_run:%u> ]\n", num_workers, duration, dry_run);
+            printf("  writes <out_dir>/<name>.cf32 and <out_dir>/<name>_truth.json per scenario\n");
+            return 0;
+        case 'o': out_dir       .assign(optarg); break;
+        case 'l': list_file     .assign(optarg); break;
+        case 'P': num_workers = strtoul(optarg, &strend, 10); break;
+        case 'd': duration    =  strtod(optarg, &strend); break;
+        case 'z': dry_run     = strtoul(optarg, &strend, 10); break;
+        default: exit(1);
+        }
+    }
+
+    std::vector<std::string> paths(argv + optind, argv + argc);
+    if (!list_file.empty()) {
+        std::ifstream list(list_file);
+        if (!list) {
+            std::cerr << "could not open " << list_file << "\n";
+            return 1;
+        }
+        std::string line;
+        while (std::getline(list, line))
+            if (!line.empty() && line[0] != '#')
+                paths.push_back(line);
+    }
+    if (paths.empty()) {
+        std::cerr << "no scenario files given, see -h\n";
+        return 1;
+    }
+
+    // parse everything up front, a bad file is skipped and reported
+    double t_start = get_time();
+    std::vector<batch_job> jobs;
+    size_t num_bad = 0;
+    for (auto &path: paths) {
+        try {
+            jobs.push_back(batch_job_load(path, out_dir));
+            if (duration > 0)
+                jobs.back().config.duration = duration;
+        }
+        catch (std::exception &e) {
+            std::cerr << e.what() << "\n";
+            num_bad++;
+        }
+    }
+    double total_time = 0.0;
+    for (auto &job: jobs)
+        total_time += job.config.duration;
+
+    printf("Using:\n");
+    printf("  scenarios:    %zu (%zu unusable)\n", jobs.size(), num_bad);
+    printf("  signal:       %.3f s\n", total_time);
+    printf("  out_dir:      %s\n", out_dir.c_str());
+    printf("  workers:      %u\n", num_workers);
+
+    if(dry_run == 1){
+        return 0;
+    }
+
+    batch_stats stats = batch_render(jobs, num_workers);
+    double elapsed = get_time() - t_start;
+    printf("rendered %zu of %zu scenarios (%zu failed) in %.3f s, %.1fx real time\n",
+        stats.rendered, jobs.size(), stats.failed, elapsed, total_time/elapsed);
+    printf("  scenes reused: %zu, jobs stolen: %zu\n", stats.reused, stats.stolen);
+    return (stats.failed || num_bad) ? 1 : 0;
+}
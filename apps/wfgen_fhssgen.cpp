@@ -1,4 +1,4 @@
-// pre-generated FH/SS signal, transmitted on repeat
+// pre-generated FH/SS signal, transmitted on repeat or regenerated per loop
 #include <getopt.h>
 #include <math.h>
 #include <iostream>
@@ -8,6 +8,10 @@
 #include <csignal>
 #include <vector>
 #include <random>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <uhd/usrp/multi_usrp.hpp>
 
 #include "liquid.h"
@@ -15,25 +19,32 @@
 #include "fskmodems.hh"
 #include "afmodem.hh"
 #include "noisemodem.hh"
+#include "chansynth.hh"
+#include "iq_gain.hh"
+#include "generator.hh"
 #include "writer.hh"
+#include "block_stream.hh"
+
+using namespace wfgen::generators;
 
 
 // primitive burst definition
 struct burst {
     float fc, bw, t0, dur;
+    unsigned int active;    // samples written from the start of the hop, the rest is silent
     uint8_t type;
     modulation_scheme ms;
     fsk_scheme ms_f;
     analog_scheme ms_a;
     noise_scheme ms_n;
     burst(float _fc, float _bw, float _t0, float _dur, modulation_scheme _ms) :
-        fc(_fc), bw(_bw), t0(_t0), dur(_dur), type(0), ms(_ms) {}
+        fc(_fc), bw(_bw), t0(_t0), dur(_dur), active(0), type(0), ms(_ms) {}
     burst(float _fc, float _bw, float _t0, float _dur, fsk_scheme _ms) :
-        fc(_fc), bw(_bw), t0(_t0), dur(_dur), type(1), ms_f(_ms) {}
+        fc(_fc), bw(_bw), t0(_t0), dur(_dur), active(0), type(1), ms_f(_ms) {}
     burst(float _fc, float _bw, float _t0, float _dur, analog_scheme _ms) :
-        fc(_fc), bw(_bw), t0(_t0), dur(_dur), type(2), ms_a(_ms) {}
+        fc(_fc), bw(_bw), t0(_t0), dur(_dur), active(0), type(2), ms_a(_ms) {}
     burst(float _fc, float _bw, float _t0, float _dur, noise_scheme _ms) :
-        fc(_fc), bw(_bw), t0(_t0), dur(_dur), type(3), ms_n(_ms) {}
+        fc(_fc), bw(_bw), t0(_t0), dur(_dur), active(0), type(3), ms_n(_ms) {}
     void print() {
         if(type==0)
             printf("  fc:%9.3f MHz, bw:%9.3f kHz, t0:%9.3f ms, dur:%9.3f ms, mod=%s\n",
@@ -51,48 +62,77 @@ struct burst {
 };
 
 // generate a hop of a particular bandwidth and center frequency
-// void generate_hop(float fc, std::complex<float> * buf, unsigned int buf_len,
-//         symstreamrcf gen, nco_crcf mixer);
-void generate_hop2(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamrcf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch);
-void generate_hop2(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamracf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch);
-void generate_hop3(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamrncf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch);
-
-// generate a hop of a particular bandwidth and center frequency
-// void generate_hop(float fc, std::complex<float> * buf, unsigned int buf_len,
-//         symstreamrfcf gen, nco_crcf mixer);
-void generate_hop2(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamrfcf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch);
-void generate_hop3(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamrfcf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch);
+template<class D>
+unsigned int generate_hop(float fc, std::complex<float> * buf, unsigned int buf_len,
+        generator<D> & gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch, bool sparse);
 
 // generate a sequence of hops
 std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
         std::complex<float> * buf, float center_freq=0.0f, float sample_rate=1.0f,
         modulation_scheme ms = LIQUID_MODEM_QPSK, bool sweep=false,
-        float span=0.9, int num_channels=0, unsigned int dwell = 0, unsigned int squelch = 0);
+        float span=0.9, int num_channels=0, unsigned int dwell = 0, unsigned int squelch = 0,
+        float * peak = nullptr, bool sparse = false);
 std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
         std::complex<float> * buf, float center_freq=0.0f, float sample_rate=1.0f,
         fsk_scheme ms = LIQUID_MODEM_FSK4, bool sweep=false,
         float span=0.9, int num_channels=0, unsigned int dwell = 0, unsigned int squelch = 0,
-        unsigned int k=2, double mod_index=1.0, unsigned int cpf_type=0);
+        unsigned int k=2, double mod_index=1.0, unsigned int cpf_type=0, float * peak = nullptr,
+        bool sparse = false);
 std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
         std::complex<float> * buf, float center_freq=0.0f, float sample_rate=1.0f,
         analog_scheme ms = LIQUID_ANALOG_FM_WAV_FILE, bool sweep=false,
         float span=0.9, int num_channels=0, unsigned int dwell = 0, unsigned int squelch = 0,
-        double mod_index=-1.0, double src_freq=0.2);
+        double mod_index=-1.0, double src_freq=0.2, float * peak = nullptr,
+        bool sparse = false);
 std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
         std::complex<float> * buf, float center_freq=0.0f, float sample_rate=1.0f,
         noise_scheme ms = LIQUID_NOISE_AWGN, bool sweep=false,
-        float span=0.9, int num_channels=0, unsigned int dwell = 0, unsigned int squelch = 0);
+        float span=0.9, int num_channels=0, unsigned int dwell = 0, unsigned int squelch = 0,
+        float * peak = nullptr, bool sparse = false);
+
+// Every sequence reports the largest |I|/|Q| it wrote through peak (see
+// iq_gain.hh); the buffer itself is left unscaled for the send stage.
+// A sparse sequence writes each hop only up to the end of its flushed
+// on-time, recorded as the burst's active length, and leaves the silence
+// after it to the send stage.
+
+// channelized sequences: emitters hop at once over num_channels channels,
+// synthesized together by a polyphase filterbank instead of mixed one by one
+unsigned int channelizer_size(float span, int num_channels);
+std::vector<burst> generate_channelized(float bw, unsigned int hop_dur, unsigned int num_hops,
+        std::complex<float> * buf, float center_freq, float sample_rate, modulation_scheme ms,
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        unsigned int emitters, float * peak);
+std::vector<burst> generate_channelized(float bw, unsigned int hop_dur, unsigned int num_hops,
+        std::complex<float> * buf, float center_freq, float sample_rate, noise_scheme ms,
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        unsigned int emitters, float * peak);
 
 void export_json(labels *reporter, std::vector<burst> bursts,
         double start, double loop_time,
         double center_freq, double sample_rate,
         uint64_t meant_to_send, uint64_t sent);
 
+// Samples go out in chunks of FHSS_SEND_CHUNK, converted to sc16 on the
+// way; silence is sent straight from one shared page of zeros.
+#define FHSS_SEND_CHUNK 4000
+static const int16_t zero_page[2*FHSS_SEND_CHUNK] = {0};
+
+// send n samples as part of the burst in md, see below
+size_t send_span(uhd::tx_streamer::sptr tx_stream, uhd::tx_metadata_t &md,
+        const std::complex<float> * buf, size_t n, float gain, bool eob,
+        std::vector<int16_t> &sc16);
+
+// A block of hops for block_stream: while one block is sent the next ones
+// are synthesized, each with fresh hop frequencies and symbols, so the
+// transmission never repeats.
+struct hop_block {
+    std::vector<std::complex<float> > samples;
+    std::vector<burst> bursts;
+    float gain;         // applied on send
+};
+typedef block_stream<hop_block> hop_stream;
+
 static bool continue_running(true);
 void signal_interrupt_handler(int) {
     std::cout << "FHSSGEN ---> ctrl+c received --> exiting\n";
@@ -131,12 +171,17 @@ int main (int argc, char **argv)
     float dwell              = -1;
     float squelch            = -1;
     std::string  json{""};
+    std::string  json_bin{""};
+    std::string  json_index{""};
     std::string file_dump{""};
     modulation_scheme ms = LIQUID_MODEM_QPSK;
     fsk_scheme ms_f = LIQUID_FSK_UNKNOWN;
     analog_scheme ms_a = LIQUID_ANALOG_UNKNOWN;
     noise_scheme ms_n = LIQUID_NOISE_AWGN;
     uint8_t     cut_radio   =   0;
+    unsigned int regen_blocks = 0;      // blocks to synthesize ahead, 0 repeats one block
+    unsigned int emitters    =  0;      // simultaneous channelized hoppers, 0 mixes each hop
+    float        sparse_gap  = -1;      // shortest silence sent as a burst gap [s], <0 sends every sample
 
     const int max_chrono = 10;
     double chrono_time[max_chrono];
@@ -147,7 +192,7 @@ int main (int argc, char **argv)
     uint8_t analog_hop(0),digital_hop(1);
     int dopt;
     char *strend = NULL;
-    while ((dopt = getopt(argc,argv,"hf:r:g:a:M:b:B:d:p:J:K:x:R:H:w:q:s:k:S:l:L:j:W:C:P:F:")) != EOF) {
+    while ((dopt = getopt(argc,argv,"hf:r:g:a:M:b:B:d:p:J:K:x:R:H:w:q:s:k:S:l:L:j:T:X:W:C:P:F:G:E:Z:")) != EOF) {
         switch (dopt) {
         case 'h':
             printf("Usage of %s [options]\n",argv[0]);
@@ -159,7 +204,13 @@ int main (int argc, char **argv)
             printf("  [ -q <squelch:%.3f s> ] [ -s <span:%.3f MHz> ] [ -k <num_channels:%u> ]\n", squelch, span*1.0e-06, num_channels);
             printf("  [ -S <sweep:%u> ] [ -l <num_loops:%u> ] [ -L <loop_delay:%.3f s> ]\n", sweep, num_loops, loop_delay);
             printf("  [ -j <json:%s> ] [ -W <file_dump:%s> ] [ -C <cut_radio:%u> ]\n", json.c_str(), file_dump.c_str(), cut_radio);
-            printf("  [ -P <cpf_type:%d> ] [ -F <src_fq:%.3f MHz> ]\n", cpf_type, src_fq);
+            printf("  [ -P <cpf_type:%d> ] [ -F <src_fq:%.3f MHz> ] [ -T <binary labels:%s> ]\n", cpf_type, src_fq, json_bin.c_str());
+            printf("  [ -X <burst index:%s> ] [ -G <regen_blocks:%u> ]\n", json_index.c_str(), regen_blocks);
+            printf("  [ -E <emitters:%u> ] [ -Z <sparse_gap:%.3f s> ]\n", emitters, sparse_gap);
+            printf("  -G 2 or 3 regenerates the hops every loop, synthesizing ahead into that many buffers\n");
+            printf("  -E <n> with -k hops n emitters at once over the channels, through a synthesis filterbank\n");
+            printf("  -Z <gap> sends only the on-time of each hop: silences of at least gap seconds end the\n");
+            printf("     burst and the next hop starts a timed one, shorter ones are sent as zeros\n");
             printf(" available modulation schemes:\n");
             liquid_print_modulation_schemes();
             liquid_print_fsk_modulation_schemes();
@@ -205,10 +256,15 @@ int main (int argc, char **argv)
         case 'l': num_loops   = strtoul(optarg, &strend, 10); break;
         case 'L': loop_delay  =  strtod(optarg, &strend); break;
         case 'j': json          .assign(optarg); break;
+        case 'T': json_bin      .assign(optarg); break;
+        case 'X': json_index    .assign(optarg); break;
         case 'W': file_dump     .assign(optarg); break;
         case 'C': cut_radio   = strtoul(optarg, &strend, 10); break;
         case 'P': cpf_type    =  strtol(optarg, &strend, 10); break;
         case 'F': src_fq      =  strtod(optarg, &strend); break;
+        case 'G': regen_blocks= strtoul(optarg, &strend, 10); break;
+        case 'E': emitters    = strtoul(optarg, &strend, 10); break;
+        case 'Z': sparse_gap  =  strtod(optarg, &strend); break;
         default: exit(1);
         }
 }
@@ -453,6 +509,29 @@ int main (int argc, char **argv)
     //
     printf("hop_dur:%u, bw:%.6f\n", hop_dur, bw_nr);
 
+    // channelized hops are whole channel samples long
+    if (emitters > 0) {
+        if (num_channels <= 0 || (int)emitters > num_channels) {
+            fprintf(stderr,"error: %s, -E <emitters> needs -k <num_channels> of at least as many channels\n",argv[0]);
+            return 1;
+        }
+        if (ms == LIQUID_MODEM_UNKNOWN && ms_n == LIQUID_NOISE_UNKNOWN) {
+            printf("warn: %s, channelized hopping is only for linear modulations and noise, mixing one hop at a time\n",argv[0]);
+            emitters = 0;
+        }
+        else {
+            unsigned int interp = channelizer_size(span, num_channels)/2;
+            hop_dur = std::max(1U, hop_dur/interp)*interp;
+            printf("channelized: %u emitters over %u of %u filterbank channels, hop_dur:%u\n",
+                emitters, num_channels, 2*interp, hop_dur);
+        }
+    }
+    if (emitters > 0 && sparse_gap >= 0) {
+        printf("warn: %s, channelized hops overlap in time and are sent whole\n",argv[0]);
+        sparse_gap = -1;
+    }
+    bool sparse = sparse_gap >= 0;
+
     // generate sequence
     unsigned long int num_samples = hop_dur * num_bursts;
 
@@ -460,42 +539,43 @@ int main (int argc, char **argv)
     std::vector<std::complex<float> > usrp_buffer(num_samples);
 
     // generate sequence and get labels
-    std::vector<burst> bursts;
-    if(ms == LIQUID_MODEM_UNKNOWN && ms_f == LIQUID_FSK_UNKNOWN && ms_a == LIQUID_ANALOG_UNKNOWN && ms_n != LIQUID_NOISE_UNKNOWN){
-        //noise
-        bursts = generate_sequence(bw_nr, hop_dur, num_bursts, usrp_buffer.data(), uhd_tx_freq, uhd_tx_rate, ms_n, sweep,
-            span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate);
-    }
-    else if(ms == LIQUID_MODEM_UNKNOWN && ms_a == LIQUID_ANALOG_UNKNOWN && ms_n == LIQUID_NOISE_UNKNOWN){//fskmod or tone
-        bursts = generate_sequence(bw_nr, hop_dur, num_bursts, usrp_buffer.data(), uhd_tx_freq, uhd_tx_rate, ms_f, sweep,
-            span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate,k, mod_index, cpf_type);
-    }
-    else if(ms == LIQUID_MODEM_UNKNOWN && ms_a != LIQUID_ANALOG_UNKNOWN){
-        bursts = generate_sequence(bw_nr, hop_dur, num_bursts, usrp_buffer.data(), uhd_tx_freq, uhd_tx_rate, ms_a, sweep,
-            span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate, mod_index, src_fq/uhd_tx_rate);
-    }
-    else{//linmod
-        bursts = generate_sequence(bw_nr, hop_dur, num_bursts, usrp_buffer.data(), uhd_tx_freq, uhd_tx_rate, ms, sweep,
-            span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate);
-    }
-
-    float maxv= 0.;
-    size_t fail_counter = 0;
-    for(size_t buf_idx = 0; buf_idx < usrp_buffer.size(); buf_idx++){
-        if (std::abs(usrp_buffer[buf_idx].real()) > maxv){
-            maxv = std::abs(usrp_buffer[buf_idx].real());
-            fail_counter++;
+    // The largest |I|/|Q| is tracked hop by hop as the sequence is written
+    // and the gain bringing it to 0.5 is applied by the send stage.
+    auto synthesize = [&](std::complex<float> * buf, float * gain, bool verbose){
+        std::vector<burst> seq;
+        float peak = 0.0f;
+        if(emitters > 0 && ms == LIQUID_MODEM_UNKNOWN){
+            seq = generate_channelized(bw_nr, hop_dur, num_bursts, buf, uhd_tx_freq, uhd_tx_rate, ms_n, sweep,
+                span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate, emitters, &peak);
         }
-        if (std::abs(usrp_buffer[buf_idx].imag()) > maxv){
-            maxv = std::abs(usrp_buffer[buf_idx].imag());
-            fail_counter++;
+        else if(emitters > 0){
+            seq = generate_channelized(bw_nr, hop_dur, num_bursts, buf, uhd_tx_freq, uhd_tx_rate, ms, sweep,
+                span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate, emitters, &peak);
         }
-    }
-    std::cout << "FOUND " << fail_counter << "/" << usrp_buffer.size() << " buffer failures, with a max of " << maxv << std::endl;
-    float fail_scale = 0.5/maxv;
-    for(size_t buf_idx = 0; buf_idx < usrp_buffer.size(); buf_idx++){
-        usrp_buffer[buf_idx] *= fail_scale;
-    }
+        else if(ms == LIQUID_MODEM_UNKNOWN && ms_f == LIQUID_FSK_UNKNOWN && ms_a == LIQUID_ANALOG_UNKNOWN && ms_n != LIQUID_NOISE_UNKNOWN){
+            //noise
+            seq = generate_sequence(bw_nr, hop_dur, num_bursts, buf, uhd_tx_freq, uhd_tx_rate, ms_n, sweep,
+                span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate, &peak, sparse);
+        }
+        else if(ms == LIQUID_MODEM_UNKNOWN && ms_a == LIQUID_ANALOG_UNKNOWN && ms_n == LIQUID_NOISE_UNKNOWN){//fskmod or tone
+            seq = generate_sequence(bw_nr, hop_dur, num_bursts, buf, uhd_tx_freq, uhd_tx_rate, ms_f, sweep,
+                span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate,k, mod_index, cpf_type, &peak, sparse);
+        }
+        else if(ms == LIQUID_MODEM_UNKNOWN && ms_a != LIQUID_ANALOG_UNKNOWN){
+            seq = generate_sequence(bw_nr, hop_dur, num_bursts, buf, uhd_tx_freq, uhd_tx_rate, ms_a, sweep,
+                span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate, mod_index, src_fq/uhd_tx_rate, &peak, sparse);
+        }
+        else{//linmod
+            seq = generate_sequence(bw_nr, hop_dur, num_bursts, buf, uhd_tx_freq, uhd_tx_rate, ms, sweep,
+                span,num_channels,dwell*uhd_tx_rate,squelch*uhd_tx_rate, &peak, sparse);
+        }
+        *gain = iq_gain(peak, 0.5f);
+        if (verbose)
+            std::cout << "peak of " << peak << ", scaled by " << *gain << " on send" << std::endl;
+        return seq;
+    };
+    float gain;
+    std::vector<burst> bursts = synthesize(usrp_buffer.data(), &gain, true);
 
     // for (auto burst_info: bursts)
     //     burst_info.print();
@@ -506,7 +586,9 @@ int main (int argc, char **argv)
         // export output
         std::string fname{"usrp_fhssgen.dat"};
         FILE * fid = fopen(fname.c_str(),"wb");
-        fwrite(usrp_buffer.data(), sizeof(std::complex<float>), hop_dur * num_bursts, fid);
+        std::vector<std::complex<float> > scaled(usrp_buffer.begin(), usrp_buffer.end());
+        for (auto &v: scaled) v *= gain;
+        fwrite(scaled.data(), sizeof(std::complex<float>), hop_dur * num_bursts, fid);
         fclose(fid);
         printf("output written to %s\n", fname.c_str());
         //return 0;
@@ -533,7 +615,7 @@ int main (int argc, char **argv)
     // stream
     std::vector<size_t> channel_nums;
     channel_nums.push_back(0);
-    uhd::stream_args_t stream_args("fc32", "sc16");
+    uhd::stream_args_t stream_args("sc16", "sc16");
     stream_args.channels = channel_nums;
     uhd::tx_streamer::sptr tx_stream = usrp->get_tx_stream(stream_args);
     tx_stream->send("", 0, md);
@@ -547,12 +629,28 @@ int main (int argc, char **argv)
     md.end_of_burst   = false;  // Trying to chunk things up now
     md.has_time_spec  = true;  // set to false to send immediately
 
-    // buffer of buffers? I guess?
-    std::vector<std::complex<float>*> bufs(channel_nums.size(), &usrp_buffer.front());
-    std::vector<std::complex<float>*> buf_ptr(channel_nums.size(), &usrp_buffer.front());
+    // the gain is folded into the conversion of each chunk on its way out
+    std::complex<float> * buf = usrp_buffer.data();
+    std::vector<int16_t> sc16(2*FHSS_SEND_CHUNK);
     std::vector<std::complex<float> > usrp_zeros(tx_stream->get_max_num_samps(), std::complex<float>(0.0f,0.0f));
 
-    // TODO: convert to int16?
+
+    // regenerating mode: the first block goes out as is while the next are
+    // synthesized in the background
+    hop_stream *stream = nullptr;
+    if (regen_blocks > 0) {
+        if (regen_blocks < 2) regen_blocks = 2;
+        // the first block is the one already synthesized
+        std::vector<hop_block> blocks(regen_blocks);
+        for (auto &b: blocks)
+            b.samples.resize(usrp_buffer.size());
+        blocks[0].samples.swap(usrp_buffer);
+        blocks[0].bursts = bursts;
+        blocks[0].gain   = gain;
+        stream = new hop_stream(std::move(blocks), 1,
+            [&](hop_block & b){ b.bursts = synthesize(b.samples.data(), &b.gain, false); });
+        std::cout << "regenerating hops every loop with " << regen_blocks << " buffers\n";
+    }
 
     std::signal(SIGINT, &signal_interrupt_handler);
     std::cout << "running ";
@@ -568,6 +666,10 @@ int main (int argc, char **argv)
     labels* reporter = nullptr;
     if(!json.empty()){
         reporter = new labels(json.c_str(),"TXDL T","TXDL SG1","TXDL S1");
+        if(!json_bin.empty() && !reporter->enable_binary(json_bin))
+            std::cout << "could not open " << json_bin << " for binary labels\n";
+        if(!json_index.empty())
+            reporter->enable_index(json_index);
         reporter->set_modulation( modulation );
         reporter->eng_bw = bw_f;
         reporter->start_reports();
@@ -575,58 +677,60 @@ int main (int argc, char **argv)
     chrono_time[6] = chrono_time[2]-loop_time+0.5;                // 'prev' TX time
     double initial_start = chrono_time[6] + loop_time;
     uint64_t xfer_counter = 0;
-    uint64_t xfer = 0,xfer_idx = 0;
-    size_t xfer_len = 0;
-    size_t chunk_size = 4000;
-    size_t send_size;
+    size_t min_gap = sparse ? (size_t)(sparse_gap*uhd_tx_rate) : 0;
     while (continue_running) {
-        xfer = 0;
-        xfer_idx = 0;
         xfer_counter = 0;
-        xfer_len = usrp_buffer.size();
         md.start_of_burst = true;
+        md.end_of_burst   = false;
         md.has_time_spec  = true;
         chrono_time[6] += loop_time;
-        md.time_spec = uhd::time_spec_t(chrono_time[6]);
 
-        // Reset any shifts in the buffers
-        for(size_t cidx = 0; cidx < channel_nums.size(); cidx++){
-            buf_ptr[cidx] = bufs[cidx];
+        if (stream != nullptr) {
+            hop_block *b = stream->acquire();
+            if (b == nullptr) break;
+            buf = b->samples.data();
+            bursts = b->bursts;
+            gain = b->gain;
+            // a late block is sent as soon as possible instead of in the past
+            if (chrono_time[6] < get_time() + 0.01)
+                chrono_time[6] = get_time() + 0.05;
         }
+        md.time_spec = uhd::time_spec_t(chrono_time[6]);
 
-        while((xfer == 0 && xfer_len > 0) && continue_running){
-            // send the result to the USRP
-            send_size = std::min(xfer_len,chunk_size);
-            if (send_size == xfer_len){
-                md.end_of_burst = true;
-            }
-            xfer = tx_stream->send(buf_ptr, send_size, md); // This blocks?
-            if(xfer <= xfer_len){
-                xfer_counter += xfer;
-                xfer_len -= xfer;
-                xfer_idx += xfer;
-
-                if(xfer_len > 0){
-                    // Not everything was sent, so shift one buffer set into the other (account for what was sent)
-                    for(size_t cidx = 0; cidx < channel_nums.size(); cidx++){
-                        buf_ptr[cidx] = &(bufs[cidx][xfer_idx]);
-                    }
-                }
-
-                xfer = 0;
-                if(md.start_of_burst){
-                    md.start_of_burst = false;
-                    md.has_time_spec  = false;
+        if (!sparse) {
+            xfer_counter = send_span(tx_stream, md, buf, num_samples, gain, true, sc16);
+        }
+        else {
+            // Only the written part of each hop goes out. A silence of at
+            // least min_gap ends the burst and the next hop starts a new one
+            // at its own time; shorter ones are sent as zeros.
+            for (size_t i=0; i<bursts.size() && continue_running; i++) {
+                size_t active = bursts[i].active;
+                size_t gap = hop_dur - active;
+                bool eob = (i+1 == bursts.size()) || (gap > 0 && gap >= min_gap);
+                if (md.start_of_burst)
+                    md.time_spec = uhd::time_spec_t(chrono_time[6] + (double)(i*hop_dur)/uhd_tx_rate);
+                size_t sent = send_span(tx_stream, md, buf + i*hop_dur, active, gain, eob, sc16);
+                if (!eob && gap > 0)
+                    sent += send_span(tx_stream, md, nullptr, gap, gain, false, sc16);
+                // counted as if sent whole, the silence after a burst included
+                xfer_counter += (eob && sent == active) ? hop_dur : sent;
+                if (eob) {
+                    md.start_of_burst = true;
+                    md.end_of_burst   = false;
+                    md.has_time_spec  = true;
                 }
             }
         }
 
         export_json(reporter, bursts, chrono_time[6], loop_time, uhd_tx_freq, uhd_tx_rate,
-                    usrp_buffer.size(), xfer_counter);
+                    num_samples, xfer_counter);
+        if (stream != nullptr)
+            stream->release();
 
         if (!continue_running){/// might have stopped before a loop finished
             std::cout << "Got to stop running with " << xfer_counter << " samples out of "
-                << usrp_buffer.size() << " samples in the buffer\n";
+                << num_samples << " samples in the buffer\n";
         }
 
         // check early exit criterion
@@ -645,6 +749,10 @@ int main (int argc, char **argv)
         // }
     }
     continue_running = false;
+    if (stream != nullptr) {
+        std::cout << "hop synthesis fell behind " << stream->underruns() << " times\n";
+        delete stream;
+    }
  
     // send a mini EOB packet
     md.start_of_burst = false;
@@ -712,255 +820,20 @@ int main (int argc, char **argv)
     return 0;
 }
 
-// // generate a hop of a particular bandwidth and center frequency
-// void generate_hop(float fc, std::complex<float> * buf, unsigned int buf_len,
-//         symstreamrcf gen, nco_crcf mixer)
-// {
-//     auto delay = symstreamrcf_get_delay(gen);
-//
-//     unsigned int dead_time = (unsigned int) (delay + 1.5f);
-//
-//     // check values
-//     if (buf_len < 2*dead_time)
-//         throw std::runtime_error("requested hop duration too small");
-//
-//     // fill buffer
-//     unsigned int num_samples_on = buf_len - 2*dead_time;
-//
-//     symstreamrcf_set_gain(gen, 0.5f);
-//     symstreamrcf_write_samples(gen, buf, num_samples_on);
-//     symstreamrcf_set_gain(gen, 0.0f);
-//     symstreamrcf_write_samples(gen, buf + num_samples_on, 2*dead_time);
-//
-//     // mix
-//     nco_crcf_set_frequency(mixer, 2*M_PI*fc);
-//     nco_crcf_mix_block_up(mixer, buf, buf, buf_len);
-// }
-
-// generate a hop of a particular bandwidth and center frequency
-void generate_hop2(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamrcf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch)
+// generate a hop of a particular bandwidth and center frequency; returns
+// the number of samples written, all of buf unless sparse
+template<class D>
+unsigned int generate_hop(float fc, std::complex<float> * buf, unsigned int buf_len,
+        generator<D> & gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch, bool sparse)
 {
-    auto delay = symstreamrcf_get_delay(gen);
-    unsigned int dead_time = (unsigned int) (delay + 1.5f);
-
-    // buf_len is the hop_duration
-    if (dwell == 0){
-        squelch = 0;
-        dwell = buf_len - 2*dead_time;
-    }
-    if (dwell > buf_len - 2*dead_time){
-        dwell = buf_len - 2*dead_time;
-    }
-
-    unsigned int num_samples_on = dwell;
-    dead_time = (2*dead_time > squelch) ? 2*dead_time : squelch;
-
-    // check values
-    if (buf_len < num_samples_on+dead_time)
-        throw std::runtime_error("requested hop duration too small (-1) (d:"+std::to_string(buf_len)
-            +",1:"+std::to_string(num_samples_on)+",0:"+std::to_string(dead_time)+",p:"
-            +std::to_string(num_samples_on+dead_time)+")");
-
-    // fill buffer
-    // unsigned int num_samples_on = buf_len - 2*dead_time;
-
-    symstreamrcf_set_gain(gen, 0.5f);
-    symstreamrcf_write_samples(gen, buf, num_samples_on);
-    symstreamrcf_set_gain(gen, 0.0f);
-    symstreamrcf_write_samples(gen, buf + num_samples_on, dead_time);
+    unsigned int active = gen.write_hop(buf, buf_len, dwell, squelch, sparse);
 
     // mix
     nco_crcf_set_frequency(mixer, 2*M_PI*fc);
-    nco_crcf_mix_block_up(mixer, buf, buf, buf_len);
+    nco_crcf_mix_block_up(mixer, buf, buf, active);
+    return active;
 }
 
-// generate a hop of a particular bandwidth and center frequency
-void generate_hop2(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamracf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch)
-{
-    auto delay = symstreamracf_get_delay(gen);
-    unsigned int dead_time = (unsigned int) (delay + 1.5f);
-
-    // buf_len is the hop_duration
-    if (dwell == 0){
-        squelch = 0;
-        dwell = buf_len - 2*dead_time;
-    }
-    if (dwell > buf_len - 2*dead_time){
-        dwell = buf_len - 2*dead_time;
-    }
-
-    unsigned int num_samples_on = dwell;
-    dead_time = (2*dead_time > squelch) ? 2*dead_time : squelch;
-
-    // check values
-    if (buf_len < num_samples_on+dead_time)
-        throw std::runtime_error("requested hop duration too small (0) (d:"+std::to_string(buf_len)
-            +",1:"+std::to_string(num_samples_on)+",0:"+std::to_string(dead_time)+",p:"
-            +std::to_string(num_samples_on+dead_time)+")");
-
-    // fill buffer
-    // unsigned int num_samples_on = buf_len - 2*dead_time;
-
-    symstreamracf_set_gain(gen, 0.5f);
-    symstreamracf_write_samples(gen, buf, num_samples_on);
-    symstreamracf_set_gain(gen, 0.0f);
-    symstreamracf_write_samples(gen, buf + num_samples_on, dead_time);
-
-    // mix
-    nco_crcf_set_frequency(mixer, 2*M_PI*fc);
-    nco_crcf_mix_block_up(mixer, buf, buf, buf_len);
-}
-
-// generate a hop of a particular bandwidth and center frequency
-void generate_hop3(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamrncf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch)
-{
-    auto delay = symstreamrncf_get_delay(gen);
-    unsigned int dead_time = (unsigned int) (delay + 1.5f);
-
-    // buf_len is the hop_duration
-    if (dwell == 0){
-        squelch = 0;
-        dwell = buf_len - 2*dead_time;
-    }
-    if (dwell > buf_len - 2*dead_time){
-        dwell = buf_len - 2*dead_time;
-    }
-
-    unsigned int num_samples_on = dwell;
-    dead_time = (2*dead_time > squelch) ? 2*dead_time : squelch;
-
-    // check values
-    if (buf_len < num_samples_on+dead_time){
-        // Since this is for noise only, we can just jiggle a bit
-        num_samples_on = buf_len-dead_time;
-        // throw std::runtime_error("requested hop duration too small (0) (d:"+std::to_string(buf_len)
-        //     +",1:"+std::to_string(num_samples_on)+",0:"+std::to_string(dead_time)+",p:"
-        //     +std::to_string(num_samples_on+dead_time)+")");
-    }
-
-    // fill buffer
-    // unsigned int num_samples_on = buf_len - 2*dead_time;
-
-    symstreamrncf_set_gain(gen, 0.5f);
-    symstreamrncf_write_samples(gen, buf, num_samples_on);
-    symstreamrncf_set_gain(gen, 0.0f);
-    symstreamrncf_write_samples(gen, buf + num_samples_on, dead_time);
-
-    // mix
-    nco_crcf_set_frequency(mixer, 2*M_PI*fc);
-    nco_crcf_mix_block_up(mixer, buf, buf, buf_len);
-}
-
-// // generate a hop of a particular bandwidth and center frequency
-// void generate_hop(float fc, std::complex<float> * buf, unsigned int buf_len,
-//         symstreamrfcf gen, nco_crcf mixer)
-// {
-//     auto delay = symstreamrfcf_get_delay(gen);
-//
-//     unsigned int dead_time = (unsigned int) (delay + 1.5f);
-//
-//     // check values
-//     if (buf_len < 2*dead_time)
-//         throw std::runtime_error("requested hop duration too small");
-//
-//     // fill buffer
-//     unsigned int num_samples_on = buf_len - 2*dead_time;
-//
-//     symstreamrfcf_set_gain(gen, 0.5f);
-//     symstreamrfcf_write_samples(gen, buf, num_samples_on);
-//     symstreamrfcf_set_gain(gen, 0.0f);
-//     symstreamrfcf_write_samples(gen, buf + num_samples_on, 2*dead_time);
-//
-//     // mix
-//     nco_crcf_set_frequency(mixer, 2*M_PI*fc);
-//     nco_crcf_mix_block_up(mixer, buf, buf, buf_len);
-// }
-
-// generate a hop of a particular bandwidth and center frequency
-void generate_hop2(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamrfcf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch)
-{
-    auto delay = symstreamrfcf_get_delay(gen);
-    unsigned int dead_time = (unsigned int) (delay + 1.5f);
-
-    // buf_len is the hop_duration
-    if (dwell == 0){
-        squelch = 0;
-        dwell = buf_len - 2*dead_time;
-    }
-
-    unsigned int num_samples_on = dwell;
-    dead_time = (2*dead_time > squelch) ? 2*dead_time : squelch;
-
-    // check values
-    if (buf_len < num_samples_on+dead_time)
-        // throw std::runtime_error("requested hop duration too small (1) (d:"+std::to_string(buf_len)
-        //     +",1:"+std::to_string(num_samples_on)+",0:"+std::to_string(dead_time)+",p:"
-        //     +std::to_string(num_samples_on+dead_time)+")");
-        num_samples_on = buf_len-dead_time;
-
-    // fill buffer
-    // unsigned int num_samples_on = buf_len - 2*dead_time;
-
-    symstreamrfcf_set_gain(gen, 0.5f);
-    symstreamrfcf_write_samples(gen, buf, num_samples_on);
-    symstreamrfcf_set_gain(gen, 0.0f);
-    symstreamrfcf_write_samples(gen, buf + num_samples_on, dead_time);
-
-    // mix
-    nco_crcf_set_frequency(mixer, 2*M_PI*fc);
-    nco_crcf_mix_block_up(mixer, buf, buf, buf_len);
-}
-
-// generate a hop of a particular bandwidth and center frequency
-void generate_hop3(float fc, std::complex<float> * buf, unsigned int buf_len,
-        symstreamrfcf gen, nco_crcf mixer, unsigned int dwell, unsigned int squelch)
-{
-    auto delay = symstreamrfcf_get_delay(gen);
-    unsigned int dead_time = (unsigned int) (delay + 1.5f);
-
-    // buf_len is the hop_duration
-    if (dwell == 0){
-        squelch = 0;
-        dwell = buf_len - 2*dead_time;
-    }
-
-    unsigned int num_samples_on = dwell;
-    dead_time = (2*dead_time > squelch) ? 2*dead_time : squelch;
-
-    // check values
-    if (buf_len < num_samples_on+dead_time)
-    {
-        // Since this is for tones only, we can just jiggle a bit
-        num_samples_on = buf_len-dead_time;
-        // throw std::runtime_error("requested hop duration too small (2) (d:"+std::to_string(buf_len)
-        //     +",1:"+std::to_string(num_samples_on)+",0:"+std::to_string(dead_time)+",p:"
-        //     +std::to_string(num_samples_on+dead_time)+")");
-    }
-
-    // fill buffer
-    // unsigned int num_samples_on = buf_len - 2*dead_time;
-
-    // symstreamrfcf_set_gain(gen, 0.5f);
-    // symstreamrfcf_write_samples(gen, buf, num_samples_on);
-    // symstreamrfcf_set_gain(gen, 0.0f);
-    // symstreamrfcf_write_samples(gen, buf + num_samples_on, dead_time);
-    for(unsigned int idx = 0; idx < num_samples_on; idx++){
-        buf[idx] = 0.5;
-    }
-    for(unsigned int idx = num_samples_on; idx < buf_len; idx++){
-        buf[idx] = 0.0;
-    }
-
-    // mix
-    nco_crcf_set_frequency(mixer, 2*M_PI*fc);
-    nco_crcf_mix_block_up(mixer, buf, buf, buf_len);
-}
-
-
 float get_rand_fc(){
     return randf() - 0.5f;
 }
@@ -974,207 +847,283 @@ float get_channel_fc(int step, float span, unsigned int channels){
     return m*(float)step - 0.5f*(span-m);
 }
 
-// generate a sequence of hops
-std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
-        std::complex<float> * buf, float center_freq, float sample_rate, modulation_scheme ms,
-        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch)
+// hop frequencies of a sequence, drawn serially so they are the same
+// however the hops are rendered afterwards
+std::vector<float> plan_hops(float bw, unsigned int num_hops, bool sweep, float span, int num_channels)
 {
-    // initialize objects
-    unsigned int m = 12;
-    symstreamrcf gen = symstreamrcf_create_linear(LIQUID_FIRFILT_ARKAISER, bw, m, 0.25f, ms);
-    nco_crcf mixer = nco_crcf_create(LIQUID_VCO);
-
-    //
-    std::vector<burst> bursts;
-
-    // std::cout << "Gen Seq Debug:\n";
-    // std::cout << "  bw: " << bw << std::endl;
-    // std::cout << "  hop_dur: " << hop_dur << std::endl;
-    // std::cout << "  dwell: " << (dwell == 0 ? hop_dur : dwell) << std::endl;
-    // std::cout << "  squelch: " << (dwell == 0 ? 0 : squelch) << std::endl;
-    // std::cout << "  num_hops: " << num_hops << std::endl;
-    // std::cout << "  center_freq: " << center_freq << std::endl;
-    // std::cout << "  sample_rate: " << sample_rate << std::endl;
-    // std::cout << "  span: " << span << std::endl;
-    // std::cout << "  num_channels: " << num_channels << std::endl;
-
-    // generate individual hops
+    std::vector<float> fcs(num_hops);
     for (auto i=0U; i<num_hops; i++) {
-        float fc;
         if(num_channels <= 0){
-            fc = sweep ? span*(1-1.2*bw)*get_uniform_fc(i,num_hops) : span*(1-1.2*bw)*get_rand_fc();
+            fcs[i] = sweep ? span*(1-1.2*bw)*get_uniform_fc(i,num_hops) : span*(1-1.2*bw)*get_rand_fc();
         }
         else{
-            fc = sweep ? get_channel_fc(i%num_channels,span,num_channels) : get_channel_fc(-1,span,num_channels);
+            fcs[i] = sweep ? get_channel_fc(i%num_channels,span,num_channels) : get_channel_fc(-1,span,num_channels);
         }
-        // generate_hop(fc, buf + i*hop_dur, hop_dur, gen, mixer);
-        generate_hop2(fc, buf + i*hop_dur, hop_dur, gen, mixer, dwell, squelch);
-
-        // append to labels
-        bursts.emplace_back(center_freq + fc*sample_rate, bw*sample_rate,
-            (float)(i*hop_dur)/sample_rate, (float)hop_dur/sample_rate, ms);
     }
+    return fcs;
+}
 
-    // free objects
-    symstreamrcf_destroy(gen);
-    nco_crcf_destroy(mixer);
+// Hops are rendered in chunks, each by a fresh generator and mixer seeded
+// from the chunk number, so chunks can be spread over threads and the
+// sequence does not depend on how many there are. Every hop ends in dead
+// time that flushes the generator's filters, so a chunk boundary looks
+// like any other hop boundary.
+#define FHSS_CHUNK_HOPS 32
 
-    // return list of bursts
-    return bursts;
+uint32_t chunk_seed(uint32_t base, uint64_t chunk)
+{
+    uint64_t z = base + (chunk + 1)*0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return ((uint32_t)z) ? (uint32_t)z : 1;
 }
 
-// generate a sequence of hops
-std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
-        std::complex<float> * buf, float center_freq, float sample_rate, fsk_scheme ms,
-        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
-        unsigned int k, double mod_index, unsigned int cpf_type)
+// make(seed) returns the generator<> for a chunk; returns the largest
+// |I|/|Q|, taken from each hop right after it is written, and the number
+// of samples written for each hop through active
+template<class MAKE>
+float render_hops(const std::vector<float> &fcs, unsigned int hop_dur, std::complex<float> * buf,
+        unsigned int dwell, unsigned int squelch, bool sparse, unsigned int chunk_hops,
+        std::vector<unsigned int> &active, MAKE make)
 {
-    uint8_t tweak = (ms == LIQUID_FSK_UNKNOWN);
-    // initialize objects
-    if (tweak){
-        ms = LIQUID_MODEM_FSK2;
-        k = 2;
-        mod_index = 0.5;
-        bw = 0.01;
-        cpf_type = 0;
-    }
-    symstreamrfcf gen = symstreamrfcf_create_fsk(LIQUID_FIRFILT_ARKAISER, k, mod_index, 12, bw, 0.35, cpf_type, ms);
-    nco_crcf mixer = nco_crcf_create(LIQUID_VCO);
-    if (tweak){
-        bw = 0.01;
-        ms = LIQUID_FSK_UNKNOWN;
+    active.assign(fcs.size(), 0);
+    uint32_t base = (uint32_t)rand();
+    long num_chunks = ((long)fcs.size() + chunk_hops - 1)/chunk_hops;
+    std::exception_ptr error = nullptr;
+    float peak = 0.0f;
+    #pragma omp parallel for schedule(dynamic) reduction(max:peak)
+    for (long c=0; c<num_chunks; c++) {
+        nco_crcf mixer = nco_crcf_create(LIQUID_VCO);
+        try{
+            auto gen = make(chunk_seed(base, c));
+            size_t stop = std::min(fcs.size(), (size_t)(c+1)*chunk_hops);
+            for (size_t i=(size_t)c*chunk_hops; i<stop; i++) {
+                active[i] = generate_hop(fcs[i], buf + i*hop_dur, hop_dur, gen, mixer, dwell, squelch, sparse);
+                peak = iq_peak(buf + i*hop_dur, active[i], peak);
+            }
+        }
+        catch(...){
+            #pragma omp critical
+            error = std::current_exception();
+        }
+        nco_crcf_destroy(mixer);
     }
+    if (error)
+        std::rethrow_exception(error);
+    return peak;
+}
 
-    //
-    std::vector<burst> bursts;
+// The state a generator has at any hop boundary: primed with a flush of
+// silence, as after the dead time of a hop. Each chunk's generator is
+// restored from it, so the first hop of a chunk starts as every later
+// one does, whichever thread renders it.
+template<class API>
+warm_start<API> hop_boundary(stream<API> && gen)
+{
+    std::vector<std::complex<float> > flush(2*(unsigned int)(gen.get_delay() + 1.5f));
+    gen.set_gain(0.0f);
+    gen.write(flush.data(), flush.size());
+    return warm_start<API>(gen);
+}
 
-    // generate individual hops
+// plan, render and label a sequence with any generator family
+template<class SCHEME, class MAKE>
+std::vector<burst> build_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
+        std::complex<float> * buf, float center_freq, float sample_rate, SCHEME ms,
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        bool sparse, unsigned int chunk_hops, float * peak, MAKE make)
+{
+    std::vector<float> fcs = plan_hops(bw, num_hops, sweep, span, num_channels);
+    std::vector<unsigned int> active;
+    float hop_peak = render_hops(fcs, hop_dur, buf, dwell, squelch, sparse, std::max(1U, chunk_hops),
+        active, make);
+    if (peak != nullptr)
+        *peak = hop_peak;
+
+    // append to labels
+    std::vector<burst> bursts;
     for (auto i=0U; i<num_hops; i++) {
-        float fc;
-        if(num_channels <= 0){
-            fc = sweep ? span*(1-1.2*bw)*get_uniform_fc(i,num_hops) : span*(1-1.2*bw)*get_rand_fc();
-        }
-        else{
-            fc = sweep ? get_channel_fc(i%num_channels,span,num_channels) : get_channel_fc(-1,span,num_channels);
-        }
-        if(tweak){
-            generate_hop3(fc, buf + i*hop_dur, hop_dur, gen, mixer, dwell, squelch);
-        }
-        else{
-            // generate_hop(fc, buf + i*hop_dur, hop_dur, gen, mixer);
-            generate_hop2(fc, buf + i*hop_dur, hop_dur, gen, mixer, dwell, squelch);
-        }
-
-        // append to bursts
-        bursts.emplace_back(center_freq + fc*sample_rate, bw*sample_rate,
+        bursts.emplace_back(center_freq + fcs[i]*sample_rate, bw*sample_rate,
             (float)(i*hop_dur)/sample_rate, (float)hop_dur/sample_rate, ms);
+        bursts.back().active = active[i];
     }
-
-    // free objects
-    symstreamrfcf_destroy(gen);
-    nco_crcf_destroy(mixer);
-
-    // return list of bursts
     return bursts;
 }
 
 // generate a sequence of hops
 std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
-        std::complex<float> * buf, float center_freq, float sample_rate, analog_scheme ms,
+        std::complex<float> * buf, float center_freq, float sample_rate, modulation_scheme ms,
         bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
-        double mod_index, double src_freq)
+        float * peak, bool sparse)
 {
-    // initialize objects
-    unsigned int m = 12;
-    symstreamracf gen = symstreamracf_create_analog(LIQUID_FIRFILT_ARKAISER, bw, m, 0.25f, mod_index, src_freq, ms);
-    nco_crcf mixer = nco_crcf_create(LIQUID_VCO);
-
-    //
-    std::vector<burst> bursts;
-
-    // std::cout << "Gen Seq Debug:\n";
-    // std::cout << "  bw: " << bw << std::endl;
-    // std::cout << "  hop_dur: " << hop_dur << std::endl;
-    // std::cout << "  dwell: " << (dwell == 0 ? hop_dur : dwell) << std::endl;
-    // std::cout << "  squelch: " << (dwell == 0 ? 0 : squelch) << std::endl;
-    // std::cout << "  num_hops: " << num_hops << std::endl;
-    // std::cout << "  center_freq: " << center_freq << std::endl;
-    // std::cout << "  sample_rate: " << sample_rate << std::endl;
-    // std::cout << "  span: " << span << std::endl;
-    // std::cout << "  num_channels: " << num_channels << std::endl;
-
-    // generate individual hops
-    for (auto i=0U; i<num_hops; i++) {
-        float fc;
-        if(num_channels <= 0){
-            fc = sweep ? span*(1-1.2*bw)*get_uniform_fc(i,num_hops) : span*(1-1.2*bw)*get_rand_fc();
-        }
-        else{
-            fc = sweep ? get_channel_fc(i%num_channels,span,num_channels) : get_channel_fc(-1,span,num_channels);
-        }
-        // generate_hop(fc, buf + i*hop_dur, hop_dur, gen, mixer);
-        generate_hop2(fc, buf + i*hop_dur, hop_dur, gen, mixer, dwell, squelch);
+    // liquid's linear symstream draws its symbols from rand(), so the chunks
+    // use a stream of their own seeded from the chunk
+    return build_sequence(bw, hop_dur, num_hops, buf, center_freq, sample_rate, ms,
+        sweep, span, num_channels, dwell, squelch, sparse, FHSS_CHUNK_HOPS, peak,
+        [&](uint32_t seed){ return seeded_linear_generator(
+            LIQUID_FIRFILT_ARKAISER, bw, 12, 0.25f, ms, seed); });
+}
 
-        // append to labels
-        bursts.emplace_back(center_freq + fc*sample_rate, bw*sample_rate,
-            (float)(i*hop_dur)/sample_rate, (float)hop_dur/sample_rate, ms);
+// generate a sequence of hops
+std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
+        std::complex<float> * buf, float center_freq, float sample_rate, fsk_scheme ms,
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        unsigned int k, double mod_index, unsigned int cpf_type, float * peak, bool sparse)
+{
+    // no scheme is a plain tone
+    if (ms == LIQUID_FSK_UNKNOWN){
+        return build_sequence(0.01f, hop_dur, num_hops, buf, center_freq, sample_rate, ms,
+            sweep, span, num_channels, dwell, squelch, sparse, FHSS_CHUNK_HOPS, peak,
+            [](uint32_t){ return tone_generator(); });
     }
+    auto create = [&](){ return fsk_generator(
+        symstreamrfcf_create_fsk(LIQUID_FIRFILT_ARKAISER, k, mod_index, 12, bw, 0.35, cpf_type, ms)); };
+    warm_start<fsk_api> warm = hop_boundary(create());
+    return build_sequence(bw, hop_dur, num_hops, buf, center_freq, sample_rate, ms,
+        sweep, span, num_channels, dwell, squelch, sparse, FHSS_CHUNK_HOPS, peak,
+        [&](uint32_t seed){
+            fsk_generator gen = create();
+            warm.restore(gen);
+            symstreamrfcf_set_seed(gen.get(), seed);// after the restore, which brings its own
+            return gen; });
+}
 
-    // free objects
-    symstreamracf_destroy(gen);
-    nco_crcf_destroy(mixer);
-
-    // return list of bursts
-    return bursts;
+// generate a sequence of hops
+std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
+        std::complex<float> * buf, float center_freq, float sample_rate, analog_scheme ms,
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        double mod_index, double src_freq, float * peak, bool sparse)
+{
+    // analog sources (e.g. audio files) play on from hop to hop, so all
+    // hops are one chunk with one generator, in order
+    auto create = [&](){ return analog_generator(
+        symstreamracf_create_analog(LIQUID_FIRFILT_ARKAISER, bw, 12, 0.25f, mod_index, src_freq, ms)); };
+    warm_start<analog_api> warm = hop_boundary(create());
+    return build_sequence(bw, hop_dur, num_hops, buf, center_freq, sample_rate, ms,
+        sweep, span, num_channels, dwell, squelch, sparse, num_hops, peak,
+        [&](uint32_t){
+            analog_generator gen = create();
+            warm.restore(gen);
+            return gen; });
 }
 
 // generate a sequence of hops
 std::vector<burst> generate_sequence(float bw, unsigned int hop_dur, unsigned int num_hops,
         std::complex<float> * buf, float center_freq, float sample_rate, noise_scheme ms,
-        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch)
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        float * peak, bool sparse)
 {
-    // initialize objects
-    unsigned int m = 12;
-    symstreamrncf gen = symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, bw, m, 0.25f, ms);
-    nco_crcf mixer = nco_crcf_create(LIQUID_VCO);
+    auto create = [&](){ return noise_generator(
+        symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, bw, 12, 0.25f, ms)); };
+    warm_start<noise_api> warm = hop_boundary(create());
+    return build_sequence(bw, hop_dur, num_hops, buf, center_freq, sample_rate, ms,
+        sweep, span, num_channels, dwell, squelch, sparse, FHSS_CHUNK_HOPS, peak,
+        [&](uint32_t seed){
+            noise_generator gen = create();
+            warm.restore(gen);
+            symstreamrncf_set_seed(gen.get(), seed);// after the restore, which brings its own
+            return gen; });
+}
 
-    //
-    std::vector<burst> bursts;
+// Filterbank size for num_channels channels over span: channel spacing
+// 1/M is the largest that still fits every channel within the span.
+unsigned int channelizer_size(float span, int num_channels)
+{
+    unsigned int M = 2*(unsigned int)ceilf((float)num_channels/(2.0f*span));
+    return (M < 2) ? 2 : M;
+}
 
-    // std::cout << "Gen Seq Debug:\n";
-    // std::cout << "  bw: " << bw << std::endl;
-    // std::cout << "  hop_dur: " << hop_dur << std::endl;
-    // std::cout << "  dwell: " << (dwell == 0 ? hop_dur : dwell) << std::endl;
-    // std::cout << "  squelch: " << (dwell == 0 ? 0 : squelch) << std::endl;
-    // std::cout << "  num_hops: " << num_hops << std::endl;
-    // std::cout << "  center_freq: " << center_freq << std::endl;
-    // std::cout << "  sample_rate: " << sample_rate << std::endl;
-    // std::cout << "  span: " << span << std::endl;
-    // std::cout << "  num_channels: " << num_channels << std::endl;
-
-    // generate individual hops
+// Every emitter owns a generator running at the channel rate and takes a
+// different channel on each hop. Logical channel i sits on filterbank
+// channel i - num_channels/2, so the channels are centered on the carrier
+// (half a channel low for an even count) and no stream is ever mixed.
+template<class SCHEME, class MAKE>
+std::vector<burst> render_channelized(float bw, unsigned int hop_dur, unsigned int num_hops,
+        std::complex<float> * buf, float center_freq, float sample_rate, SCHEME ms,
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        unsigned int emitters, float * peak, MAKE make)
+{
+    unsigned int M = channelizer_size(span, num_channels);
+    unsigned int interp = M/2;
+    unsigned int hop_len = hop_dur/interp;          // channel samples per hop
+
+    // bandwidth relative to the channel rate, which is 2/M of the output rate
+    float bw_ch = bw*interp;
+    if (bw_ch >= 0.5f)
+        throw std::runtime_error("hop bandwidth "+std::to_string(bw)+" does not fit a channel of "
+            +std::to_string(1.0f/M));
+
+    std::vector<decltype(make(bw_ch))> gens;
+    gens.reserve(emitters);
+    for (auto e=0U; e<emitters; e++)
+        gens.emplace_back(make(bw_ch));
+    std::vector<std::vector<std::complex<float> > > streams(emitters,
+        std::vector<std::complex<float> >(hop_len));
+    std::vector<std::complex<float>*> x(M, nullptr);
+    std::vector<unsigned int> ch(emitters);
+
+    // destroyed on every way out, write_hop throws on a too short hop
+    std::unique_ptr<struct chansynth_s, int (*)(chansynth)> owner(chansynth_create(M, 4, 60.0f), chansynth_destroy);
+    chansynth synth = owner.get();
+    if (synth == NULL)
+        throw std::runtime_error("could not create channel synthesizer");
+    float delay = chansynth_get_delay(synth);
+
+    std::vector<burst> bursts;
+    float hop_peak = 0.0f;
     for (auto i=0U; i<num_hops; i++) {
-        float fc;
-        if(num_channels <= 0){
-            fc = sweep ? span*(1-1.2*bw)*get_uniform_fc(i,num_hops) : span*(1-1.2*bw)*get_rand_fc();
-        }
-        else{
-            fc = sweep ? get_channel_fc(i%num_channels,span,num_channels) : get_channel_fc(-1,span,num_channels);
+        // pick distinct channels for this hop
+        for (auto e=0U; e<emitters; e++) {
+            if (sweep) {
+                ch[e] = (i + e*num_channels/emitters) % num_channels;
+                continue;
+            }
+            bool taken = true;
+            while (taken) {
+                ch[e] = rand() % num_channels;
+                taken = std::find(ch.begin(), ch.begin() + e, ch[e]) != ch.begin() + e;
+            }
         }
-        // generate_hop(fc, buf + i*hop_dur, hop_dur, gen, mixer);
-        generate_hop3(fc, buf + i*hop_dur, hop_dur, gen, mixer, dwell, squelch);
 
-        // append to labels
-        bursts.emplace_back(center_freq + fc*sample_rate, bw*sample_rate,
-            (float)(i*hop_dur)/sample_rate, (float)hop_dur/sample_rate, ms);
+        std::fill(x.begin(), x.end(), nullptr);
+        for (auto e=0U; e<emitters; e++) {
+            unsigned int k = (ch[e] + M - num_channels/2) % M;
+            gens[e].write_hop(streams[e].data(), hop_len, dwell/interp, squelch/interp);
+            x[k] = streams[e].data();
+
+            // append to labels
+            bursts.emplace_back(center_freq + chansynth_get_channel_fc(synth, k)*sample_rate, bw*sample_rate,
+                (float)(i*hop_dur + delay)/sample_rate, (float)hop_dur/sample_rate, ms);
+        }
+        chansynth_execute(synth, x.data(), hop_len, buf + (size_t)i*hop_dur);
+        hop_peak = iq_peak(buf + (size_t)i*hop_dur, hop_dur, hop_peak);
     }
+    if (peak != nullptr)
+        *peak = hop_peak;
+    return bursts;
+}
 
-    // free objects
-    symstreamrncf_destroy(gen);
-    nco_crcf_destroy(mixer);
+std::vector<burst> generate_channelized(float bw, unsigned int hop_dur, unsigned int num_hops,
+        std::complex<float> * buf, float center_freq, float sample_rate, modulation_scheme ms,
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        unsigned int emitters, float * peak)
+{
+    return render_channelized(bw, hop_dur, num_hops, buf, center_freq, sample_rate, ms,
+        sweep, span, num_channels, dwell, squelch, emitters, peak,
+        [&](float bw_ch){ return linear_generator(
+            symstreamrcf_create_linear(LIQUID_FIRFILT_ARKAISER, bw_ch, 12, 0.25f, ms)); });
+}
 
-    // return list of bursts
-    return bursts;
+std::vector<burst> generate_channelized(float bw, unsigned int hop_dur, unsigned int num_hops,
+        std::complex<float> * buf, float center_freq, float sample_rate, noise_scheme ms,
+        bool sweep, float span, int num_channels, unsigned int dwell, unsigned int squelch,
+        unsigned int emitters, float * peak)
+{
+    return render_channelized(bw, hop_dur, num_hops, buf, center_freq, sample_rate, ms,
+        sweep, span, num_channels, dwell, squelch, emitters, peak,
+        [&](float bw_ch){ return noise_generator(
+            symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, bw_ch, 12, 0.25f, ms)); });
 }
 
 void export_json(labels *reporter, std::vector<burst> bursts,
@@ -1209,3 +1158,29 @@ void export_json(labels *reporter, std::vector<burst> bursts,
     }
 }
 
+// Send n samples of buf scaled by gain, or n zeros if buf is nullptr, as
+// part of the burst md describes: the first chunk out takes the start of
+// burst and time spec, and the last ends the burst if eob. Returns the
+// number of samples sent, short of n only when stopped.
+size_t send_span(uhd::tx_streamer::sptr tx_stream, uhd::tx_metadata_t &md,
+        const std::complex<float> * buf, size_t n, float gain, bool eob,
+        std::vector<int16_t> &sc16)
+{
+    size_t sent = 0;
+    do {
+        size_t send_size = std::min(n - sent, (size_t)FHSS_SEND_CHUNK);
+        md.end_of_burst = eob && (sent + send_size == n);
+        const int16_t * out = zero_page;
+        if (buf != nullptr) {
+            iq_to_sc16(buf + sent, send_size, gain, sc16.data());
+            out = sc16.data();
+        }
+        size_t xfer = tx_stream->send(out, send_size, md);
+        sent += xfer;
+        if (xfer > 0 && md.start_of_burst) {
+            md.start_of_burst = false;
+            md.has_time_spec  = false;
+        }
+    } while (sent < n && continue_running);
+    return sent;
+}
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "label_store.hh"
+#include "burst_index.hh"
+
+// Convert, merge and index the binary label files written by labels::enable_binary
+//
+//   info <in.wlb>...                   record counts and attributes
+//   json <in.wlb> [out.json]           the same document the JSON labels hold
+//   consolidate -o <out.json> <in.wlb>...
+//                                      one report over many runs, like
+//                                      scripts/consolidate_reports.py: names get
+//                                      a ":<input index>" suffix and source
+//                                      reports are merged by device_origin
+//   index <in.wlb> <out.bix>           time/frequency index of the records
+//   query <in.bix> <t0> <t1> <f0> <f1> records overlapping the box [s, Hz]
+
+void usage(const char *name){
+    std::cout << " Usage : " << name << " info <in.wlb>...\n";
+    std::cout << "         " << name << " json <in.wlb> [out.json]\n";
+    std::cout << "         " << name << " consolidate -o <out.json> <in.wlb>...\n";
+    std::cout << "         " << name << " index <in.wlb> <out.bix>\n";
+    std::cout << "         " << name << " query <in.bix> <t0> <t1> <f0> <f1>\n";
+}
+
+int info(int arg_c, char **arg_v){
+    for(int idx = 0; idx < arg_c; idx++){
+        label_reader r = label_reader_open(arg_v[idx]);
+        if(r == NULL){
+            std::cout << arg_v[idx] << " : not a label file\n";
+            continue;
+        }
+        printf("%s : %lu records in %u blocks\n", arg_v[idx],
+                (unsigned long)label_reader_count(r), label_reader_num_blocks(r));
+        const char *keys[] = {"signal", "source", "modulation", "device_origin"};
+        for(const char *key : keys){
+            const char *value = label_reader_attr(r, key);
+            printf("    %-14s %s\n", key, (value != NULL) ? value : "(unset)");
+        }
+        label_reader_destroy(&r);
+    }
+    return 0;
+}
+
+int json(int arg_c, char **arg_v){
+    if(arg_c < 1) return 1;
+    label_reader r = label_reader_open(arg_v[0]);
+    if(r == NULL){
+        std::cout << arg_v[0] << " : not a label file\n";
+        return 1;
+    }
+    FILE *fid = (arg_c >= 2) ? fopen(arg_v[1], "w") : stdout;
+    if(fid == NULL){
+        std::cout << "could not open " << arg_v[1] << " for writing\n";
+        label_reader_destroy(&r);
+        return 1;
+    }
+    label_reader_to_json(r, fid);
+    if(fid != stdout) fclose(fid);
+    label_reader_destroy(&r);
+    return 0;
+}
+
+int consolidate(int arg_c, char **arg_v){
+    std::string output;
+    std::vector<const char*> inputs;
+    for(int idx = 0; idx < arg_c; idx++){
+        if(std::string(arg_v[idx]) == "-o" && idx + 1 < arg_c) output = arg_v[++idx];
+        else inputs.push_back(arg_v[idx]);
+    }
+    if(output.empty() || inputs.empty()) return 1;
+    FILE *fid = fopen(output.c_str(), "w");
+    if(fid == NULL){
+        std::cout << "could not open " << output << " for writing\n";
+        return 1;
+    }
+
+    // first file seen for a device_origin stands in for its source report
+    struct source_set{
+        label_reader stats;
+        std::string ext;
+        std::vector<std::string> signals;
+    };
+    std::map<std::string, source_set> sources;
+    std::vector<std::string> origins;
+    std::vector<label_reader> readers;
+
+    fprintf(fid,"{\n");
+    fprintf(fid,"    \"reports\": [\n");
+    bool first = true;
+    for(size_t idx = 0; idx < inputs.size(); idx++){
+        label_reader r = label_reader_open(inputs[idx]);
+        if(r == NULL){
+            std::cout << inputs[idx] << " : not a label file, skipped\n";
+            continue;
+        }
+        readers.push_back(r);
+        if(label_reader_count(r) == 0) continue;
+        std::string ext = ":" + std::to_string(idx);
+        if(!first) fprintf(fid,",\n");
+        label_reader_reports_json(r, fid, ext.c_str());
+        first = false;
+
+        const char *origin = label_reader_attr(r, "device_origin");
+        const char *signal = label_reader_attr(r, "signal");
+        std::string key = (origin != NULL) ? origin : "custom label";
+        if(sources.find(key) == sources.end()){
+            std::cout << "Tracking new source: " << key << std::endl;
+            sources[key].stats = r;
+            sources[key].ext = ext;
+            origins.push_back(key);
+        }
+        sources[key].signals.push_back(std::string((signal != NULL) ? signal : "GT SIG 0000001") + ext);
+    }
+    for(const std::string &key : origins){
+        source_set &s = sources[key];
+        std::vector<const char*> names;
+        for(const std::string &name : s.signals) names.push_back(name.c_str());
+        fprintf(fid,",\n");
+        label_reader_source_json(s.stats, fid, s.ext.c_str(), names.data(), names.size());
+    }
+    fprintf(fid,"\n");
+    fprintf(fid,"    ]\n");
+    fprintf(fid,"}\n");
+    fclose(fid);
+    for(label_reader &r : readers) label_reader_destroy(&r);
+    std::cout << "results written to " << output << std::endl;
+    return 0;
+}
+
+int index(int arg_c, char **arg_v){
+    if(arg_c < 2) return 1;
+    label_reader r = label_reader_open(arg_v[0]);
+    if(r == NULL){
+        std::cout << arg_v[0] << " : not a label file\n";
+        return 1;
+    }
+    burst_index bi = burst_index_create(label_reader_count(r));
+    for(uint32_t b_idx = 0; b_idx < label_reader_num_blocks(r); b_idx++){
+        const label_block_t *b = label_reader_block(r, b_idx);
+        for(uint32_t idx = 0; idx < b->count; idx++)
+            burst_index_add(bi, b->t0[idx], b->dur[idx], b->fc[idx], b->bw[idx], b->first + idx);
+    }
+    int rc = burst_index_save(bi, arg_v[1]);
+    if(rc) std::cout << "could not write " << arg_v[1] << std::endl;
+    else printf("%lu records indexed to %s\n", (unsigned long)burst_index_count(bi), arg_v[1]);
+    burst_index_destroy(&bi);
+    label_reader_destroy(&r);
+    return (rc) ? 1 : 0;
+}
+
+int query(int arg_c, char **arg_v){
+    if(arg_c < 5) return 1;
+    burst_index bi = burst_index_load(arg_v[0]);
+    if(bi == NULL){
+        std::cout << arg_v[0] << " : not a burst index\n";
+        return 1;
+    }
+    std::vector<uint64_t> ids(1024);
+    uint64_t hits;
+    while((hits = burst_index_query(bi, atof(arg_v[1]), atof(arg_v[2]), atof(arg_v[3]), atof(arg_v[4]),
+                                     ids.data(), ids.size())) > ids.size()){
+        ids.resize(hits);
+    }
+    for(uint64_t idx = 0; idx < hits; idx++) printf("%lu\n", (unsigned long)ids[idx]);
+    burst_index_destroy(&bi);
+    return 0;
+}
+
+int main(int arg_c, char **arg_v){
+    if(arg_c < 3){
+        usage(arg_v[0]);
+        return 1;
+    }
+    std::string cmd(arg_v[1]);
+    int rc = 1;
+    if(cmd == "info") rc = info(arg_c - 2, &arg_v[2]);
+    else if(cmd == "json") rc = json(arg_c - 2, &arg_v[2]);
+    else if(cmd == "consolidate") rc = consolidate(arg_c - 2, &arg_v[2]);
+    else if(cmd == "index") rc = index(arg_c - 2, &arg_v[2]);
+    else if(cmd == "query") rc = query(arg_c - 2, &arg_v[2]);
+    if(rc) usage(arg_v[0]);
+    return rc;
+}
@@ -0,0 +1,391 @@
+// transmit a composite scene of many emitters, synthesized as it goes out,
+// or render it to file offline (-O)
+#include <getopt.h>
+#include <math.h>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <complex>
+#include <csignal>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <exception>
+#include <uhd/usrp/multi_usrp.hpp>
+
+#include "liquid.h"
+#include "labels.hh"
+#include "iq_gain.hh"
+#include "scene.hh"
+#include "offline.hh"
+#include "block_stream.hh"
+
+#define SCENE_SEND_CHUNK 4000
+
+static bool continue_running(true);
+void signal_interrupt_handler(int) {
+    std::cout << "SCENE ---> ctrl+c received --> exiting\n";
+    continue_running = false;
+}
+
+double get_time(){
+    return std::chrono::system_clock::now().time_since_epoch().count()*double(1e-9);
+}
+
+// A block of the scene for block_stream, rendered a few blocks ahead so the
+// next one is synthesized while the current one goes out.
+struct scene_block {
+    std::vector<std::complex<float> > samples;
+    std::vector<scene_burst> bursts;
+    float peak;
+};
+typedef block_stream<scene_block> scene_stream;
+
+// Offline mode: no radio, the whole duration is rendered to an fc32 file
+// as fast as the cores allow, labelled from t = 0.
+int render_offline(const std::vector<scene_emitter> & emitters, double freq, double rate,
+                   double duration, double segment_time, unsigned int num_threads, uint32_t seed,
+                   const std::string & iq_path, const std::string & json,
+                   const std::string & json_bin, const std::string & json_index,
+                   int argc, char **argv)
+{
+    if (duration <= 0) {
+        std::cerr << "offline rendering needs a duration (-d)\n";
+        return 1;
+    }
+    labels* reporter = nullptr;
+    if(!json.empty()){
+        reporter = new labels(json.c_str(),"TXDL T","TXDL SG1","TXDL S1");
+        if(!json_bin.empty() && !reporter->enable_binary(json_bin))
+            std::cout << "could not open " << json_bin << " for binary labels\n";
+        if(!json_index.empty())
+            reporter->enable_index(json_index);
+        reporter->eng_bw = rate;
+        reporter->start_reports();
+    }
+
+    offline_config config;
+    config.sample_rate  = rate;
+    config.duration     = duration;
+    config.center_freq  = freq;
+    config.segment_time = segment_time;
+    config.num_threads  = num_threads;
+    config.seed         = seed;
+
+    double t_start = get_time();
+    float peak = 0.0f;
+    int rc = 0;
+    try {
+        peak = offline_render(emitters, config, iq_path, reporter);
+    }
+    catch (std::exception &e) {
+        std::cerr << "offline rendering failed: " << e.what() << "\n";
+        rc = 1;
+    }
+    double elapsed = get_time() - t_start;
+    if (rc == 0)
+        printf("rendered %.3f s to %s in %.3f s (%.1fx real time), peak %.6f\n",
+            duration, iq_path.c_str(), elapsed, duration/elapsed, peak);
+
+    if (reporter != nullptr) {
+        std::string meta = "        \"command\": \"" + std::string(argv[0]);
+        for(int arg_idx = 1; arg_idx < argc; arg_idx++){
+            meta += (std::string(" ") + std::string(argv[arg_idx]));
+        }
+        reporter->cache_to_misc(meta+"\"\n");
+        reporter->protocol = "unknown";
+        reporter->modality = "multi_emitter";
+        reporter->activity_type = "lowprob_anomaly";
+        reporter->device_origin = "offline";
+        reporter->finalize();
+        delete reporter;
+    }
+    return rc;
+}
+
+int main (int argc, char **argv)
+{
+    srand(std::random_device()());
+    double      uhd_tx_freq = 2.46e9;
+    double      uhd_tx_gain =   60.0;
+    double      uhd_tx_rate =   20e6;
+    std::string uhd_tx_args{"type=b200"};
+    std::string json{""};
+    std::string json_bin{""};
+    std::string json_index{""};
+    double      duration    =   -1.0;    // total duration, < 0 runs until stopped
+    double      block_time  =    0.05;   // samples rendered at a time [s]
+    unsigned int num_blocks =    4;      // blocks rendered ahead
+    double      scan_time   =    1.0;    // rendered ahead to fix the output gain [s]
+    std::string offline{""};             // render to this file instead of the radio
+    double      segment_time =   0.1;    // offline: samples per thread at a time [s]
+    unsigned int num_threads =   0;      // offline: 0 uses all cores
+    uint32_t    seed        =    0;      // symbols of the emitters, 0 picks one
+    std::vector<std::string> specs;
+
+    const int max_chrono = 5;
+    double chrono_time[max_chrono];
+    memset(chrono_time, 0, max_chrono*sizeof(double));
+    chrono_time[0] = get_time();
+
+    uint8_t dry_run = 0;
+
+    int dopt;
+    char *strend = NULL;
+    while ((dopt = getopt(argc,argv,"hf:r:g:a:d:e:s:B:N:W:O:S:P:j:T:X:z:")) != EOF) {
+        switch (dopt) {
+        case 'h':
+            printf("Usage of %s [options]\n",argv[0]);
+            printf("  [ -f <uhd_tx_freq:%.3f MHz> ] [ -r <uhd_tx_rate:%.3f MHz> ] [ -g <uhd_tx_gain:%.3f dB> ]\n", uhd_tx_freq*1.0e-06, uhd_tx_rate*1.0e-06, uhd_tx_gain);
+            printf("  [ -a <uhd_tx_args:%s> ] [ -d <duration:%.3f s> ] [ -j <json:%s> ]\n", uhd_tx_args.c_str(), duration, json.c_str());
+            printf("  [ -T <binary labels:%s> ] [ -X <label index:%s> ]\n", json_bin.c_str(), json_index.c_str());
+            printf("  [ -B <block_time:%.3f s> ] [ -N <blocks ahead:%u> ] [ -z <dry_run:%u> ]\n", block_time, num_blocks, dry_run);
+            printf("  [ -s <seed:%u, 0 picks one> ] [ -W <gain scan:%.3f s> ]\n", seed, scan_time);
+            printf("  [ -O <offline iq file:%s> ] [ -S <segment_time:%.3f s> ] [ -P <threads:%u> ]\n", offline.c_str(), segment_time, num_threads);
+            printf("  -e <emitter> (repeat per emitter) comma separated key=value pairs:\n");
+            printf("     type   linear|fsk|analog|noise|ofdm|tone\n");
+            printf("     mod    scheme of the type (-h of wfgen_linmod, wfgen_fskmod, ...)\n");
+            printf("     fc,bw  offset from -f and occupied bandwidth, relative to -r\n");
+            printf("     gain   [dB], start,stop [s], on,off burst and gap length [s]\n");
+            printf("     k,index,cpf (fsk), index,src (analog), nfft (ofdm)\n");
+            printf("  e.g. -e type=fsk,mod=gmsk,fc=-0.2,bw=0.01,on=0.02,off=0.1 -e type=ofdm,fc=0.1,bw=0.2,gain=-10\n");
+            return 0;
+        case 'f': uhd_tx_freq =  strtod(optarg, &strend); break;
+        case 'r': uhd_tx_rate =  strtod(optarg, &strend); break;
+        case 'g': uhd_tx_gain =  strtod(optarg, &strend); break;
+        case 'a': uhd_tx_args   .assign(optarg); break;
+        case 'd': duration    =  strtod(optarg, &strend); break;
+        case 'e': specs.push_back(optarg); break;
+        case 's': seed        = strtoul(optarg, &strend, 10); break;
+        case 'B': block_time  =  strtod(optarg, &strend); break;
+        case 'N': num_blocks  = strtoul(optarg, &strend, 10); break;
+        case 'W': scan_time   =  strtod(optarg, &strend); break;
+        case 'O': offline       .assign(optarg); break;
+        case 'S': segment_time = strtod(optarg, &strend); break;
+        case 'P': num_threads = strtoul(optarg, &strend, 10); break;
+        case 'j': json          .assign(optarg); break;
+        case 'T': json_bin      .assign(optarg); break;
+        case 'X': json_index    .assign(optarg); break;
+        case 'z': dry_run     = strtoul(optarg, &strend, 10); break;
+        default: exit(1);
+        }
+    }
+    if (specs.empty()) {
+        std::cerr << "no emitters given (-e), see -h\n";
+        return 1;
+    }
+    if (num_blocks < 2) num_blocks = 2;
+    // printed below, so a run can be repeated
+    while (seed == 0) seed = (uint32_t)rand();
+
+    std::vector<scene_emitter> emitters;
+    for (auto &spec: specs) {
+        try {
+            emitters.push_back(scene_emitter_parse(spec));
+        }
+        catch (std::exception &e) {
+            std::cerr << "emitter " << emitters.size() << " (" << spec << "): " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    printf("Using:\n");
+    printf("  freq:         %.3f\n",uhd_tx_freq);
+    printf("  rate:         %.3f\n",uhd_tx_rate);
+    printf("  gain:         %.3f\n",uhd_tx_gain);
+    printf("  args:         %s\n",uhd_tx_args.c_str());
+    printf("  block:        %.3f s x %u\n",block_time,num_blocks);
+    printf("  seed:         %u\n",seed);
+    printf("  gain scan:    %.3f s\n",scan_time);
+    printf("  emitters:     %zu\n",emitters.size());
+    for (size_t i=0; i<emitters.size(); i++)
+        printf("  %3zu: fc:%9.3f MHz, bw:%9.3f kHz, %s\n", i,
+            (uhd_tx_freq + emitters[i].fc*uhd_tx_rate)*1e-6, emitters[i].bw*uhd_tx_rate*1e-3, specs[i].c_str());
+
+    if(dry_run == 1){
+        return 0;
+    }
+    if(!offline.empty())
+        return render_offline(emitters, uhd_tx_freq, uhd_tx_rate, duration, segment_time,
+                              num_threads, seed, offline, json, json_bin, json_index, argc, argv);
+
+    chrono_time[1] = get_time();
+
+    uhd::device_addr_t args(uhd_tx_args);
+    uhd::usrp::multi_usrp::sptr usrp = uhd::usrp::multi_usrp::make(args);
+
+    // try to configure hardware
+    usrp->set_tx_gain(0);
+    usrp->set_tx_rate(uhd_tx_rate);
+    usrp->set_tx_freq(uhd_tx_freq);
+    usrp->set_tx_bandwidth(uhd_tx_rate);
+
+    // set up the metadta flags
+    uhd::tx_metadata_t md;
+    md.start_of_burst = false;
+    md.end_of_burst   = true;
+    md.has_time_spec  = false;
+
+    // stream
+    std::vector<size_t> channel_nums;
+    channel_nums.push_back(0);
+    uhd::stream_args_t stream_args("sc16", "sc16");
+    stream_args.channels = channel_nums;
+    uhd::tx_streamer::sptr tx_stream = usrp->get_tx_stream(stream_args);
+    tx_stream->send("", 0, md);
+    usrp->set_tx_gain(uhd_tx_gain);
+
+    // the scene is built at the rate actually set
+    uhd_tx_rate = usrp->get_tx_rate();
+    scene *sc = nullptr;
+    try {
+        sc = new scene(emitters, uhd_tx_rate, duration, seed);
+    }
+    catch (std::exception &e) {
+        std::cerr << "could not build the scene: " << e.what() << "\n";
+        return 1;
+    }
+    unsigned int block_len = std::max(1U, (unsigned int)(block_time*uhd_tx_rate));
+
+    // The output gain is fixed for the whole run, so the level on air does
+    // not step. It is set from the peak of the first scan_time seconds,
+    // rendered up front by a scene of the same seed, which writes the same
+    // symbols as the one sent (analog audio aside). A scan that is silent
+    // leaves it to the first block that is not; a louder block later on
+    // clips and is counted.
+    float gain = -1.0f;
+    if (scan_time > 0) {
+        scene probe(emitters, uhd_tx_rate, duration, seed);
+        std::vector<std::complex<float> > scan(block_len);
+        uint64_t scan_len = (uint64_t)(scan_time*uhd_tx_rate);
+        if (duration > 0)
+            scan_len = std::min(scan_len, (uint64_t)(duration*uhd_tx_rate));
+        float peak = 0.0f;
+        for (uint64_t t=0; t<scan_len; t+=block_len)
+            peak = std::max(peak, probe.render(scan.data(), (unsigned int)std::min((uint64_t)block_len, scan_len - t)));
+        if (peak > 0.0f)
+            gain = iq_gain(peak, 0.5f);
+    }
+
+    std::vector<scene_block> blocks(num_blocks);
+    for (auto &b: blocks)
+        b.samples.resize(block_len);
+    scene_stream *stream = new scene_stream(std::move(blocks), 0, [sc](scene_block & b){
+        b.bursts.clear();
+        b.peak = sc->render(b.samples.data(), b.samples.size(), &b.bursts);
+    });
+
+    labels* reporter = nullptr;
+    if(!json.empty()){
+        reporter = new labels(json.c_str(),"TXDL T","TXDL SG1","TXDL S1");
+        if(!json_bin.empty() && !reporter->enable_binary(json_bin))
+            std::cout << "could not open " << json_bin << " for binary labels\n";
+        if(!json_index.empty())
+            reporter->enable_index(json_index);
+        reporter->eng_bw = uhd_tx_rate;
+        reporter->start_reports();
+    }
+
+    md.start_of_burst = true;
+    md.end_of_burst   = false;
+    md.has_time_spec  = true;
+
+    std::signal(SIGINT, &signal_interrupt_handler);
+    std::cout << "running ";
+    if (duration > 0) std::cout << "for " << duration << " seconds ";
+    std::cout << "(hit CTRL-C to stop)" << std::endl;
+    chrono_time[2] = get_time();
+    usrp->set_time_now(uhd::time_spec_t(chrono_time[2]),uhd::usrp::multi_usrp::ALL_MBOARDS);
+    double start_tx = chrono_time[2] + 0.5;
+    md.time_spec = uhd::time_spec_t(start_tx);
+
+    unsigned int clipped = 0;
+    std::vector<int16_t> sc16(2*SCENE_SEND_CHUNK);
+    uint64_t xfer_counter = 0;
+    uint64_t num_samples = (duration > 0) ? (uint64_t)(duration*uhd_tx_rate) : UINT64_MAX;
+    while (continue_running && xfer_counter < num_samples) {
+        scene_block *b = stream->acquire();
+        if (b == nullptr) break;
+        if (gain < 0.0f && b->peak > 0.0f)
+            gain = iq_gain(b->peak, 0.5f);
+        if (b->peak*gain > 1.0f)
+            clipped++;
+
+        size_t n = (size_t)std::min((uint64_t)block_len, num_samples - xfer_counter);
+        size_t sent = 0;
+        while (sent < n && continue_running) {
+            size_t send_size = std::min(n - sent, (size_t)SCENE_SEND_CHUNK);
+            iq_to_sc16(b->samples.data() + sent, send_size, std::max(gain, 0.0f), sc16.data());
+            size_t xfer = tx_stream->send(sc16.data(), send_size, md);
+            sent += xfer;
+            if (xfer > 0 && md.start_of_burst) {
+                md.start_of_burst = false;
+                md.has_time_spec  = false;
+            }
+        }
+        sc->report(reporter, b->bursts, start_tx, uhd_tx_freq);
+        xfer_counter += sent;
+        stream->release();
+    }
+    continue_running = false;
+    std::cout << "scene synthesis fell behind " << stream->underruns() << " times\n";
+    if (clipped > 0)
+        std::cout << clipped << " blocks clipped, scan longer (-W) to cover their peak\n";
+    delete stream;
+
+    // send a mini EOB packet
+    md.start_of_burst = false;
+    md.end_of_burst   = true;
+    tx_stream->send("",0,md);
+
+    chrono_time[3] = get_time();
+
+    // wait for the USRP buffers to flush
+    while(get_time() < start_tx + xfer_counter/uhd_tx_rate);
+    usrp->set_tx_freq(6e9);
+    usrp->set_tx_gain(0.0);
+
+    //finished
+    printf("usrp data transfer complete\n");
+    chrono_time[4] = get_time();
+
+    printf("Timestamp at program start: cpu sec: %15.9lf\n",chrono_time[0]);
+    printf("Connecting to radio at: cpu sec: %15.9lf\n",chrono_time[1]);
+    printf("Starting to send at: cpu sec: %15.9lf\n",chrono_time[2]);
+    printf("Stopping send at: cpu sec: %15.9lf\n",chrono_time[3]);
+    printf("Radio should be stopped at: cpu sec: %15.9lf\n",chrono_time[4]);
+    // export to .json if requested
+    if (!json.empty()) {
+        char misc_buf[100];
+        memset(misc_buf, 0, 100);
+        snprintf(misc_buf, 100,"        \"start_app\": %.9f,\n",chrono_time[0]);
+        reporter->cache_to_misc(std::string(misc_buf));
+        memset(misc_buf, 0, 100);
+        snprintf(misc_buf, 100,"        \"start_dev\": %.9f,\n",chrono_time[1]);
+        reporter->cache_to_misc(std::string(misc_buf));
+        memset(misc_buf, 0, 100);
+        snprintf(misc_buf, 100,"        \"start_tx\": %.9f,\n",chrono_time[2]);
+        reporter->cache_to_misc(std::string(misc_buf));
+        memset(misc_buf, 0, 100);
+        snprintf(misc_buf, 100,"        \"stop_tx\": %.9f,\n",chrono_time[3]);
+        reporter->cache_to_misc(std::string(misc_buf));
+        memset(misc_buf, 0, 100);
+        snprintf(misc_buf, 100,"        \"stop_app\": %.9f,\n",chrono_time[4]);
+        reporter->cache_to_misc(std::string(misc_buf));
+
+        std::string meta = "        \"command\": \"" + std::string(argv[0]);
+        for(int arg_idx = 1; arg_idx < argc; arg_idx++){
+            meta += (std::string(" ") + std::string(argv[arg_idx]));
+        }
+        reporter->cache_to_misc(meta+"\"\n");
+        reporter->protocol = "unknown";
+        reporter->modality = "multi_emitter";
+        reporter->activity_type = "lowprob_anomaly";
+        reporter->device_origin=uhd_tx_args;
+        reporter->finalize();
+        delete reporter;
+    }
+    delete sc;
+    return 0;
+}
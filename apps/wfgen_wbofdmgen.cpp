@@ -12,6 +12,7 @@
 
 #include "liquid.h"
 #include "labels.hh"
+#include "iq_gain.hh"
 #include "wbofdmgen.hh"
 #include "writer.hh"
 
@@ -206,7 +207,7 @@ int main (int argc, char **argv)
     // stream
     std::vector<size_t> channel_nums;
     channel_nums.push_back(0);
-    uhd::stream_args_t stream_args("fc32", "sc16");
+    uhd::stream_args_t stream_args("sc16", "sc16");
     stream_args.channels = channel_nums;
     uhd::tx_streamer::sptr tx_stream = usrp->get_tx_stream(stream_args);
     // send a mini EOB packet
@@ -223,12 +224,14 @@ int main (int argc, char **argv)
     // vector buffer to send data to USRP
     auto buf_len = gen.get_buf_len(max_syms);
     std::vector<std::complex<float>> usrp_buffer(buf_len);
+    // frames go out as SC16 at the level they are generated, as they did as fc32
+    std::vector<int16_t> sc16_buffer(2*buf_len);
 
     // buffer of buffers? I guess?
-    std::vector<std::complex<float> *> bufs(channel_nums.size(),
-                                            &usrp_buffer.front());
-    std::vector<std::complex<float> *> buf_ptr(channel_nums.size(),
-                                               &usrp_buffer.front());
+    std::vector<int16_t *> bufs(channel_nums.size(),
+                                &sc16_buffer.front());
+    std::vector<int16_t *> buf_ptr(channel_nums.size(),
+                                   &sc16_buffer.front());
 
     std::signal(SIGINT, &signal_interrupt_handler);
     std::cout << "running (hit CTRL-C to stop)" << std::endl;
@@ -258,6 +261,7 @@ int main (int argc, char **argv)
         // generate samples to buffer
 
         gen.generate(buf,syms);
+        iq_to_sc16(buf, gen.get_buf_len(syms), 1.0f, sc16_buffer.data());
 
         xfer = 0;
         xfer_idx = 0;
@@ -280,7 +284,7 @@ int main (int argc, char **argv)
                 xfer_len -= xfer;
                 xfer_idx += xfer;
                 for(size_t cidx = 0; cidx < channel_nums.size(); cidx++){
-                    buf_ptr[cidx] = &(bufs[cidx][xfer_idx]);
+                    buf_ptr[cidx] = &(bufs[cidx][2*xfer_idx]);
                 }
                 xfer = 0;
                 if(md.start_of_burst){
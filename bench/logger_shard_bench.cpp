@@ -0,0 +1,85 @@
+#include <iostream>
+#include <stdio.h>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+
+#include "logger.hh"
+
+// Ingest scaling of a sharded logger_server: many async clients emit
+// events as fast as they can while the server runs with 1, 2, 4, ...
+// shards; reports delivered records/sec for each shard count. A client
+// whose socket is full sheds the batch, those records are reported as
+// dropped and not waited for.
+
+class counting_buff : public std::streambuf{
+  public:
+    uint64_t lines = 0;
+    int overflow(int c){ if(c == '\n') lines++; return c; }
+    std::streamsize xsputn(const char *s, std::streamsize n){
+        for(std::streamsize idx = 0; idx < n; idx++) if(s[idx] == '\n') lines++;
+        return n;
+    }
+};
+
+int main(int arg_c, char **arg_v){
+    uint32_t clients = (arg_c >= 2) ? atoi(arg_v[1]) : 128;
+    uint32_t records = (arg_c >= 3) ? atoi(arg_v[2]) : 2000;
+    uint32_t max_shards = (arg_c >= 4) ? atoi(arg_v[3]) : std::thread::hardware_concurrency();
+    if(max_shards == 0) max_shards = 1;
+    if(max_shards > 255) max_shards = 255;
+    printf("%u clients x %u records\n", clients, records);
+
+    for(uint32_t shards = 1; shards <= max_shards; shards *= 2){
+        counting_buff counter;
+        std::ostream out(&counter);
+        std::string base = "ipc:///tmp/wfgen_shard_bench_" + std::to_string(::getpid())
+                                          + "_" + std::to_string(shards);
+        logger_server server("", out, base, "", shards);
+
+        std::atomic<uint32_t> started(0), finished(0);
+        std::atomic<uint64_t> sent(0), dropped(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> threads;
+        for(uint32_t idx = 0; idx < clients; idx++){
+            threads.emplace_back([&, idx](){
+                logger_client client("bench", base, false);
+                client.set_shards(shards);
+                client.enable_async(4096, 64);
+                log_event e = make_log_event(idx);
+                started++;
+                while(!go) std::this_thread::yield();
+                for(uint32_t n = 0; n < records; n++){
+                    e.count = 0;
+                    log_event_add(e, n);
+                    while(client.emit(e)) std::this_thread::yield();// retry drops
+                }
+                client.disable_async();
+                sent += client.sent();
+                dropped += client.dropped();
+                finished++;
+            });
+        }
+        while(started < clients) std::this_thread::yield();
+        uint64_t target = (uint64_t)clients*records;
+        auto start = std::chrono::high_resolution_clock::now();
+        go = true;
+        double dt = 0;
+        while((finished < clients || counter.lines < sent) && dt < 60){
+            server.hold_for(0.01);
+            server.flush_all();
+            dt = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::high_resolution_clock::now() - start).count()/1e6;
+        }
+        for(auto &t : threads) t.join();
+        printf("shards %3u : %12.0f records/sec (%lu of %lu in %.3f s, %lu dropped)\n",
+                shards, (dt > 0) ? counter.lines/dt : 0, counter.lines, target, dt,
+                (unsigned long)dropped.load());
+        server.stop();
+        server.wait();
+    }
+    return 0;
+}
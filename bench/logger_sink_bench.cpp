@@ -0,0 +1,64 @@
+#include <iostream>
+#include <stdio.h>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <unistd.h>
+
+#include "log_sink.hh"
+
+// Records/sec of the two ways logger_server can write its log: an ostream
+// flushed per record, and the mmap'd segment sink.
+
+double records_per_sec(std::chrono::high_resolution_clock::time_point start, uint64_t count){
+    double dt = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count()/1e6;
+    return (dt > 0) ? count/dt : 0;
+}
+
+int main(int arg_c, char **arg_v){
+    if(arg_c < 2){
+        std::cout << " Usage : " << arg_v[0] << " <scratch prefix> [records] [record bytes] [fsync s]\n";
+        return 1;
+    }
+    std::string prefix(arg_v[1]);
+    uint64_t count = (arg_c >= 3) ? strtoull(arg_v[2], NULL, 10) : 1000000;
+    uint64_t record_bytes = (arg_c >= 4) ? strtoull(arg_v[3], NULL, 10) : 96;
+    double fsync_s = (arg_c >= 5) ? atof(arg_v[4]) : 1.0;
+    if(record_bytes < 2) record_bytes = 2;
+
+    std::string line(record_bytes - 1, 'x');
+    line += '\n';
+
+    std::string ostream_path = prefix + ".ostream.log";
+    {
+        std::fstream fout{ostream_path, fout.binary | fout.trunc | fout.in | fout.out};
+        auto start = std::chrono::high_resolution_clock::now();
+        for(uint64_t idx = 0; idx < count; idx++){
+            fout << line << std::flush;
+        }
+        printf("ostream   : %12.0f records/sec\n", records_per_sec(start, count));
+    }
+    unlink(ostream_path.c_str());
+
+    std::string sink_prefix = prefix + ".sink";
+    log_sink sink = log_sink_create(sink_prefix.c_str(), 64*1024*1024, 0, fsync_s);
+    if(sink == NULL){
+        std::cout << "could not create the sink at " << sink_prefix << std::endl;
+        return 1;
+    }
+    uint32_t first = sink->seq;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(uint64_t idx = 0; idx < count; idx++){
+        log_sink_write(sink, line.data(), line.size());
+    }
+    printf("mmap sink : %12.0f records/sec (fsync every %g s)\n", records_per_sec(start, count), fsync_s);
+    uint32_t last = sink->seq;
+    log_sink_destroy(&sink);
+    for(uint32_t seq = first; seq <= last; seq++){
+        char path[4096];
+        snprintf(path, sizeof(path), "%s.%06u.log", sink_prefix.c_str(), seq);
+        unlink(path);
+    }
+    return 0;
+}
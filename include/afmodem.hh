@@ -90,6 +90,18 @@ int symstreamracf_set_gain(symstreamracf _q, float _gain);
 float symstreamracf_get_gain(symstreamracf _q);
 /* Get delay in samples                                                 */
 float symstreamracf_get_delay(symstreamracf _q);
+/* Snapshot of the running state of a symstreamracf object: filter     */
+/* history, resampler and buffered samples; the message source and its  */
+/* modulator are not part of it and play on                             */
+typedef struct symstreamracf_state_s *symstreamracf_state;
+/* Capture the current state of _q                                      */
+symstreamracf_state symstreamracf_snapshot(symstreamracf _q);
+/* Put _q back in a state captured from an object of the same           */
+/* parameters; a snapshot can be restored any number of times, into     */
+/* any number of objects, and is only read while restoring              */
+int symstreamracf_restore(symstreamracf _q, symstreamracf_state _s);
+/* Destroy a snapshot                                                   */
+int symstreamracf_state_destroy(symstreamracf_state _s);
 /* Write block of samples to output buffer                              */
 /*  _q      : synchronizer object                                       */
 /*  _buf    : output buffer [size: _buf_len x 1]                        */
@@ -133,14 +145,14 @@ struct analog_type_s {
 
 extern const struct analog_type_s analog_types[];
 
+// index of the named scheme in analog_types, -1 if there is none
+int analog_type_lookup(const char * _str);
+
 inline analog_scheme liquid_getopt_str2analog(const char * _str)
 {
-    // compare each string to short name
-    unsigned int i;
-    for (i=0; i<ANALOG_TYPE_COUNT; i++) {
-        if (strcmp(_str,analog_types[i].name)==0)
-            return (analog_scheme)i;
-    }
+    int i = analog_type_lookup(_str);
+    if (i >= 0)
+        return (analog_scheme)i;
     fprintf(stderr,"warning: liquid_getopt_str2analog(), unknown/unsupported analog scheme : %s\n", _str);
     return LIQUID_ANALOG_UNKNOWN;
 }
@@ -166,6 +178,7 @@ struct symstreamracf_analog_s {
     msresamp_crcf   arb_interp;     // arb_interp
     liquid_float_complex *            buf_internal;            // output buffer
     liquid_float_complex *            buf;            // output buffer
+    unsigned int    buf_len;        // capacity of buf
     unsigned int    buf_internal_index;      // output buffer sample index
     unsigned int    buf_index;      // output buffer sample index
     unsigned int    buf_size;
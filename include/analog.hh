@@ -122,6 +122,8 @@ struct ammod_s{
     real_source _mod_idx;
     real_source  bias_src;
     real_source  freq_src;
+    uint32_t scratch_len;           /// samples per scratch lane (grown on demand)
+    float   *scratch;               /// 3 lanes: mod_idx | bias | freq
 };
 ammod ammod_create();
 ammod ammod_create(double mod_idx, double bias, double freq);
@@ -710,6 +712,11 @@ struct real_path_s{
     real_source source;
     ammod modulator;
     msresamp_rrrf resampler;
+    firfilt_rrrf filter;            /// band-limit ahead of the resampler (NULL if none)
+    uint32_t blk_len;               /// capacity of blk_in (input rate samples)
+    uint32_t blk_out_len;           /// capacity of blk_out (output rate samples)
+    float *blk_in;                  /// block pulled from the source
+    float *blk_out;                 /// block produced by the resampler
     // Borrow from LIQUID's SYMSTREAMR
     // // allocate memory for main object
     // SYMSTREAMR() q = (SYMSTREAMR()) malloc( sizeof(struct SYMSTREAMR(_s)) );
@@ -732,6 +739,7 @@ real_path real_path_create(float input_fs, float output_fs, float bandwidth, flo
                             real_source source=NULL, ammod modulator=NULL, msresamp_rrrf resampler=NULL);
 void real_path_destroy(real_path *path);
 void real_path_print(real_path path, uint8_t indent=0);
+int real_path_reserve(real_path path, uint32_t n);/// size block buffers for n output samples
 int real_path_step(real_path path, float *out=NULL);
 int real_path_nstep(real_path path, uint32_t n, float *out=NULL);
 #else
@@ -741,6 +749,7 @@ real_path real_path_create(float input_fs, float output_fs, float bandwidth, flo
                             real_source source, ammod modulator, msresamp_rrrf resampler);
 void real_path_destroy(real_path *path);
 void real_path_print(real_path path, uint8_t indent);
+int real_path_reserve(real_path path, uint32_t n);/// size block buffers for n output samples
 int real_path_step(real_path path, float *out);
 int real_path_nstep(real_path path, uint32_t n, float *out);
 #endif
@@ -750,6 +759,8 @@ struct amgen_s{
     real_source mod_idx;
     double* path_gains;
     real_path* paths;
+    uint32_t scratch_len;           /// samples per scratch lane (grown on demand)
+    float *scratch;                 /// 2 lanes: sum | per-path dump
 };
 
 #ifdef __cplusplus
@@ -757,6 +768,7 @@ amgen amgen_create();
 amgen amgen_create(uint8_t num_paths, float mod_idx, double* gains, real_path *paths);
 void amgen_destroy(amgen *gen);
 int amgen_step(amgen gen, float *out=NULL);
+int amgen_reserve(amgen gen, uint32_t n);/// size scratch (and each path) for n samples
 int amgen_nstep(amgen gen, uint32_t n, float *out=NULL);
 int amgen_nstep(amgen gen, uint32_t n, liquid_float_complex *out=NULL);
 #else
@@ -764,6 +776,7 @@ amgen amgen_create_default();
 amgen amgen_create(uint8_t num_paths, float mod_idx, double* gains, real_path *paths);
 void amgen_destroy(amgen *gen);
 int amgen_step(amgen gen, float *out);
+int amgen_reserve(amgen gen, uint32_t n);/// size scratch (and each path) for n samples
 int amgen_nstepf(amgen gen, uint32_t n, float *out);
 int amgen_nstep(amgen gen, uint32_t n, liquid_float_complex *out);
 #endif
@@ -0,0 +1,73 @@
+#ifndef AUDIO_CACHE_HH
+#define AUDIO_CACHE_HH
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "wav.hh"
+
+// Pre-decoded audio corpus
+//
+// The corpus is decoded once to interleaved stereo float32 at a single
+// canonical rate and stored in one file:
+//
+//   [header][entry x file_count][pad to 4096][frames ...]
+//
+// The file name carries the corpus key (a hash of the path, size, mtime
+// and inode of every source wav plus the target rate), so any process
+// asking for the same corpus and rate maps the same file read-only and the
+// page cache is shared between them. Each entry also holds a hash of the
+// whole source data chunk, worked out once while building, which
+// audio_cache_verify() checks against the wavs on demand. Building is
+// serialized on a lock file next to the cache, so concurrent first users
+// decode once and everyone else waits and maps.
+
+#define AUDIO_CACHE_MAGIC "WFGENAC"
+#define AUDIO_CACHE_VERSION 3
+#define AUDIO_CACHE_ALIGN 4096
+
+#pragma pack(push, 1)
+typedef struct audio_cache_header_s{
+    char magic[8];
+    uint32_t version;
+    uint32_t sample_rate;       // rate every entry was resampled to
+    uint32_t channels;          // always 2, interleaved
+    uint32_t file_count;
+    uint64_t key;               // audio_cache_key() of the source corpus
+    uint64_t total_frames;
+    uint64_t data_offset;       // bytes from the start of the file to frame 0
+} audio_cache_header_t;
+
+typedef struct audio_cache_entry_s{
+    uint64_t hash;              // audio_cache_fingerprint() of the source wav
+    uint64_t frame_offset;      // frames from data_offset
+    uint64_t frame_count;
+    uint32_t src_rate;
+    uint32_t reserved;
+} audio_cache_entry_t;
+#pragma pack(pop)
+
+struct audio_cache_s{
+    char *path;
+    size_t map_len;
+    void *map;
+    const audio_cache_header_t *header;
+    const audio_cache_entry_t *entries;
+    const float *frames;
+};
+
+uint64_t audio_cache_fingerprint(wav_obj wav);
+uint64_t audio_cache_stamp(wav_obj wav);
+uint64_t audio_cache_key(wav_obj *wavs, uint32_t file_count, uint32_t sample_rate);
+int audio_cache_build(const char *path, wav_obj *wavs, uint32_t file_count, uint32_t sample_rate, uint64_t key);
+audio_cache audio_cache_map(const char *path, uint64_t key, uint32_t sample_rate, uint32_t file_count);
+audio_cache audio_cache_open(wav_obj *wavs, uint32_t file_count, uint32_t sample_rate, const char *cache_dir);
+int audio_cache_verify(audio_cache cache, wav_obj *wavs, uint32_t file_count);
+void audio_cache_destroy(audio_cache *cache);
+uint32_t audio_cache_sample_rate(audio_cache cache);
+uint64_t audio_cache_total_frames(audio_cache cache);
+uint64_t audio_cache_file_frames(audio_cache cache, uint32_t file_idx);
+const float* audio_cache_file_data(audio_cache cache, uint32_t file_idx);
+
+#endif // AUDIO_CACHE_HH
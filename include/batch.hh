@@ -0,0 +1,46 @@
+// render many scenario files to IQ and labels in one process
+#ifndef __BATCH_HH__
+#define __BATCH_HH__
+
+#include "scene.hh"
+#include "offline.hh"
+
+#ifdef __cplusplus
+#include <string>
+#include <vector>
+
+// a scenario file resolved to what is rendered for it
+struct batch_job {
+    std::string                scenario;    ///< path of the scenario file
+    std::string                iq_path;     ///< fc32 output
+    std::string                json_path;   ///< labels output
+    std::vector<scene_emitter> emitters;
+    offline_config             config;
+};
+
+// Load a scenario file (the flat JSON objects under scenarios/) as a one
+// emitter scene: profile names the waveform, rate/bw [Hz] its rate and
+// bandwidth, dwell and absence [s] its bursts (mode "static" is on
+// throughout), duration [s] the length of the clip and time_start when
+// its labels begin. The clip is the signal at baseband, labelled at the
+// center of freq_lo..freq_hi (or at frequency). Outputs are named after
+// the file in out_dir. Throws std::runtime_error.
+batch_job batch_job_load(const std::string & path, const std::string & out_dir);
+
+struct batch_stats {
+    size_t rendered;    ///< jobs written out
+    size_t failed;      ///< jobs that threw, reported on stderr
+    size_t reused;      ///< jobs rendered by the scene of the job before
+    size_t stolen;      ///< jobs run by another worker than planned
+};
+
+// Render jobs on num_workers threads (0 for all cores). Jobs are sorted
+// so that those with the same emitters are neighbours and handed out in
+// runs, one run per worker; a worker keeps its scene (generators, filters
+// and FFT plans) from one job to the next while the emitters match, and
+// once out of jobs takes them from the far end of another's run. Each job
+// renders in its worker alone, parallelism is across jobs.
+batch_stats batch_render(std::vector<batch_job> & jobs, unsigned int num_workers);
+#endif
+
+#endif /* __BATCH_HH__ */
@@ -0,0 +1,106 @@
+// blocks of signal synthesized ahead of the radio on a worker thread
+#ifndef BLOCK_STREAM_HH
+#define BLOCK_STREAM_HH
+
+#ifdef __cplusplus
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A bounded ring of blocks refilled by a background thread: while one block
+// is sent the next ones are synthesized, so memory stays at the number of
+// blocks however long the run is. The sender takes the blocks in order
+// with acquire() and hands each back with release(); the worker calls
+// fill() on every block handed back.
+template<class B>
+class block_stream {
+public:
+    typedef std::function<void(B &)> fill_t;
+
+    // The first num_ready blocks are already filled and go out first, the
+    // rest are filled by the worker.
+    block_stream(std::vector<B> blocks, unsigned int num_ready, fill_t fill) :
+        slots(blocks.size()), fill(fill), fill_idx(0), send_idx(0), running(true), waits(0)
+    {
+        for (size_t i=0; i<slots.size(); i++) {
+            slots[i].data  = std::move(blocks[i]);
+            slots[i].ready = i < num_ready;
+        }
+        fill_idx = num_ready % slots.size();
+        worker = std::thread(&block_stream::run, this);
+    }
+    ~block_stream() { stop(); }
+
+    // next block to send, waits for the worker if it fell behind; nullptr
+    // once the stream is stopped and the blocks filled before are sent
+    B * acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!slots[send_idx].ready)
+            waits++;
+        cv.wait(lock, [this]{ return slots[send_idx].ready || !running; });
+        return slots[send_idx].ready ? &slots[send_idx].data : nullptr;
+    }
+
+    // hand the block from acquire() back to be refilled
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[send_idx].ready = false;
+            send_idx = (send_idx + 1) % slots.size();
+        }
+        cv.notify_all();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        cv.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // number of times the sender had to wait on a block
+    unsigned int underruns() const { return waits; }
+
+private:
+    struct slot {
+        B data;
+        bool ready;
+    };
+
+    void run() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]{ return !slots[fill_idx].ready || !running; });
+                if (!running) return;
+            }
+            // the sender never touches a block that is not ready
+            slot &s = slots[fill_idx];
+            fill(s.data);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                s.ready = true;
+                fill_idx = (fill_idx + 1) % slots.size();
+            }
+            cv.notify_all();
+        }
+    }
+
+    std::vector<slot> slots;
+    fill_t fill;
+    size_t fill_idx, send_idx;
+    bool running;
+    unsigned int waits;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread worker;
+};
+#endif
+
+#endif // BLOCK_STREAM_HH
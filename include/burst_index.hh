@@ -0,0 +1,65 @@
+// time/frequency overlap index over bursts
+#ifndef __BURST_INDEX_HH__
+#define __BURST_INDEX_HH__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "containers.hh"
+
+// Boxes are kept sorted by start time as an implicit interval tree (every
+// node at the middle of its range of the sorted array) where each node
+// also carries the latest stop time below it. A query walks down from the
+// root and skips every subtree ending before the query starts, so finding
+// the k boxes overlapping a time span costs O(log n + k); the frequency
+// span is checked on the candidates.
+//
+// Boxes can be added at any time. Additions are sorted and merged into the
+// tree at the next query, which is cheap when they arrive in time order as
+// they do during generation, so add in batches and query after.
+
+#define BURST_INDEX_MAGIC "WFGENBI"
+#define BURST_INDEX_VERSION 1
+
+typedef struct burst_box_s{
+    double t0;          ///< start time [s]
+    double t1;          ///< stop time [s]
+    double f0;          ///< lower band edge [Hz]
+    double f1;          ///< upper band edge [Hz]
+    uint64_t id;        ///< caller's id, e.g. the label record index
+} burst_box_t;
+
+typedef struct burst_index_header_s{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t reserved2;
+} burst_index_header_t;
+
+typedef struct burst_index_s * burst_index;
+
+burst_index burst_index_create(uint64_t capacity);
+void burst_index_destroy(burst_index *bi);
+int burst_index_add(burst_index bi, double t0, double dur, double fc, double bw, uint64_t id);
+#ifdef __cplusplus
+int burst_index_add_cburst(burst_index bi, wfgen::containers::cburst b, uint64_t id);
+#else
+int burst_index_add_cburst(burst_index bi, cburst b, uint64_t id);
+#endif
+uint64_t burst_index_count(burst_index bi);
+// sort in pending boxes and rebuild the tree (queries do this themselves)
+int burst_index_build(burst_index bi);
+// ids of the boxes overlapping [t0,t1) x [f0,f1): the first max_ids are
+// written to ids and the total number of overlaps is returned
+uint64_t burst_index_query(burst_index bi, double t0, double t1, double f0, double f1,
+                           uint64_t *ids, uint64_t max_ids);
+// the i'th box in start time order
+const burst_box_t* burst_index_get(burst_index bi, uint64_t idx);
+
+// file is the header followed by the sorted boxes
+int burst_index_save(burst_index bi, const char *path);
+burst_index burst_index_load(const char *path);
+
+#endif /* __BURST_INDEX_HH__ */
@@ -0,0 +1,83 @@
+#ifndef CHANSYNTH_HH
+#define CHANSYNTH_HH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#ifdef __cplusplus
+#include <complex>
+#else
+#include <complex.h>
+#endif
+#include "liquid.h"
+
+// report error specifically for invalid object configuration
+static inline void * liquid_error_config_cs(const char * _file,
+                              int          _line,
+                              const char * _format,
+                              ...)
+{
+    int code = LIQUID_EICONFIG;
+#if !LIQUID_SUPPRESS_ERROR_OUTPUT
+    va_list argptr;
+    va_start(argptr, _format);
+    fprintf(stderr,"error [%d]: %s\n", code, liquid_error_info((liquid_error_code)code));
+    fprintf(stderr,"  %s:%u: ", _file, _line);
+    vfprintf(stderr, _format, argptr);
+    fprintf(stderr,"\n");
+    va_end(argptr);
+#endif
+#if LIQUID_STRICT_EXIT
+    exit(code);
+#endif
+    return NULL;
+}
+
+//
+// channelized synthesis: many baseband streams onto one wideband output
+//
+// The output band is cut into M channels spaced 1/M apart (relative to the
+// output rate), channel k centered at k/M wrapped into [-0.5,0.5). Every
+// channel takes a baseband stream at 2/M of the output rate; each input
+// sample on all channels yields M/2 output samples. The streams go through
+// a polyphase filterbank and one inverse FFT, so the cost per output sample
+// is O(m + log M) no matter how many channels are busy, where mixing each
+// stream up on its own costs O(busy channels).
+//
+// A stream should stay within about +/-0.25 of its channel rate (its own
+// channel's width); anything wider leaks into the neighbours.
+struct chansynth_s;
+typedef struct chansynth_s *chansynth;
+
+/* Create channel synthesizer                                           */
+//  _num_channels   : number of channels M, even, [2,4096]
+//  _m              : prototype filter semi-length (input samples), > 0
+//  _as             : prototype filter stop-band attenuation [dB], > 0
+chansynth chansynth_create(unsigned int _num_channels,
+                           unsigned int _m,
+                           float        _as);
+/* Destroy channel synthesizer, freeing all internal memory             */
+int chansynth_destroy(chansynth _q);
+/* Clear the filterbank history                                         */
+int chansynth_reset(chansynth _q);
+/* Get number of channels                                               */
+unsigned int chansynth_get_num_channels(chansynth _q);
+/* Get output samples per channel sample, M/2                           */
+unsigned int chansynth_get_interp(chansynth _q);
+/* Get delay from input to output, in output samples                    */
+float chansynth_get_delay(chansynth _q);
+/* Get center frequency of channel _k relative to the output rate      */
+float chansynth_get_channel_fc(chansynth _q, unsigned int _k);
+/* Get channel nearest to the relative frequency _fc                    */
+unsigned int chansynth_get_channel(chansynth _q, float _fc);
+/* Synthesize a block                                                   */
+//  _x      : per channel input buffers [size: M, each _n x 1], NULL for
+//            an idle channel, _x itself may be NULL for all idle
+//  _n      : samples per channel
+//  _y      : output buffer [size: _n*M/2 x 1]
+int chansynth_execute(chansynth _q, liquid_float_complex **_x, unsigned int _n,
+                      liquid_float_complex *_y);
+
+#endif // CHANSYNTH_HH
@@ -93,6 +93,21 @@ int symstreamrfcf_set_gain(symstreamrfcf _q, float _gain);
 float symstreamrfcf_get_gain(symstreamrfcf _q);
 /* Get delay in samples                                                 */
 float symstreamrfcf_get_delay(symstreamrfcf _q);
+/* Draw symbols from a private generator seeded with _seed instead of   */
+/* rand(), so the stream is reproducible (0 goes back to rand())        */
+int symstreamrfcf_set_seed(symstreamrfcf _q, uint32_t _seed);
+/* Snapshot of the running state of a symstreamrfcf object: modulator,  */
+/* filter history, resampler and buffered samples; the symbol           */
+/* generator seed is included, so a restored stream repeats itself      */
+typedef struct symstreamrfcf_state_s *symstreamrfcf_state;
+/* Capture the current state of _q                                      */
+symstreamrfcf_state symstreamrfcf_snapshot(symstreamrfcf _q);
+/* Put _q back in a state captured from an object of the same           */
+/* parameters; a snapshot can be restored any number of times, into     */
+/* any number of objects, and is only read while restoring              */
+int symstreamrfcf_restore(symstreamrfcf _q, symstreamrfcf_state _s);
+/* Destroy a snapshot                                                   */
+int symstreamrfcf_state_destroy(symstreamrfcf_state _s);
 /* Write block of samples to output buffer                              */
 /*  _q      : synchronizer object                                       */
 /*  _buf    : output buffer [size: _buf_len x 1]                        */
@@ -139,14 +154,14 @@ struct fsk_type_s {
 #define FSK_TYPE_COUNT 33
 extern const struct fsk_type_s fsk_types[];
 
+// index of the named scheme in fsk_types, -1 if there is none
+int fsk_type_lookup(const char * _str);
+
 inline fsk_scheme liquid_getopt_str2fsk(const char * _str)
 {
-    // compare each string to short name
-    unsigned int i;
-    for (i=0; i<FSK_TYPE_COUNT; i++) {
-        if (strcmp(_str,fsk_types[i].name)==0)
-            return (fsk_scheme)i;
-    }
+    int i = fsk_type_lookup(_str);
+    if (i >= 0)
+        return (fsk_scheme)i;
     fprintf(stderr,"warning: liquid_getopt_str2fsk(), unknown/unsupported fsk scheme : %s\n", _str);
     return LIQUID_FSK_UNKNOWN;
 }
@@ -172,9 +187,11 @@ struct symstreamrfcf_fsk_s {
     msresamp_crcf   arb_interp;     // arb_interp
     liquid_float_complex *            buf_internal;            // output buffer
     liquid_float_complex *            buf;            // output buffer
+    unsigned int    buf_len;        // capacity of buf
     unsigned int    buf_internal_index;      // output buffer sample index
     unsigned int    buf_index;      // output buffer sample index
     unsigned int    buf_size;
+    uint32_t        seed;           // symbol generator state, 0 uses rand()
 };
 
 
@@ -0,0 +1,310 @@
+// common interface over the symbol stream generators
+#ifndef __GENERATOR_HH__
+#define __GENERATOR_HH__
+
+#include "liquid.h"
+#include "fskmodems.hh"
+#include "afmodem.hh"
+#include "noisemodem.hh"
+
+#ifdef __cplusplus
+#include <complex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace wfgen{
+namespace generators{
+
+// Each modem family has its own C API (symstreamrcf from liquid, and
+// symstreamrfcf, symstreamracf and symstreamrncf from here). generator<D>
+// puts one face on all of them: the adapter D supplies do_write,
+// do_set_gain, do_get_delay and do_reset, and code written against
+// generator<D> is compiled once per family with the calls resolved
+// statically, so nothing virtual sits in the sample loops.
+template<class D>
+class generator{
+  public:
+    int write(std::complex<float> * buf, unsigned int n) { return self().do_write(buf, n); }
+    int set_gain(float gain) { return self().do_set_gain(gain); }
+    float get_delay() { return self().do_get_delay(); }
+    int reset() { return self().do_reset(); }
+
+    // One hop at baseband: on at half scale for dwell samples, then off
+    // for the rest of buf. The off stretch is at least twice the filter
+    // delay (or squelch, if longer) so the hop is flushed before the next;
+    // dwell is cut short to make room for it. dwell == 0 is on for all
+    // but the off stretch.
+    //
+    // A sparse hop stops once the filters are flushed, leaving the rest
+    // of buf unwritten for the sender to express as silence. Returns the
+    // number of samples written.
+    unsigned int write_hop(std::complex<float> * buf, unsigned int buf_len,
+                           unsigned int dwell, unsigned int squelch, bool sparse = false)
+    {
+        unsigned int flush = 2*(unsigned int) (get_delay() + 1.5f);
+        if (dwell == 0 || dwell > buf_len){
+            squelch = 0;
+            dwell = buf_len;
+        }
+        unsigned int dead_time = (flush > squelch) ? flush : squelch;
+        if (buf_len < dead_time)
+            throw std::runtime_error("requested hop duration too small (d:"+std::to_string(buf_len)
+                +",0:"+std::to_string(dead_time)+")");
+        unsigned int num_samples_on = (buf_len < dwell+dead_time) ? buf_len-dead_time : dwell;
+        unsigned int num_samples_off = sparse ? flush : buf_len - num_samples_on;
+
+        set_gain(0.5f);
+        write(buf, num_samples_on);
+        set_gain(0.0f);
+        write(buf + num_samples_on, num_samples_off);
+        return num_samples_on + num_samples_off;
+    }
+
+  protected:
+    D & self() { return *static_cast<D*>(this); }
+};
+
+// Owns one C object; API names its handle type and C functions
+template<class API>
+class stream : public generator<stream<API> >{
+  public:
+    typedef typename API::handle handle;
+
+    // takes ownership of q, e.g. stream<linear_api>(symstreamrcf_create_linear(...))
+    explicit stream(handle q) : q(q) {
+        if (q == NULL)
+            throw std::runtime_error("could not create symbol stream");
+    }
+    ~stream() { if (q != NULL) API::destroy(q); }
+    stream(stream && o) : q(o.q) { o.q = NULL; }
+    stream & operator=(stream && o) {
+        if (this != &o) {
+            if (q != NULL) API::destroy(q);
+            q = o.q;
+            o.q = NULL;
+        }
+        return *this;
+    }
+    stream(const stream &) = delete;
+    stream & operator=(const stream &) = delete;
+
+    handle get() const { return q; }
+
+    int do_write(std::complex<float> * buf, unsigned int n) { return API::write_samples(q, buf, n); }
+    int do_set_gain(float gain) { return API::set_gain(q, gain); }
+    float do_get_delay() { return API::get_delay(q); }
+    int do_reset() { return API::reset(q); }
+
+  private:
+    handle q;
+};
+
+struct linear_api{
+    typedef symstreamrcf handle;
+    static int destroy(handle q) { return symstreamrcf_destroy(q); }
+    static int write_samples(handle q, std::complex<float> * buf, unsigned int n) { return symstreamrcf_write_samples(q, buf, n); }
+    static int set_gain(handle q, float gain) { return symstreamrcf_set_gain(q, gain); }
+    static float get_delay(handle q) { return symstreamrcf_get_delay(q); }
+    static int reset(handle q) { return symstreamrcf_reset(q); }
+};
+
+struct fsk_api{
+    typedef symstreamrfcf handle;
+    static int destroy(handle q) { return symstreamrfcf_destroy(q); }
+    static int write_samples(handle q, std::complex<float> * buf, unsigned int n) { return symstreamrfcf_write_samples(q, buf, n); }
+    static int set_gain(handle q, float gain) { return symstreamrfcf_set_gain(q, gain); }
+    static float get_delay(handle q) { return symstreamrfcf_get_delay(q); }
+    static int reset(handle q) { return symstreamrfcf_reset(q); }
+    typedef symstreamrfcf_state state;
+    static state snapshot(handle q) { return symstreamrfcf_snapshot(q); }
+    static int restore(handle q, state s) { return symstreamrfcf_restore(q, s); }
+    static int state_destroy(state s) { return symstreamrfcf_state_destroy(s); }
+};
+
+struct analog_api{
+    typedef symstreamracf handle;
+    static int destroy(handle q) { return symstreamracf_destroy(q); }
+    static int write_samples(handle q, std::complex<float> * buf, unsigned int n) { return symstreamracf_write_samples(q, buf, n); }
+    static int set_gain(handle q, float gain) { return symstreamracf_set_gain(q, gain); }
+    static float get_delay(handle q) { return symstreamracf_get_delay(q); }
+    static int reset(handle q) { return symstreamracf_reset(q); }
+    typedef symstreamracf_state state;
+    static state snapshot(handle q) { return symstreamracf_snapshot(q); }
+    static int restore(handle q, state s) { return symstreamracf_restore(q, s); }
+    static int state_destroy(state s) { return symstreamracf_state_destroy(s); }
+};
+
+struct noise_api{
+    typedef symstreamrncf handle;
+    static int destroy(handle q) { return symstreamrncf_destroy(q); }
+    static int write_samples(handle q, std::complex<float> * buf, unsigned int n) { return symstreamrncf_write_samples(q, buf, n); }
+    static int set_gain(handle q, float gain) { return symstreamrncf_set_gain(q, gain); }
+    static float get_delay(handle q) { return symstreamrncf_get_delay(q); }
+    static int reset(handle q) { return symstreamrncf_reset(q); }
+    typedef symstreamrncf_state state;
+    static state snapshot(handle q) { return symstreamrncf_snapshot(q); }
+    static int restore(handle q, state s) { return symstreamrncf_restore(q, s); }
+    static int state_destroy(state s) { return symstreamrncf_state_destroy(s); }
+};
+
+// Running state captured from a stream, restored into it or any stream
+// of the same parameters as often as needed, e.g. to start each hop or
+// each thread from the same primed filters instead of from silence.
+// liquid's symstreamrcf cannot be captured, so there is none for
+// linear_api.
+template<class API>
+class warm_start{
+  public:
+    explicit warm_start(const stream<API> & gen) : s(API::snapshot(gen.get())) {
+        if (s == NULL)
+            throw std::runtime_error("could not capture symbol stream state");
+    }
+    ~warm_start() { if (s != NULL) API::state_destroy(s); }
+    warm_start(warm_start && o) : s(o.s) { o.s = NULL; }
+    warm_start & operator=(warm_start && o) {
+        if (this != &o) {
+            if (s != NULL) API::state_destroy(s);
+            s = o.s;
+            o.s = NULL;
+        }
+        return *this;
+    }
+    warm_start(const warm_start &) = delete;
+    warm_start & operator=(const warm_start &) = delete;
+
+    // the state is only read, so threads may restore from one warm_start
+    void restore(stream<API> & gen) const {
+        if (API::restore(gen.get(), s) != LIQUID_OK)
+            throw std::runtime_error("symbol stream state is of a stream with other parameters");
+    }
+
+  private:
+    typename API::state s;
+};
+
+typedef stream<linear_api> linear_generator;
+typedef stream<fsk_api>    fsk_generator;
+typedef stream<analog_api> analog_generator;
+typedef stream<noise_api>  noise_generator;
+
+// Linear modulation built as liquid's symstreamrcf is (2 samples per
+// symbol through the pulse shape, then resampled to the bandwidth), but
+// drawing its symbols from a private xorshift generator instead of rand(),
+// so that the output depends only on seed and streams in different
+// threads do not contend on rand()'s lock.
+class seeded_linear_generator : public generator<seeded_linear_generator>{
+  public:
+    seeded_linear_generator(int ftype, float bw, unsigned int m, float beta,
+                            modulation_scheme ms, uint32_t seed) :
+        mod(NULL), interp(NULL), resamp(NULL), seed(seed ? seed : 1), gain(1.0f),
+        m(m), index(2), buf_index(0), buf_size(0)
+    {
+        if (bw < 0.001f || bw > 0.999f || m == 0 || beta <= 0.0f || beta > 1.0f)
+            throw std::runtime_error("invalid linear symbol stream parameters");
+        mod = modemcf_create(ms);
+        interp = firinterp_crcf_create_prototype(ftype, 2, m, beta, 0);
+        resamp = msresamp_crcf_create(0.5f/bw, 60.0f);
+        if (mod == NULL || interp == NULL || resamp == NULL) {
+            destroy();
+            throw std::runtime_error("could not create symbol stream");
+        }
+        M = 1U << modemcf_get_bps(mod);
+        buf.resize(1 << liquid_nextpow2((unsigned int)ceilf(0.5f/bw)));
+    }
+    ~seeded_linear_generator() { destroy(); }
+    seeded_linear_generator(seeded_linear_generator && o) :
+        mod(o.mod), interp(o.interp), resamp(o.resamp), seed(o.seed), gain(o.gain),
+        M(o.M), m(o.m), index(o.index), buf_index(o.buf_index), buf_size(o.buf_size),
+        buf(std::move(o.buf))
+    {
+        o.mod = NULL;
+        o.interp = NULL;
+        o.resamp = NULL;
+        for (unsigned int i=0; i<2; i++)
+            symbols[i] = o.symbols[i];
+    }
+    seeded_linear_generator(const seeded_linear_generator &) = delete;
+    seeded_linear_generator & operator=(const seeded_linear_generator &) = delete;
+
+    int do_write(std::complex<float> * out, unsigned int n) {
+        for (unsigned int i=0; i<n; i++) {
+            while (buf_index == buf_size) {
+                buf_index = 0;
+                msresamp_crcf_execute(resamp, next(), 1, buf.data(), &buf_size);
+            }
+            out[i] = buf[buf_index++];
+        }
+        return LIQUID_OK;
+    }
+    int do_set_gain(float g) { gain = g; return LIQUID_OK; }
+    float do_get_delay() {
+        return (2*m + msresamp_crcf_get_delay(resamp))*msresamp_crcf_get_rate(resamp);
+    }
+    // restart the symbol sequence from _seed (0 is taken as 1)
+    int set_seed(uint32_t _seed) { seed = _seed ? _seed : 1; return LIQUID_OK; }
+    int do_reset() {
+        firinterp_crcf_reset(interp);
+        msresamp_crcf_reset(resamp);
+        index = 2;
+        buf_index = buf_size = 0;
+        return LIQUID_OK;
+    }
+
+  private:
+    // next pulse shaped sample at 2 samples per symbol
+    std::complex<float> * next() {
+        if (index == 2) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            std::complex<float> v;
+            modemcf_modulate(mod, seed % M, &v);
+            firinterp_crcf_execute(interp, v*gain, symbols);
+            index = 0;
+        }
+        return &symbols[index++];
+    }
+    void destroy() {
+        if (mod != NULL) modemcf_destroy(mod);
+        if (interp != NULL) firinterp_crcf_destroy(interp);
+        if (resamp != NULL) msresamp_crcf_destroy(resamp);
+    }
+
+    modemcf        mod;
+    firinterp_crcf interp;
+    msresamp_crcf  resamp;
+    uint32_t       seed;
+    float          gain;
+    unsigned int   M;
+    unsigned int   m;
+    unsigned int   index;       // next of symbols[] to resample
+    unsigned int   buf_index;   // next of buf[] to write out
+    unsigned int   buf_size;
+    std::complex<float> symbols[2];
+    std::vector<std::complex<float> > buf;
+};
+
+// unmodulated carrier, the gain itself on every sample
+class tone_generator : public generator<tone_generator>{
+  public:
+    tone_generator() : gain(1.0f) {}
+
+    int do_write(std::complex<float> * buf, unsigned int n) {
+        for (unsigned int i=0; i<n; i++)
+            buf[i] = gain;
+        return LIQUID_OK;
+    }
+    int do_set_gain(float g) { gain = g; return LIQUID_OK; }
+    float do_get_delay() { return 0.0f; }
+    int do_reset() { return LIQUID_OK; }
+
+  private:
+    float gain;
+};
+
+} // namespace generators
+} // namespace wfgen
+#endif
+
+#endif /* __GENERATOR_HH__ */
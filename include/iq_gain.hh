@@ -0,0 +1,37 @@
+#ifndef IQ_GAIN_HH
+#define IQ_GAIN_HH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#ifdef __cplusplus
+#include <complex>
+#else
+#include <complex.h>
+#endif
+#include "liquid.h"
+
+// Peak tracking and gain folded into the SC16 conversion
+//
+// Generators report the peak of each piece of signal while it is still in
+// cache, and the send stage scales and quantizes in one go on its way out,
+// so a buffer is never swept again just to normalize it:
+//
+//     peak = iq_peak(hop, hop_len, peak);          // per hop, as written
+//     gain = iq_gain(peak, 0.5f);                  // once per buffer
+//     iq_to_sc16(buf, chunk, gain, sc16);          // per send chunk
+//
+// A peak is the largest |I| or |Q|, the value that clips first.
+
+#define IQ_SC16_FULL_SCALE 32767.0f
+
+// largest |I| or |Q| over _x, or _peak if that is larger
+float iq_peak(const liquid_float_complex *_x, size_t _n, float _peak);
+// gain putting _peak at _level (relative to full scale), 1 for silence
+float iq_gain(float _peak, float _level);
+// scale by _gain and round to interleaved I/Q int16, saturating
+//  _y      : output buffer [size: 2*_n x 1]
+void iq_to_sc16(const liquid_float_complex *_x, size_t _n, float _gain, int16_t *_y);
+
+#endif // IQ_GAIN_HH
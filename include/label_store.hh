@@ -0,0 +1,99 @@
+// binary ground truth labels
+#ifndef __LABEL_STORE_HH__
+#define __LABEL_STORE_HH__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// Columnar label file
+//
+//   [file header][block][block]...
+//
+// Every block starts with a block header. Records are stored in record
+// blocks of up to block_records rows, each column contiguous:
+//
+//   t0 f64[n] | dur f64[n] | fc f64[n] | bw f64[n] | mod u16[n] | meta u32[n]
+//
+// mod indexes signal_modulation_list and meta indexes the file's string
+// table (0 is the empty string), which is carried in string blocks ahead
+// of the record blocks that use them. An attribute block with the signal
+// and source fields of the JSON report (key\0value\0 pairs) closes the
+// file. Blocks are only ever appended whole, so a reader stops cleanly at
+// a block cut short by a crash and keeps everything before it.
+
+#define LABEL_STORE_MAGIC "WFGENLB"
+#define LABEL_STORE_VERSION 1
+#define LABEL_STORE_BLOCK_RECORDS 4096
+
+#define LABEL_STORE_MOD_UNSET 0xffff        // modulation never set, written as "unknown"
+
+#define LABEL_BLOCK_RECORDS 1
+#define LABEL_BLOCK_STRINGS 2
+#define LABEL_BLOCK_ATTRS   3
+
+typedef struct label_store_header_s{
+    char magic[8];
+    uint32_t version;
+    uint32_t block_records;
+    uint64_t reserved[2];
+} label_store_header_t;
+
+typedef struct label_block_header_s{
+    uint32_t kind;
+    uint32_t count;             // records or strings in the block
+    uint64_t bytes;             // payload bytes after this header, multiple of 8
+    uint64_t first;             // index of the first record or string
+    uint64_t reserved;
+} label_block_header_t;
+
+// column pointers of one record block, straight into the file
+typedef struct label_block_s{
+    uint64_t first;
+    uint32_t count;
+    const double *t0;
+    const double *dur;
+    const double *fc;
+    const double *bw;
+    const uint16_t *mod;
+    const uint32_t *meta;
+} label_block_t;
+
+typedef struct label_record_s{
+    double t0;
+    double dur;
+    double fc;
+    double bw;
+    uint16_t mod;
+    const char *meta;
+} label_record_t;
+
+typedef struct label_writer_s * label_writer;
+typedef struct label_reader_s * label_reader;
+
+// writer
+label_writer label_writer_create(const char *path, uint32_t block_records);
+int label_writer_append(label_writer w, double t0, double dur, double fc, double bw, uint16_t mod, const char *meta);
+int label_writer_set_attr(label_writer w, const char *key, const char *value);
+int label_writer_flush(label_writer w);                    /// write the pending block
+void label_writer_destroy(label_writer *w);                 /// flush, write attributes, close
+
+// reader, the file is mapped read-only
+label_reader label_reader_open(const char *path);
+void label_reader_destroy(label_reader *r);
+uint64_t label_reader_count(label_reader r);
+uint32_t label_reader_num_blocks(label_reader r);
+const label_block_t* label_reader_block(label_reader r, uint32_t idx);
+int label_reader_get(label_reader r, uint64_t idx, label_record_t *rec);
+const char* label_reader_meta(label_reader r, uint32_t id);
+const char* label_reader_attr(label_reader r, const char *key);
+// write the records back out in the labels JSON schema
+int label_reader_to_json(label_reader r, FILE *fid);
+// pieces of the document for merging files: the energy and signal reports
+// (instance names end in suffix) and the source report over signals
+// (NULL for the file's own signal), each without a trailing separator
+int label_reader_reports_json(label_reader r, FILE *fid, const char *suffix);
+int label_reader_source_json(label_reader r, FILE *fid, const char *suffix, const char **signals, uint32_t num_signals);
+
+#endif /* __LABEL_STORE_HH__ */
@@ -7,6 +7,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include "modulation.hh"
+#include "label_store.hh"
+#include "burst_index.hh"
 #ifdef __cplusplus
 class labels
 {
@@ -25,30 +27,36 @@ class labels
 
     // set modulation type based on liquid-dsp enumeration
     void set_modulation(modulation_scheme _ms)
-        { modulation.assign(signal_modulation_list[ signal_modulation_map_ms_to_index(_ms) ].name_label);
-          modulation_origin.assign(signal_modulation_list[ signal_modulation_map_ms_to_index(_ms) ].name_label);
-          modulation_family.assign(signal_modulation_list[ signal_modulation_map_ms_to_index(_ms) ].family_label); }
+        { set_modulation_index(signal_modulation_map_ms_to_index(_ms)); }
     void set_modulation(fsk_scheme _ms)
-        { modulation.assign(signal_modulation_list[ signal_modulation_map_msf_to_index(_ms) ].name_label);
-          modulation_origin.assign(signal_modulation_list[ signal_modulation_map_msf_to_index(_ms) ].name_label);
-          modulation_family.assign(signal_modulation_list[ signal_modulation_map_msf_to_index(_ms) ].family_label); }
+        { set_modulation_index(signal_modulation_map_msf_to_index(_ms)); }
     void set_modulation(analog_scheme _ms)
-        { modulation.assign(signal_modulation_list[ signal_modulation_map_msa_to_index(_ms) ].name_label);
-          modulation_origin.assign(signal_modulation_list[ signal_modulation_map_msa_to_index(_ms) ].name_label);
-          modulation_family.assign(signal_modulation_list[ signal_modulation_map_msa_to_index(_ms) ].family_label); }
+        { set_modulation_index(signal_modulation_map_msa_to_index(_ms)); }
     void set_modulation(noise_scheme _ms)
-        { modulation.assign(signal_modulation_list[ signal_modulation_map_msn_to_index(_ms) ].name_label);
-          modulation_origin.assign(signal_modulation_list[ signal_modulation_map_msn_to_index(_ms) ].name_label);
-          modulation_family.assign(signal_modulation_list[ signal_modulation_map_msn_to_index(_ms) ].family_label); }
+        { set_modulation_index(signal_modulation_map_msn_to_index(_ms)); }
     void set_modulation(std::string _modulation)
-        { modulation.assign(signal_modulation_list[ signal_modulation_map_label_to_index(_modulation) ].name_label);
-          modulation_origin.assign(signal_modulation_list[ signal_modulation_map_label_to_index(_modulation) ].name_label);
-          modulation_family.assign(signal_modulation_list[ signal_modulation_map_label_to_index(_modulation) ].family_label); }
+        { set_modulation_index(signal_modulation_map_label_to_index(_modulation)); }
+
+    /// also write every report to a columnar binary label file (see
+    /// label_store.hh); the signal and source fields go in at finalize
+    bool enable_binary(std::string _path, uint32_t block_records=LABEL_STORE_BLOCK_RECORDS);
+
+    /// also index every report by time and frequency (see burst_index.hh),
+    /// ids are report numbers; the index is saved to _path at finalize
+    bool enable_index(std::string _path);
 
     void finalize(){ json_close(); }
 
     void cache_to_misc(std::string);
 
+    /// write out buffered reports once this many bytes are pending or
+    /// this many seconds have passed since the last write
+    void set_flush_policy(size_t bytes, double seconds)
+        { flush_bytes = bytes; flush_seconds = seconds; }
+
+    /// write buffered reports now, the file is a complete document after
+    void flush();
+
   protected:
     std::string  filename;  ///< name of file to write
     std::string  prefix;    ///< prefix for energy reports
@@ -66,12 +74,43 @@ class labels
     /// file handle
     FILE * fid;
 
+    // Reports are formatted into buf and written in large chunks. Every
+    // write ends with a closing tail that makes the file a complete
+    // document; the next write starts over the tail. Memory stays bounded
+    // by flush_bytes whatever the number of reports.
+    std::string  buf;
+    size_t       flush_bytes;
+    double       flush_seconds;
+    double       last_flush;
+    long         tail_len;  ///< bytes of closing tail currently at the end of the file
+    bool         in_reports;
+
     // open file and close, then reopen (flagging other processes)
     void json_init();
 
+    // printf into buf
+    void emit(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+    // write buf (and the closing tail if with_tail) over the previous tail
+    void write_out(bool with_tail);
+
     // finalize and close file
     void json_close();
 
+    // save the index, write the attributes and close the binary file
+    void binary_close();
+
+    void set_modulation_index(unsigned int _idx)
+        { modulation_index = _idx;
+          modulation.assign(signal_modulation_list[_idx].name_label);
+          modulation_origin.assign(signal_modulation_list[_idx].name_label);
+          modulation_family.assign(signal_modulation_list[_idx].family_label); }
+
+    unsigned int modulation_index;  ///< signal_modulation_list entry of the current modulation
+    label_writer binary;            ///< optional binary copy of the reports
+    burst_index  index;             ///< optional time/frequency index of the reports
+    std::string  index_path;
+
   public:
     // energy/signal characteristics
     std::string protocol;
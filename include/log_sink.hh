@@ -0,0 +1,67 @@
+#ifndef LOG_SINK_HH
+#define LOG_SINK_HH
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// Memory mapped, rotating log file sink
+//
+// Records are appended with a memcpy into a pre-sized, shared mapping of
+// the current segment file <prefix>.<seq>.log, so writing a record is not
+// a syscall. A segment is closed and the next one opened once the next
+// record would not fit or the segment is older than rotate_seconds.
+//
+// The last LOG_SINK_TRAILER_BYTES of an open segment hold a trailer with
+// the number of bytes committed so far; it is advanced after each record
+// is in place, so after a crash everything before it is whole records and
+// log_sink_recover() cuts the file back to exactly that. A segment that
+// is closed cleanly is truncated to its data and is then plain text.
+//
+// Durability: fsync_interval == 0 syncs after every record, > 0 at most
+// once per that many seconds, < 0 leaves it to the kernel (rotation and
+// close still sync). The trailer may run ahead of what reached the disk
+// only for records written since the last sync.
+
+#define LOG_SINK_MAGIC "WFGENLT"
+#define LOG_SINK_TRAILER_BYTES 64
+
+typedef struct log_sink_trailer_s{
+    char magic[8];
+    uint64_t committed;         // bytes of whole records from offset 0
+    uint64_t records;
+    uint32_t seq;
+    uint8_t reserved[LOG_SINK_TRAILER_BYTES - 8 - 2*sizeof(uint64_t) - sizeof(uint32_t)];
+} log_sink_trailer_t;
+
+typedef struct log_sink_s * log_sink;
+
+struct log_sink_s{
+    char *prefix;
+    char *path;                 // current segment
+    uint64_t segment_bytes;     // data capacity of a segment
+    double rotate_seconds;      // <= 0 rotates on size only
+    double fsync_interval;
+    uint32_t seq;
+    int fd;
+    uint8_t *map;
+    uint64_t map_len;           // data capacity + trailer
+    uint64_t cursor;            // bytes written to this segment
+    uint64_t synced;            // bytes of this segment known to be synced
+    double opened_at;
+    double synced_at;
+    uint64_t records;           // over all segments
+    log_sink_trailer_t *trailer;
+};
+
+log_sink log_sink_create(const char *prefix, uint64_t segment_bytes, double rotate_seconds, double fsync_interval);
+void log_sink_destroy(log_sink *sink);
+int log_sink_write(log_sink sink, const void *data, uint64_t len);
+int log_sink_sync(log_sink sink);
+int log_sink_rotate(log_sink sink);
+uint64_t log_sink_records(log_sink sink);
+const char* log_sink_path(log_sink sink);
+int64_t log_sink_recover(const char *path);     /// bytes kept, -1 if not an open segment
+
+#endif // LOG_SINK_HH
@@ -14,13 +14,18 @@
 #include <map>
 #include <condition_variable>
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include "log_sink.hh"
 
 typedef enum _payload_type{
   CHAR,
   UCHAR,
   CHAR16,
   CHAR32,
-  WCHAR
+  WCHAR,
+  EVENT
 } payload_t;
 
 typedef struct{
@@ -30,6 +35,76 @@ typedef struct{
   void *buffer;
 } payload;
 
+// Wire format (version 2): every record starts with a fixed 24 byte header
+// that is read in place. The body either follows inline, and more records
+// may follow it in the same frame (a batch), or with PAYLOAD_BODY_NEXT_FRAME
+// set it is the whole of the next zmq frame, so a client can hand its buffer
+// to zmq without a copy. Version 1 records ("wfgen:" key, inline body) are
+// still read.
+#define PAYLOAD_WIRE_VERSION 2
+#define PAYLOAD_BODY_NEXT_FRAME 0x01
+
+typedef struct{
+  char key[5];          // "wfgen"
+  uint8_t version;
+  uint8_t type;         // payload_t
+  uint8_t flags;
+  double timestamp;
+  uint64_t length;      // body length in items of type
+} payload_header;
+static_assert(sizeof(payload_header) == 24, "payload_header is a wire format");
+
+typedef struct{// a record read in place, nothing is copied
+  double timestamp;
+  payload_t type;
+  uint8_t flags;
+  uint64_t length;
+  const void *body;     // nullptr if the body is in the next frame
+} payload_view;
+
+// Structured events: a numeric id and a few typed fields, sent as an EVENT
+// payload of one log_event and only turned into text by the server. Meant
+// for metrics in hot loops where formatting text would cost more than the
+// work being measured.
+#define LOG_EVENT_MAX_FIELDS 6
+
+typedef enum{
+  EVENT_NONE,
+  EVENT_I64,
+  EVENT_U64,
+  EVENT_F64
+} event_field_t;
+
+typedef struct{
+  uint32_t id;
+  uint8_t count;
+  uint8_t kinds[LOG_EVENT_MAX_FIELDS];   // event_field_t
+  uint8_t reserved[5];
+  union{
+    int64_t i;
+    uint64_t u;
+    double f;
+  } values[LOG_EVENT_MAX_FIELDS];
+} log_event;
+static_assert(sizeof(log_event) == 64, "log_event is a wire format");
+
+inline log_event make_log_event(uint32_t id){
+  log_event e;
+  memset(&e, 0, sizeof(e));
+  e.id = id;
+  return e;
+}
+uint8_t log_event_add(log_event &e, int64_t v);
+uint8_t log_event_add(log_event &e, uint64_t v);
+uint8_t log_event_add(log_event &e, double v);
+inline uint8_t log_event_add(log_event &e, int32_t v){ return log_event_add(e, (int64_t)v); }
+inline uint8_t log_event_add(log_event &e, uint32_t v){ return log_event_add(e, (uint64_t)v); }
+inline uint8_t log_event_add(log_event &e, float v){ return log_event_add(e, (double)v); }
+void print_event(std::ostream &os, double timestamp, const log_event &e,
+                 const std::map<uint32_t, std::string> &names);
+
+size_t write_payload_header(void *s, payload_t type, double timestamp, uint64_t length, uint8_t flags=0);
+uint8_t read_payload_view(payload_view *v, const void *s, size_t l, size_t *used);
 uint16_t get_payload_itemsize(payload_t &type);
 size_t get_sizeof_payload(payload &p);
 uint8_t serialize_payload(void **s, size_t *l, payload &p);
@@ -64,8 +139,89 @@ namespace logger{
   //     {INFO,      "INFO"},
   //     {DEBUG,     "DEBUG"},
   const char * set_level(level_t l);
+
+  // bounded single producer / single consumer queue; the producer is the
+  // thread logging through a client, the consumer its sender thread
+  template<typename T>
+  class spsc_queue{
+   public:
+    explicit spsc_queue(size_t min_capacity){
+      size_t capacity = 1;
+      while(capacity < min_capacity) capacity <<= 1;
+      slots = std::vector<T>(capacity);
+      mask = capacity - 1;
+      head.store(0);
+      tail.store(0);
+    }
+    bool push(T &&v){
+      size_t h = head.load(std::memory_order_relaxed);
+      if(h - tail.load(std::memory_order_acquire) > mask) return false;// full
+      slots[h & mask] = std::move(v);
+      head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+    bool pop(T &v){
+      size_t t = tail.load(std::memory_order_relaxed);
+      if(t == head.load(std::memory_order_acquire)) return false;// empty
+      v = std::move(slots[t & mask]);
+      tail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+    // in place: the producer fills the slot from claim() and publish()es
+    // it, the consumer reads the slot from front() and drop()s it; both
+    // return nullptr when there is nothing to claim or read
+    T* claim(){
+      size_t h = head.load(std::memory_order_relaxed);
+      if(h - tail.load(std::memory_order_acquire) > mask) return nullptr;// full
+      return &slots[h & mask];
+    }
+    void publish(){
+      head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    T* front(){
+      size_t t = tail.load(std::memory_order_relaxed);
+      if(t == head.load(std::memory_order_acquire)) return nullptr;// empty
+      return &slots[t & mask];
+    }
+    void drop(){
+      tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    size_t size() const {
+      return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    size_t capacity() const { return mask + 1; }
+   private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+  };
+
+  // one record of an async client, header and body, formatted in place in
+  // the client's queue; longer bodies are cut to whole items
+  #define LOG_ASYNC_SLOT_BYTES 256
+  struct async_slot{
+    char data[LOG_ASYNC_SLOT_BYTES - sizeof(uint32_t)];
+    uint32_t bytes;
+  };
 }
 
+// a received frame; records point into it, so it is held until the last
+// of them is written and then goes back to its worker's pool
+struct log_frame{
+  zmq::message_t msg;
+  uint32_t refs;
+  uint8_t owner;
+};
+// a record as held by the server: parsed once on ingest, written once on flush
+typedef struct{
+  double timestamp;
+  payload_t type;
+  const char *body;
+  size_t bytes;
+  log_frame *frame;
+} log_record;
+
 std::ostream& operator<<(logger_server &log, char * const &t );
 std::ostream& operator<<(logger_client &log, char * const &t );
 std::ostream& operator<<(logger_server &log, const char * const &t );
@@ -75,11 +231,16 @@ std::ostream& operator<<(logger_client &log, const logger::level_t &t);
 
 
 
+// endpoint of shard idx behind a sharded server's base address: tcp ports
+// count up from the base port, other transports get "-idx" appended
+std::string logger_shard_addr(const std::string &base, uint32_t idx);
+
 class logger_client{//don't fork/share
  private:
   std::string header;
   std::string header_tag;
   std::string z_frontend_addr;
+  std::string z_shard_base;
   std::stringstream streamer;
   logger::level_t level;
   double last_timestamp;
@@ -99,11 +260,23 @@ class logger_client{//don't fork/share
 
   uint8_t enabled;
 
+  // async mode: commit() only serializes into a queue slot, a sender thread
+  // batches records into multipart DEALER messages
+  std::unique_ptr<logger::spsc_queue<logger::async_slot>> a_queue;
+  std::thread a_thread;
+  std::atomic<bool> a_running;
+  std::atomic<uint64_t> a_dropped;
+  std::atomic<uint64_t> a_sent;
+  std::atomic<uint64_t> a_truncated;
+  size_t a_batch;
+
   void _init_defaults();
   void add_header();
 
   void setup_network();
   void shutdown_network();
+  void async_sender();
+  uint8_t send_frames(zmq::message_t &head, zmq::message_t *body);
 
  public:
   logger_client();
@@ -112,11 +285,21 @@ class logger_client{//don't fork/share
 
   void connect();
   void disable();
+  void set_shards(uint32_t shards);// steer to a shard by client id, before enable_async()
 
   uint8_t commit(payload_t t=CHAR);
+  uint8_t emit(const log_event &e);
   void flush();
   uint8_t is_connected(){ return !z_connected; }
 
+  uint8_t enable_async(size_t queue_len=4096, size_t batch=64);
+  void disable_async();
+  bool is_async(){ return a_running.load(); }
+  size_t queue_depth(){ return (a_queue) ? a_queue->size() : 0; }
+  uint64_t dropped(){ return a_dropped.load(); }
+  uint64_t sent(){ return a_sent.load(); }
+  uint64_t truncated(){ return a_truncated.load(); }// records cut to fit a slot
+
   std::string debug_me(double &ts);
 
   friend std::ostream& operator<<( logger_client &log, char * const &t );
@@ -135,11 +318,43 @@ class logger_server{//don't fork/share
   std::mutex q_mutex;
   std::mutex qe_mutex;
   std::condition_variable q_event;
-  std::queue<std::string> holder;
+  // each worker appends to its own inbox, flush() moves the inboxes into a
+  // min-heap on timestamp and writes out whatever is below the watermark
+  struct alignas(64) worker_inbox{
+    std::mutex lock;
+    std::atomic<uint64_t> ingested;// records ever appended, under lock
+    std::vector<log_record> records;
+    std::vector<log_frame*> spare;
+    std::vector<std::unique_ptr<log_frame>> frames;// every frame it made
+  };
+  std::unique_ptr<worker_inbox[]> inboxes;// z_workers + 1 for local records
+  std::vector<log_record> heap;
+  std::vector<log_record> incoming;
+  std::vector<log_frame*> released;// written out; shard frames wait here while their returns queue is full
+  std::atomic<uint64_t> written;// records ever flushed; pending is ingested - written
+  double reorder_window;
+  std::map<uint32_t, std::string> event_names;
+  log_sink sink;// when set, flush() appends here instead of to dumper
+  std::ostringstream event_text;
   double last_timestamp;
 
   uint8_t z_running;
   uint8_t z_workers;
+  // sharded mode: no broker, each ingest thread binds its own ROUTER and
+  // hands records over lock-free, frames come back the same way
+  uint8_t z_shards;
+  struct shard_queues{
+    logger::spsc_queue<log_record> records;// ingest -> flush
+    logger::spsc_queue<log_frame*> returns;// flush -> ingest
+    std::vector<std::unique_ptr<log_frame>> frames;
+    alignas(64) std::atomic<uint64_t> ingested;// written by the shard only
+    // the shard sleeps here while records is full, flush() wakes it
+    std::mutex drain_lock;
+    std::condition_variable drained;
+    std::atomic<bool> blocked;
+    shard_queues(size_t len) : records(len), returns(len), ingested(0), blocked(false) {}
+  };
+  std::vector<std::unique_ptr<shard_queues>> shards;
   zmq::context_t z_context;
   zmq::socket_t z_frontend;
   zmq::socket_t z_backend;
@@ -152,25 +367,36 @@ class logger_server{//don't fork/share
   logger_client *log_c;
 
   void _init_defaults();
-  void sort_holder();
+  void merge_inboxes();
+  void write_events(const log_record &r);
+  log_frame* take_frame(uint8_t rank);
+  void release_frames();
 
   void setup_network();
   void broker();
   void enqueue_worker(uint8_t rank);
+  void shard_worker(uint8_t rank);
+  uint8_t parse_frames(log_frame **parts, size_t count, std::vector<log_record> &out);
 
  public:
   logger_server();
   logger_server(std::string tag,std::ostream &s,
                 std::string frontend_addr,
-                std::string backend_addr);
+                std::string backend_addr,
+                uint8_t shards=0);
   ~logger_server();
 
   uint8_t commit(payload_t t=CHAR);
-  void flush();
+  void flush();// records older than now - reorder window
+  void flush(double watermark);// records with timestamp <= watermark
+  void flush_all();
+  void set_reorder_window(double seconds){ reorder_window = seconds; }
+  void name_event(uint32_t id, std::string name);
+  void set_sink(log_sink s);// not owned, nullptr goes back to dumper
 
   void stop();
   void wait();
-  bool empty(){ return holder.empty(); }
+  bool empty();
   uint8_t hold_for(double timeout);
   uint8_t hold_for(double timeout, bool(pred)());
   uint8_t hold_for(double timeout, std::function<bool()> pred);
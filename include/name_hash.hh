@@ -0,0 +1,119 @@
+// compile-time lookup tables for the modulation name/scheme maps
+#ifndef __NAME_HASH_HH__
+#define __NAME_HASH_HH__
+
+#include <stdint.h>
+#include <string.h>
+
+// The name tables are plain const arrays for C and constexpr for C++, so
+// the C++ build can lay perfect hash tables over them at compile time.
+#ifdef __cplusplus
+#define WFGEN_CONSTEXPR constexpr
+#else
+#define WFGEN_CONSTEXPR
+#endif
+
+#ifdef __cplusplus
+#include <stddef.h>
+
+namespace name_hash{
+
+// FNV-1a with the seed folded into the offset basis
+constexpr uint32_t hash(const char *s, uint32_t seed){
+    uint32_t h = 2166136261u ^ (seed*0x9e3779b9u);
+    for(; *s; s++){
+        h ^= (uint8_t)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr bool equal(const char *a, const char *b){
+    while(*a && *a == *b){
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+// Perfect hash over the names of a table: every name owns its own slot,
+// so a lookup is one hash and one strcmp. SLOTS is a power of two; a few
+// times the number of names keeps the seed search short.
+template<uint32_t SLOTS>
+struct table{
+    uint32_t seed;
+    int16_t index[SLOTS];       ///< table entry of each slot, -1 if empty
+    const char *name[SLOTS];
+
+    /// table entry named s, -1 if there is none
+    int find(const char *s) const {
+        uint32_t slot = hash(s, seed) & (SLOTS - 1);
+        int idx = index[slot];
+        return (idx >= 0 && strcmp(name[slot], s) == 0) ? idx : -1;
+    }
+};
+
+template<uint32_t SLOTS, class T, size_t N>
+constexpr table<SLOTS> make_table(const T (&items)[N], const char * const T::*field){
+    static_assert((SLOTS & (SLOTS - 1)) == 0, "SLOTS must be a power of two");
+    static_assert(N < SLOTS && N < 32768, "too many names for the table");
+    for(uint32_t seed = 0; seed < 100000; seed++){
+        table<SLOTS> t{};
+        t.seed = seed;
+        for(uint32_t slot = 0; slot < SLOTS; slot++){
+            t.index[slot] = -1;
+            t.name[slot] = nullptr;
+        }
+        bool ok = true;
+        for(size_t i = 0; i < N && ok; i++){
+            const char *name = items[i].*field;
+            // a repeated name keeps its first entry, as the linear scans did
+            bool repeat = false;
+            for(size_t j = 0; j < i && !repeat; j++)
+                repeat = equal(items[j].*field, name);
+            if(repeat) continue;
+            uint32_t slot = hash(name, seed) & (SLOTS - 1);
+            if(t.index[slot] >= 0){
+                ok = false;
+                break;
+            }
+            t.index[slot] = (int16_t)i;
+            t.name[slot] = name;
+        }
+        if(ok) return t;
+    }
+    throw "no perfect hash seed found, raise SLOTS";
+}
+
+// Direct map from an enumeration value to the first table entry with it
+template<size_t COUNT>
+struct scheme_index{
+    uint8_t index[COUNT];
+
+    unsigned int find(int value, unsigned int fallback) const {
+        return (value >= 0 && (size_t)value < COUNT) ? index[value] : fallback;
+    }
+};
+
+template<size_t COUNT, class T, size_t N, class E>
+constexpr scheme_index<COUNT> make_scheme_index(const T (&items)[N], E T::*field,
+                                                E unknown, unsigned int fallback){
+    static_assert(N <= 255, "table too long for the index");
+    scheme_index<COUNT> s{};
+    for(size_t value = 0; value < COUNT; value++){
+        s.index[value] = (uint8_t)fallback;
+        if(value == (size_t)unknown) continue;
+        for(size_t i = 0; i < N; i++){
+            if((size_t)(items[i].*field) == value){
+                s.index[value] = (uint8_t)i;
+                break;
+            }
+        }
+    }
+    return s;
+}
+
+} // namespace name_hash
+#endif
+
+#endif /* __NAME_HASH_HH__ */
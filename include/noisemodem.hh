@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdarg.h>
 #include <math.h>
@@ -87,6 +88,20 @@ int symstreamrncf_set_gain(symstreamrncf _q, float _gain);
 float symstreamrncf_get_gain(symstreamrncf _q);
 /* Get delay in samples                                                 */
 float symstreamrncf_get_delay(symstreamrncf _q);
+/* Draw noise from a private generator seeded with _seed instead of     */
+/* rand(), so the stream is reproducible (0 goes back to rand())        */
+int symstreamrncf_set_seed(symstreamrncf _q, uint32_t _seed);
+/* Snapshot of the running state of a symstreamrncf object: modulator,  */
+/* filter history, resampler, buffered samples and generator seed       */
+typedef struct symstreamrncf_state_s *symstreamrncf_state;
+/* Capture the current state of _q                                      */
+symstreamrncf_state symstreamrncf_snapshot(symstreamrncf _q);
+/* Put _q back in a state captured from an object of the same           */
+/* parameters; a snapshot can be restored any number of times, into     */
+/* any number of objects, and is only read while restoring              */
+int symstreamrncf_restore(symstreamrncf _q, symstreamrncf_state _s);
+/* Destroy a snapshot                                                   */
+int symstreamrncf_state_destroy(symstreamrncf_state _s);
 /* Write block of samples to output buffer                              */
 /*  _q      : synchronizer object                                       */
 /*  _buf    : output buffer [size: _buf_len x 1]                        */
@@ -110,14 +125,14 @@ struct noise_type_s {
 #define noise_type_count 3
 extern const struct noise_type_s noise_types[];
 
+// index of the named scheme in noise_types, -1 if there is none
+int noise_type_lookup(const char * _str);
+
 inline noise_scheme liquid_getopt_str2noise(const char * _str)
 {
-    // compare each string to short name
-    unsigned int i;
-    for (i=0; i<noise_type_count; i++) {
-        if (strcmp(_str,noise_types[i].name)==0)
-            return noise_types[i].scheme;
-    }
+    int i = noise_type_lookup(_str);
+    if (i >= 0)
+        return noise_types[i].scheme;
     fprintf(stderr,"warning: liquid_getopt_str2noise(), unknown/unsupported noise scheme : %s\n", _str);
     return LIQUID_NOISE_UNKNOWN;
 }
@@ -167,9 +182,11 @@ struct symstreamrncf_noise_s {
     msresamp_crcf   arb_interp;     // arb_interp
     liquid_float_complex *            buf_internal;            // output buffer
     liquid_float_complex *            buf;            // output buffer
+    unsigned int    buf_len;        // capacity of buf
     unsigned int    buf_internal_index;      // output buffer sample index
     unsigned int    buf_index;      // output buffer sample index
     unsigned int    buf_size;
+    uint32_t        seed;           // noise generator state, 0 uses rand()
 };
 
 
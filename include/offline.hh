@@ -0,0 +1,46 @@
+// render a scene to file as fast as the cores allow, no radio involved
+#ifndef __OFFLINE_HH__
+#define __OFFLINE_HH__
+
+#include "scene.hh"
+#include "writer.hh"
+
+#ifdef __cplusplus
+#include <string>
+#include <vector>
+
+struct offline_config {
+    double       sample_rate;   ///< [Hz]
+    double       duration;      ///< length of the recording [s]
+    double       center_freq;   ///< labelled center of the recording [Hz]
+    double       start_time;    ///< labelled time of the first sample [s]
+    double       segment_time;  ///< length rendered by one thread at a time [s]
+    unsigned int block_len;     ///< samples per scene render within a segment
+    unsigned int num_threads;   ///< 0 uses all cores
+    uint32_t     seed;          ///< symbols of the scene, see scene::scene()
+
+    offline_config() :
+        sample_rate(20e6), duration(1.0), center_freq(0.0), start_time(0.0),
+        segment_time(0.1), block_len(65536), num_threads(0), seed(1) {}
+};
+
+// Render duration seconds of the scene of emitters to iq_path as fc32 and
+// their bursts to reporter (may be nullptr). The recording is cut into
+// segments rendered independently, one per thread, each starting a
+// settling time early so the filters are primed at its first sample; the
+// segments are written and labelled in order through the writer. Analog
+// emitters cannot seek their audio, so they are rendered straight through
+// by one scene as the segments are written. Returns the largest |I|/|Q|
+// written; throws std::runtime_error if the file cannot be written.
+float offline_render(const std::vector<scene_emitter> & emitters, const offline_config & config,
+                     const std::string & iq_path, labels * reporter);
+
+// Render with an existing scene from its start, in this thread, a block at
+// a time; config.segment_time and num_threads do not apply. The scene's
+// generators are reused as they are, so one scene may render many files;
+// config.seed does not apply either, the scene has its own.
+float offline_render(scene & sc, const offline_config & config,
+                     const std::string & iq_path, labels * reporter);
+#endif
+
+#endif /* __OFFLINE_HH__ */
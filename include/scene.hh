@@ -0,0 +1,134 @@
+// composite scene of many emitters summed into one wideband stream
+#ifndef __SCENE_HH__
+#define __SCENE_HH__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "liquid.h"
+#include "fskmodems.hh"
+#include "afmodem.hh"
+#include "noisemodem.hh"
+
+// kind of generator behind an emitter
+typedef enum {
+    SCENE_LINEAR=0,     // liquid linear modulation (scheme: modulation_scheme)
+    SCENE_FSK,          // fsk/cpfsk/msk/gmsk (scheme: fsk_scheme)
+    SCENE_ANALOG,       // am/fm (scheme: analog_scheme)
+    SCENE_NOISE,        // band-limited noise (scheme: noise_scheme)
+    SCENE_OFDM,         // wideband ofdm (scheme: modulation_scheme of the subcarriers)
+    SCENE_TONE,         // unmodulated carrier (no scheme)
+    SCENE_KIND_COUNT
+} scene_kind;
+
+// mask of emitter kinds, see scene::scene()
+#define SCENE_KIND_BIT(k)   (1u << (k))
+#define SCENE_KINDS_ALL     ((1u << SCENE_KIND_COUNT) - 1)
+
+#ifdef __cplusplus
+#include <complex>
+#include <memory>
+#include <string>
+#include <vector>
+#include "labels.hh"
+
+// One emitter of a scene. Frequencies and bandwidths are relative to the
+// scene's sample rate, times are in seconds from the start of the scene.
+// An emitter is on from start to stop, in bursts of on_time separated by
+// off_time if on_time > 0.
+struct scene_emitter {
+    scene_kind   kind;
+    int          scheme;        ///< scheme of the kind, see scene_kind
+    float        fc;            ///< offset from the scene center, [-0.5,0.5]
+    float        bw;            ///< occupied bandwidth, (0,1)
+    float        gain_db;       ///< gain relative to the generator's nominal level
+    double       start;         ///< first burst [s]
+    double       stop;          ///< end [s], < 0 runs as long as the scene
+    double       on_time;       ///< burst length [s], <= 0 is on throughout
+    double       off_time;      ///< silence between bursts [s]
+    unsigned int k;             ///< fsk: samples per symbol
+    float        mod_index;     ///< fsk/analog modulation index
+    unsigned int cpf_type;      ///< cpfsk pulse shape
+    float        src_freq;      ///< analog: message frequency, relative to the rate
+    unsigned int nfft;          ///< ofdm: transform size
+
+    scene_emitter();
+};
+
+// Parse an emitter from comma separated key=value pairs, e.g.
+//   "type=fsk,mod=gmsk,fc=-0.2,bw=0.01,gain=-6,on=0.02,off=0.1"
+// keys: type, mod, fc, bw, gain, start, stop, on, off, k, index, cpf,
+// src, nfft; throws std::invalid_argument on anything else.
+scene_emitter scene_emitter_parse(const std::string & spec);
+
+// truth of one burst of one emitter
+struct scene_burst {
+    unsigned int emitter;       ///< index of the emitter in the scene
+    double       t0;            ///< start [s from the scene start]
+    double       dur;           ///< length [s]
+    float        fc;            ///< center, relative to the rate
+    float        bw;            ///< bandwidth, relative to the rate
+};
+
+class scene_source;
+
+// The engine owns one generator per emitter. render() produces the next
+// block of the scene: the emitters are written in parallel, each at
+// baseband into its own lane and mixed up to its offset, then the lanes
+// are summed in parallel over the samples. Emitters that are off for the
+// whole block (filters flushed) cost nothing.
+class scene
+{
+  public:
+    // duration [s] ends every emitter, < 0 for an open-ended scene; an
+    // emitter on throughout an open-ended scene is labelled in 1 s pieces.
+    // The symbols of every emitter are drawn from seed, so scenes of one
+    // seed write the same signal. Only emitters of the kinds in the mask
+    // get a generator, the others stay silent but keep their index, so the
+    // bursts of scenes built over one emitter list with disjoint masks
+    // label alike.
+    scene(const std::vector<scene_emitter> & emitters, double sample_rate, double duration=-1,
+          uint32_t seed=1, unsigned int kinds=SCENE_KINDS_ALL);
+    ~scene();
+
+    // write the next n samples to buf, appending the bursts that start in
+    // them to bursts; returns the largest |I|/|Q| written (see iq_gain.hh)
+    float render(std::complex<float> * buf, unsigned int n, std::vector<scene_burst> * bursts=nullptr);
+
+    // write bursts to a label file, the scene starting at time start and
+    // centered on center_freq [Hz]
+    void report(labels * reporter, const std::vector<scene_burst> & bursts,
+                double start, double center_freq) const;
+
+    // continue from sample t of the scene as if rendered up to it, but with
+    // the filters empty; bursts already under way at t are not reported.
+    // The symbols from t on depend only on the seed and t, not on what the
+    // scene rendered before.
+    void seek(uint64_t t);
+    // samples from a seek until the filters carry a steady signal again
+    unsigned int settling() const;
+
+    unsigned int num_emitters() const { return (unsigned int)emitters.size(); }
+    unsigned int num_lanes() const;     ///< emitters rendered, see the kinds mask
+    const scene_emitter & emitter(unsigned int i) const { return emitters[i]; }
+    uint64_t get_time() const { return clock; }     ///< samples rendered so far
+
+  protected:
+    struct lane;
+
+    double                     rate;
+    uint32_t                   seed;
+    uint64_t                   clock;
+    std::vector<scene_emitter> emitters;
+    std::vector<lane>          lanes;
+    std::vector<unsigned int>  active;  ///< lanes written in the current block
+
+    void render_lane(lane & l, unsigned int n, unsigned int index);
+};
+#else
+typedef struct scene_s{
+
+} scene;
+
+#endif
+#endif /* __SCENE_HH__ */
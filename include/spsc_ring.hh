@@ -0,0 +1,52 @@
+#ifndef SPSC_RING_HH
+#define SPSC_RING_HH
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#ifndef __cplusplus
+#include <stdalign.h>
+#endif
+
+// Single producer / single consumer float ring
+//
+// Capacity is a power of two (and a whole number of pages). The storage is
+// mapped twice back to back, so data[i] and data[i+capacity] are the same
+// memory and every readable or writable region is one contiguous span, no
+// matter where it starts. If the double mapping cannot be made the ring
+// falls back to a 2x buffer and mirrors each commit into the other half.
+//
+// The producer only moves head and the consumer only moves tail; each sits
+// on its own cache line, and the fields both sides only read on a third,
+// so the ring itself is allocated cache line aligned. Neither side takes a
+// lock.
+
+#define SPSC_RING_CACHE_LINE 64
+
+typedef struct spsc_ring_s * spsc_ring;
+
+struct spsc_ring_s{
+    alignas(SPSC_RING_CACHE_LINE) uint64_t head;    /// total floats committed (producer)
+    alignas(SPSC_RING_CACHE_LINE) uint64_t tail;    /// total floats released (consumer)
+    alignas(SPSC_RING_CACHE_LINE) uint64_t capacity;/// floats, power of two
+    uint64_t mask;
+    uint8_t mirrored;                               /// 1 if data is double mapped
+    float *data;
+};
+
+spsc_ring spsc_ring_create(uint64_t min_capacity);
+void spsc_ring_destroy(spsc_ring *ring);
+void spsc_ring_reset(spsc_ring ring);                       /// only with both sides idle
+uint64_t spsc_ring_capacity(spsc_ring ring);
+uint64_t spsc_ring_size(spsc_ring ring);                    /// floats readable
+uint64_t spsc_ring_space(spsc_ring ring);                   /// floats writable
+// producer side
+uint64_t spsc_ring_write_ptr(spsc_ring ring, float **ptr);  /// contiguous writable span
+int spsc_ring_commit(spsc_ring ring, uint64_t n);
+uint64_t spsc_ring_write(spsc_ring ring, const float *in, uint64_t n);
+// consumer side
+uint64_t spsc_ring_read_ptr(spsc_ring ring, float **ptr);   /// contiguous readable span
+int spsc_ring_release(spsc_ring ring, uint64_t n);
+
+#endif // SPSC_RING_HH
@@ -11,7 +11,9 @@
 #include <vector>
 #endif
 #include <sys/mman.h>
+#include <pthread.h>
 #include "liquid.h"
+#include "spsc_ring.hh"
 
 typedef enum{
     NONE=-1,
@@ -40,19 +42,34 @@ typedef struct wav_obj_s{
     void* data_ptr;
 } wav_obj_t;
 typedef wav_obj_t* wav_obj;
+typedef struct audio_cache_s * audio_cache;
 
 
+// longest wav_reader_data_ptr() sleeps on an empty ring before it reports
+// an underrun [ns]
+#define WAV_READER_WAIT_NS 5000000
+
 typedef struct wav_reader_s{
-    uint8_t file_count;
-    uint8_t file_idx;
+    uint32_t file_count;
+    uint32_t file_idx;
     uint8_t itemsize;
     uint64_t sample_length;
     uint64_t processed;
+    uint64_t position;      // reader sample the consumer reads next, consumer side only
     uint32_t prefetch;
     wav_mode_t read_as;
     wav_obj *wavs;
-    uint32_t *offsets;
-    cbufferf buffer;
+    uint64_t *offsets;      // position within each file [samples]
+    uint64_t *starts;       // prefix sum of file lengths, file_count+1 entries [samples]
+    spsc_ring buffer;       // decoded stereo floats, filled by the prefetch thread
+    audio_cache cache;      // pre-decoded corpus, NULL to decode from the wavs
+    uint8_t prefetching;    // 1 while the prefetch thread owns the producer side
+    pthread_t prefetcher;
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake;    // signalled by the consumer when it frees space
+    pthread_cond_t filled;  // signalled by the prefetch thread when it publishes to a starved consumer
+    uint8_t starved;        // 1 while the consumer waits on filled
+    uint64_t underruns;     // reads that found nothing even after waiting, see wav_reader_data_ptr()
 } wav_reader_t;
 typedef wav_reader_t* wav_reader;
 
@@ -67,22 +84,29 @@ void destroy_wav_obj(wav_obj* wav_ptr);
 #ifdef __cplusplus
 void print_wav_info(wav_obj wav, uint8_t mode, uint32_t offset=0, int32_t length=25);
 #endif
+int wav_decode_span(wav_obj wav, uint32_t start_idx, uint32_t stereo_samples, float* out_ptr);
 int index_wav(wav_obj wav, uint32_t start_idx, uint32_t stereo_samples, float* out_ptr);
 
 #ifdef __cplusplus
 wav_reader wav_reader_create();
-wav_reader wav_reader_create(wav_mode_t mode, uint8_t file_count, char **filepaths, uint32_t prefetch=20000);
+wav_reader wav_reader_create(wav_mode_t mode, uint32_t file_count, char **filepaths, uint32_t prefetch=20000);
 uint64_t wav_reader_data_ptr(wav_reader wav, float* &ptr);
 #else
 wav_reader wav_reader_create_default();
-wav_reader wav_reader_create(wav_mode_t mode, uint8_t file_count, char **filepaths, uint32_t prefetch);
+wav_reader wav_reader_create(wav_mode_t mode, uint32_t file_count, char **filepaths, uint32_t prefetch);
 uint64_t wav_reader_data_ptr(wav_reader wav, float* ptr);
 #endif
 void wav_reader_destroy(wav_reader *wav);
+int wav_reader_attach_cache(wav_reader wav, uint32_t sample_rate, const char *cache_dir);
+uint64_t wav_reader_file_frames(wav_reader wav, uint32_t file_idx);
+int wav_reader_build_index(wav_reader wav);
 uint8_t wav_reader_sample_bytes(wav_reader wav);
 uint64_t wav_reader_fill_buffer(wav_reader wav);
+int wav_reader_start_prefetch(wav_reader wav);
+int wav_reader_stop_prefetch(wav_reader wav);
 uint64_t wav_reader_advance(wav_reader wav, uint64_t samples);
 int wav_reader_set_offset(wav_reader wav, uint64_t offset);
+uint32_t wav_reader_set_offsets(wav_reader *readers, const uint64_t *offsets, uint32_t count);
 uint64_t wav_reader_get_len(wav_reader wav);
 uint64_t wav_reader_get_offset(wav_reader wav);
 uint64_t wav_reader_samples_processed(wav_reader wav);
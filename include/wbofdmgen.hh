@@ -32,7 +32,7 @@ class wbofdmgen
     unsigned int get_buf_len(unsigned int symbols) const {
         return (nfft+cplen)*symbols; }
 
-    //
+    // fill _buf with symbols, unscaled
     void generate(std::complex<float> * _buf, unsigned int symbols);
 
   protected:
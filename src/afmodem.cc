@@ -3,8 +3,9 @@
 #include <iostream>
 #endif
 #include "afmodem.hh"
+#include "name_hash.hh"
 
-const struct analog_type_s analog_types[ANALOG_TYPE_COUNT] = {
+WFGEN_CONSTEXPR const struct analog_type_s analog_types[ANALOG_TYPE_COUNT] = {
     // name      fullname                         scheme          bps
 
     // unknown
@@ -33,6 +34,25 @@ const struct analog_type_s analog_types[ANALOG_TYPE_COUNT] = {
     {"fm_chirp_nonlin", "analog_fm_chirp_nonlin", LIQUID_ANALOG_FM_CHIRP_NONLIN,1},
 };
 
+#ifdef __cplusplus
+static constexpr auto analog_type_table = name_hash::make_table<128>(analog_types, &analog_type_s::name);
+#endif
+
+int analog_type_lookup(const char * _str)
+{
+#ifdef __cplusplus
+    return analog_type_table.find(_str);
+#else
+    // compare each string to short name
+    unsigned int i;
+    for (i=0; i<ANALOG_TYPE_COUNT; i++) {
+        if (strcmp(_str,analog_types[i].name)==0)
+            return i;
+    }
+    return -1;
+#endif
+}
+
 #define liquid_error_config(format, ...) \
     liquid_error_config_al(__FILE__, __LINE__, format, ##__VA_ARGS__);
 
@@ -124,9 +144,9 @@ symstreamracf symstreamracf_create_analog(int          _ftype,
     q->arb_interp = msresamp_crcf_create(q->rate, 60.0f);
 
     // printf("Internal(Symbol) buffer length = %u\n",2);
-    unsigned int buf_len = 1 << liquid_nextpow2((unsigned int)ceilf(q->rate));
-    // printf("External(Sample) buffer length = %u\n",buf_len);
-    q->buf = (liquid_float_complex*) malloc(buf_len*sizeof(liquid_float_complex));
+    q->buf_len = 1 << liquid_nextpow2((unsigned int)ceilf(q->rate));
+    // printf("External(Sample) buffer length = %u\n",q->buf_len);
+    q->buf = (liquid_float_complex*) malloc(q->buf_len*sizeof(liquid_float_complex));
 
     // reset and return main object
     symstreamracf_reset(q);
@@ -268,6 +288,78 @@ int symstreamracf_set_scheme(symstreamracf _q, int _ms){
     return LIQUID_OK;
 }
 
+// running state, each object a copy of the one in the stream
+struct symstreamracf_state_s {
+    int             mod_scheme;     // parameters of the stream, to check a restore against
+    unsigned int    k;
+    unsigned int    m;
+    float           rate;
+    unsigned int    buf_len;
+    firinterp_crcf  interp;
+    msresamp_crcf   arb_interp;
+    liquid_float_complex * buf_internal;    // [size: k x 1]
+    liquid_float_complex * buf;             // [size: buf_size x 1]
+    unsigned int    buf_internal_index;
+    unsigned int    buf_index;
+    unsigned int    buf_size;
+};
+
+symstreamracf_state symstreamracf_snapshot(symstreamracf _q)
+{
+    if (_q == NULL)
+        return (symstreamracf_state)liquid_error_config("symstreamracf_snapshot(), object cannot be NULL");
+
+    symstreamracf_state s = (symstreamracf_state) malloc(sizeof(struct symstreamracf_state_s));
+    s->mod_scheme = _q->mod_scheme;
+    s->k          = _q->k;
+    s->m          = _q->m;
+    s->rate       = _q->rate;
+    s->buf_len    = _q->buf_len;
+    s->interp     = firinterp_crcf_copy(_q->interp);
+    s->arb_interp = msresamp_crcf_copy(_q->arb_interp);
+
+    s->buf_internal = (liquid_float_complex*) malloc(_q->k*sizeof(liquid_float_complex));
+    memmove(s->buf_internal, _q->buf_internal, _q->k*sizeof(liquid_float_complex));
+    s->buf = (liquid_float_complex*) malloc((_q->buf_size+1)*sizeof(liquid_float_complex));
+    memmove(s->buf, _q->buf, _q->buf_size*sizeof(liquid_float_complex));
+
+    s->buf_internal_index = _q->buf_internal_index;
+    s->buf_index          = _q->buf_index;
+    s->buf_size           = _q->buf_size;
+    return s;
+}
+
+int symstreamracf_restore(symstreamracf _q, symstreamracf_state _s)
+{
+    // the buffers and resampler are sized by these, so nothing else fits
+    if (_s->mod_scheme != _q->mod_scheme || _s->k != _q->k || _s->m != _q->m ||
+        _s->rate != _q->rate || _s->buf_len != _q->buf_len)
+        return fprintf(stderr,"symstreamracf_restore(), snapshot is of a stream with other parameters\n");
+
+    // liquid objects cannot be overwritten in place, so take fresh copies
+    firinterp_crcf_destroy(_q->interp);
+    _q->interp = firinterp_crcf_copy(_s->interp);
+    msresamp_crcf_destroy(_q->arb_interp);
+    _q->arb_interp = msresamp_crcf_copy(_s->arb_interp);
+
+    memmove(_q->buf_internal, _s->buf_internal, _s->k*sizeof(liquid_float_complex));
+    memmove(_q->buf, _s->buf, _s->buf_size*sizeof(liquid_float_complex));
+    _q->buf_internal_index = _s->buf_internal_index;
+    _q->buf_index          = _s->buf_index;
+    _q->buf_size           = _s->buf_size;
+    return LIQUID_OK;
+}
+
+int symstreamracf_state_destroy(symstreamracf_state _s)
+{
+    firinterp_crcf_destroy(_s->interp);
+    msresamp_crcf_destroy(_s->arb_interp);
+    free(_s->buf_internal);
+    free(_s->buf);
+    free(_s);
+    return LIQUID_OK;
+}
+
 /////////// 'internal buffer'
 int symstreamacf_fill_buffer(symstreamracf _q){
     liquid_float_complex v;
@@ -1388,10 +1388,13 @@ wav_source wav_source_create_default(){
 }
 
 float wav_source_get_sample(wav_source src){
-    float value[2];
-    if(cbufferf_max_read(src->wav_r->buffer) == 0) wav_reader_fill_buffer(src->wav_r);
-    cbufferf_pop(src->wav_r->buffer, &value[0]);// releases 1 float
-    cbufferf_pop(src->wav_r->buffer, &value[1]);// releases 1 float
+    float value[2] = {0., 0.};
+    float *reader_ptr = NULL;
+    if(wav_reader_data_ptr(src->wav_r, reader_ptr) > 0){
+        value[0] = reader_ptr[0];
+        value[1] = reader_ptr[1];
+        wav_reader_advance(src->wav_r, 1);// releases 1 sample (2 floats)
+    }
     if(src->_special == LEFT) return value[0];
     else if(src->_special == RIGHT) return value[1];
     else if(src->_special == STEREO) return (value[0]-value[1])/2.0;
@@ -1485,8 +1488,8 @@ int wav_source_nstep(wav_source src, uint32_t n, float *out){
     uint32_t loaded = 0, loading = 0;
     float *ptr;
     while(loaded < n){
-        cbufferf_read(src->buffer, n, &ptr, &loading);
-        memcpy(out, ptr, loading*sizeof(float));
+        cbufferf_read(src->buffer, n - loaded, &ptr, &loading);
+        memcpy(&out[loaded], ptr, loading*sizeof(float));
         cbufferf_release(src->buffer, loading);
         wav_source_fill_buffer(src);
         loaded += loading;
@@ -2623,6 +2626,7 @@ void ammod_destroy(ammod *src){
         real_source ptr = (real_source)(*src)->freq_src;
         real_source_destroy(&ptr);
     }
+    if((*src)->scratch != NULL) free((*src)->scratch);
     free((*src));
 }
 int ammod_step(ammod mod, float *out){
@@ -2640,27 +2644,29 @@ int ammod_step(ammod mod, float *out){
 }
 int ammod_nstep(ammod mod, uint32_t n, float *out){
     if (mod == NULL) return 1;
-    float *mod_idx;
-    float *bias;
-    float *freq;
-    if(out != NULL){
-        mod_idx = (float*)malloc(n*sizeof(float));
-        bias = (float*)malloc(n*sizeof(float));
-        freq = (float*)malloc(n*sizeof(float));
-        memset(mod_idx, 0, n*sizeof(float));
-        memset(bias, 0, n*sizeof(float));
-        memset(freq, 0, n*sizeof(float));
-    }
+    if(out == NULL){
+        real_source_nstep(mod->_mod_idx, n, NULL);
+        real_source_nstep(mod->bias_src, n, NULL);
+        real_source_nstep(mod->freq_src, n, NULL);
+        return 0;
+    }
+    // scratch is kept on the object and only grows, so steady state block
+    // calls do not touch the allocator
+    if(n > mod->scratch_len){
+        float *grown = (float*)realloc(mod->scratch, 3*(size_t)n*sizeof(float));
+        if(grown == NULL) return 2;
+        mod->scratch = grown;
+        mod->scratch_len = n;
+    }
+    float *mod_idx = mod->scratch;
+    float *bias = mod_idx + n;
+    float *freq = bias + n;
+    memset(mod->scratch, 0, 3*(size_t)n*sizeof(float));
     real_source_nstep(mod->_mod_idx, n, mod_idx);
     real_source_nstep(mod->bias_src, n, bias);
     real_source_nstep(mod->freq_src, n, freq);
-    if(out != NULL){
-        for(uint32_t idx = 0; idx < n; idx++){
-            out[idx] = (mod_idx[idx]*out[idx]+bias[idx])*freq[idx];
-        }
-        free(mod_idx);
-        free(bias);
-        free(freq);
+    for(uint32_t idx = 0; idx < n; idx++){
+        out[idx] = (mod_idx[idx]*out[idx]+bias[idx])*freq[idx];
     }
     return 0;
 }
@@ -2747,6 +2753,17 @@ real_path real_path_create(float input_fs, float output_fs, float bandwidth, flo
         path->buffer = cbufferf_create(path->buf_len);
         path->resampler = resampler;
     }
+    if(path->resampler != NULL){
+        // band-limit at the input rate before resampling; the cutoff is the
+        // requested bandwidth, clamped to the narrower of the two nyquist zones
+        double fs_min = (path->input_fs < path->output_fs) ? path->input_fs : path->output_fs;
+        double cutoff = (path->bandwidth > 0.0) ? path->bandwidth : 0.5*fs_min;
+        if(cutoff > 0.5*fs_min) cutoff = 0.5*fs_min;
+        cutoff /= path->input_fs;
+        if(cutoff > 0.0 && cutoff < 0.5){
+            path->filter = firfilt_rrrf_create_kaiser(31, (float)cutoff, 60.0f, 0.0f);
+        }
+    }
     return path;
 }
 
@@ -2769,51 +2786,103 @@ void real_path_destroy(real_path *path){
         msresamp_rrrf ptr = (*path)->resampler;
         msresamp_rrrf_destroy(ptr);
     }
+    if((*path)->filter != NULL){
+        firfilt_rrrf ptr = (*path)->filter;
+        firfilt_rrrf_destroy(ptr);
+    }
+    if((*path)->blk_in != NULL) free((*path)->blk_in);
+    if((*path)->blk_out != NULL) free((*path)->blk_out);
     free((*path));
     (*path) = NULL;
 }
 
+int real_path_reserve(real_path path, uint32_t n){
+    if (path == NULL) return 1;
+    if (path->resampler == NULL) return 0;
+    double rate = msresamp_rrrf_get_rate(path->resampler);
+    // input samples needed for n outputs, plus a little slack for the
+    // resampler's fractional phase
+    uint32_t in_len = (uint32_t)ceil((double)n/rate) + 2;
+    uint32_t out_len = (uint32_t)ceil((double)in_len*rate) + 16;
+    if(in_len > path->blk_len){
+        float *grown = (float*)realloc(path->blk_in, in_len*sizeof(float));
+        if(grown == NULL) return 2;
+        path->blk_in = grown;
+        path->blk_len = in_len;
+    }
+    if(out_len > path->blk_out_len){
+        float *grown = (float*)realloc(path->blk_out, out_len*sizeof(float));
+        if(grown == NULL) return 2;
+        path->blk_out = grown;
+        path->blk_out_len = out_len;
+    }
+    // the ring holds at most one request plus one block of overshoot
+    uint32_t need = n + out_len;
+    if(need > cbufferf_max_size(path->buffer)){
+        uint32_t held = cbufferf_size(path->buffer);
+        cbufferf grown = cbufferf_create(1 << liquid_nextpow2(need));
+        if(grown == NULL) return 2;
+        if(held > 0){
+            float *ptr;
+            unsigned int avail;
+            cbufferf_read(path->buffer, held, &ptr, &avail);
+            cbufferf_write(grown, ptr, avail);
+        }
+        cbufferf_destroy(path->buffer);
+        path->buffer = grown;
+        path->buf_len = cbufferf_max_size(grown);
+    }
+    return 0;
+}
+
 int real_path_step(real_path path, float *out){
     if (path == NULL) return 1;
+    if (path->resampler != NULL){
+        return real_path_nstep(path, 1, out);
+    }
     int rc = 0;
-    // float max_v0(0),max_v1(0);
     rc = real_source_step(path->source, out); // if out null handled in there
-    // if(out != NULL){
-    //     max_v0 = std::abs(*out);
-    // }
     if( path->modulator != NULL ){
         ammod_step(path->modulator, out); // if out null handled in there (out + bias)*freq
-        // if(out != NULL){
-        //     max_v1 = std::abs(*out);
-        // }
-    }
-    // if(out != NULL){
-    //     // std::cout << "out? " << *out << std::endl;
-    //     if(max_v0 > 1.0) std::cout << "maxv0 exceeds 1.0: " << max_v0 << std::endl; 
-    //     if(max_v1 > 1.0) std::cout << "maxv1 exceeds 1.0: " << max_v1 << std::endl; 
-    // }
+    }
     return rc;
 }
 int real_path_nstep(real_path path, uint32_t n, float *out){
     if (path == NULL) return 1;
-    // float max_v0(0),max_v1(0);
-    // float *tweaks = (float*) malloc(n*sizeof(float));
-    // memset(tweaks, 0, n*sizeof(float));
     int rc = 0;
-    rc = real_source_nstep(path->source, n, out);
-    // if(out != NULL){
-    //     for(size_t idx = 0; idx < n; idx++){
-    //         max_v0 = (std::abs(out[idx]) > max_v0) ? std::abs(out[idx]) : max_v0;
-    //     }
-    // }
-    ammod_nstep(path->modulator, n, out); // ammod will handle if modulator is null
-    // if(out != NULL){
-    //     for(size_t idx = 0; idx < n; idx++){
-    //         max_v1 = (std::abs(out[idx]) > max_v1) ? std::abs(out[idx]) : max_v1;
-    //     }
-    //     if(max_v0 > 1.0) std::cout << "maxv0 exceeds 1.0: " << max_v0 << std::endl; 
-    //     if(max_v1 > 1.0) std::cout << "maxv1 exceeds 1.0: " << max_v1 << std::endl; 
-    // }
+    if (path->resampler == NULL){
+        rc = real_source_nstep(path->source, n, out);
+        ammod_nstep(path->modulator, n, out); // ammod will handle if modulator is null
+        return rc;
+    }
+    // block path: pull whole blocks from the source at input_fs, band-limit
+    // and resample them in one call, and serve n samples at output_fs
+    rc = real_path_reserve(path, n);
+    if (rc != 0) return rc;
+    double rate = msresamp_rrrf_get_rate(path->resampler);
+    uint32_t held = cbufferf_size(path->buffer);
+    while(held < n){
+        uint32_t in_len = (uint32_t)ceil((double)(n - held)/rate);
+        if(in_len == 0) in_len = 1;
+        if(in_len > path->blk_len) in_len = path->blk_len;
+        memset(path->blk_in, 0, in_len*sizeof(float));
+        rc = real_source_nstep(path->source, in_len, path->blk_in);
+        if(path->filter != NULL){
+            firfilt_rrrf_execute_block(path->filter, path->blk_in, in_len, path->blk_in);
+        }
+        unsigned int out_len = 0;
+        msresamp_rrrf_execute(path->resampler, path->blk_in, in_len, path->blk_out, &out_len);
+        cbufferf_write(path->buffer, path->blk_out, out_len);
+        held += out_len;
+    }
+    if(out != NULL){
+        float *ptr;
+        unsigned int avail;
+        cbufferf_read(path->buffer, n, &ptr, &avail);
+        memmove(out, ptr, avail*sizeof(float));
+    }
+    cbufferf_release(path->buffer, n);
+    ammod_nstep(path->modulator, n, out); // modulation runs at output_fs
     return rc;
 }
 
@@ -2875,6 +2944,7 @@ void amgen_destroy(amgen *gen){
         free((*gen)->paths);
     }
     if((*gen)->path_gains != NULL) free((*gen)->path_gains);
+    if((*gen)->scratch != NULL) free((*gen)->scratch);
     free((*gen));
 }
 int amgen_step(amgen gen, float *out){
@@ -2896,6 +2966,18 @@ int amgen_step(amgen gen, float *out){
     }
     return 0;
 }
+int amgen_reserve(amgen gen, uint32_t n){
+    if (gen == NULL) return 1;
+    if (n <= gen->scratch_len) return 0;
+    float *grown = (float*)realloc(gen->scratch, 2*(size_t)n*sizeof(float));
+    if (grown == NULL) return 2;
+    gen->scratch = grown;
+    gen->scratch_len = n;
+    for(uint8_t idx = 0; idx < gen->num_paths; idx++){
+        real_path_reserve(gen->paths[idx], n);
+    }
+    return 0;
+}
 #ifdef __cplusplus
 int amgen_nstep(amgen gen, uint32_t n, float *out){
 #else
@@ -2904,17 +2986,17 @@ int amgen_nstepf(amgen gen, uint32_t n, float *out){
     if (gen == NULL) return 1;
     if (gen->num_paths == 0) return 2;
     if(out != NULL){
-        float *dump = (float*)malloc(n*sizeof(float));
-        memset(dump, 0, n*sizeof(float));
+        if (amgen_reserve(gen, n) != 0) return 3;
+        float *dump = gen->scratch + n;
         memset(out, 0, n*sizeof(float));
         real_path_nstep(gen->paths[0], n, out);
         for(uint8_t idx = 1; idx < gen->num_paths; idx++){
+            memset(dump, 0, n*sizeof(float));
             real_path_nstep(gen->paths[idx], n, dump);
             for(uint32_t samp = 0; samp < n; samp++){
                 out[samp] += dump[samp];
             }
         }
-        free(dump);
     }
     else{
         for(uint8_t idx = 0; idx < gen->num_paths; idx++){
@@ -2927,12 +3009,13 @@ int amgen_nstep(amgen gen, uint32_t n, liquid_float_complex *out){
     if (gen == NULL) return 1;
     if (gen->num_paths == 0) return 2;
     if(out != NULL){
-        float *base = (float*)malloc(n*sizeof(float));
-        float *dump = (float*)malloc(n*sizeof(float));
+        if (amgen_reserve(gen, n) != 0) return 3;
+        float *base = gen->scratch;
+        float *dump = gen->scratch + n;
         memset(base, 0, n*sizeof(float));
-        memset(dump, 0, n*sizeof(float));
         real_path_nstep(gen->paths[0], n, base);
         for(uint8_t idx = 1; idx < gen->num_paths; idx++){
+            memset(dump, 0, n*sizeof(float));
             real_path_nstep(gen->paths[idx], n, dump);
             for(uint32_t samp = 0; samp < n; samp++){
                 base[samp] += dump[samp];
@@ -0,0 +1,312 @@
+#include "audio_cache.hh"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <math.h>
+#ifdef __cplusplus
+#include <iostream>
+#endif
+
+#define AUDIO_CACHE_FNV_OFFSET 0xcbf29ce484222325ULL
+#define AUDIO_CACHE_FNV_PRIME  0x00000100000001b3ULL
+#define AUDIO_CACHE_CHUNK      65536    // frames decoded per pass while building
+
+static uint64_t fnv1a_update(uint64_t hash, const void *data, size_t len){
+    const uint8_t *ptr = (const uint8_t*)data;
+    for(size_t idx = 0; idx < len; idx++){
+        hash ^= ptr[idx];
+        hash *= AUDIO_CACHE_FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t audio_cache_fingerprint(wav_obj wav){
+    // format, length and every byte of the data chunk; reads the whole
+    // file, so it is only worked out while building and when verifying
+    if(wav == NULL || wav->err_state != 0 || wav->data_ptr == NULL) return 0;
+    uint64_t hash = AUDIO_CACHE_FNV_OFFSET;
+    uint64_t data_len = wav->data_len;
+    hash = fnv1a_update(hash, &data_len, sizeof(data_len));
+    hash = fnv1a_update(hash, &wav->audio_fmt, sizeof(wav->audio_fmt));
+    hash = fnv1a_update(hash, &wav->num_channels, sizeof(wav->num_channels));
+    hash = fnv1a_update(hash, &wav->sample_rate, sizeof(wav->sample_rate));
+    hash = fnv1a_update(hash, &wav->bit_depth, sizeof(wav->bit_depth));
+    const uint8_t *data = &((const uint8_t*)wav->data_ptr)[wav->data_offset];
+    return fnv1a_update(hash, data, data_len);
+}
+
+uint64_t audio_cache_stamp(wav_obj wav){
+    // path, size, modification time and inode of the source file, which
+    // change with any rewrite of it and cost one stat to read
+    if(wav == NULL || wav->err_state != 0 || wav->filepath == NULL) return 0;
+    struct stat st;
+    if(stat(wav->filepath, &st)) return 0;
+    uint64_t hash = AUDIO_CACHE_FNV_OFFSET;
+    uint64_t fields[6] = {(uint64_t)st.st_size, (uint64_t)st.st_mtim.tv_sec, (uint64_t)st.st_mtim.tv_nsec,
+                          (uint64_t)st.st_ino, (uint64_t)st.st_dev, wav->data_len};
+    hash = fnv1a_update(hash, wav->filepath, strlen(wav->filepath));
+    return fnv1a_update(hash, fields, sizeof(fields));
+}
+
+uint64_t audio_cache_key(wav_obj *wavs, uint32_t file_count, uint32_t sample_rate){
+    uint64_t hash = AUDIO_CACHE_FNV_OFFSET;
+    uint32_t version = AUDIO_CACHE_VERSION;
+    hash = fnv1a_update(hash, &version, sizeof(version));
+    hash = fnv1a_update(hash, &sample_rate, sizeof(sample_rate));
+    hash = fnv1a_update(hash, &file_count, sizeof(file_count));
+    for(uint32_t idx = 0; idx < file_count; idx++){
+        uint64_t stamp = audio_cache_stamp(wavs[idx]);
+        hash = fnv1a_update(hash, &stamp, sizeof(stamp));
+    }
+    return hash;
+}
+
+static int audio_cache_resample(msresamp_rrrf *resamplers, const float *stereo, uint32_t n,
+                                float *lane_in, float **lane_out, float *packed,
+                                uint64_t *skip, uint64_t *written, uint64_t target, FILE *fid){
+    // run n stereo frames through the per channel resamplers and append
+    // the output, less the first *skip frames and anything past target
+    unsigned int produced[2] = {0, 0};
+    for(uint8_t ch = 0; ch < 2; ch++){
+        for(uint32_t idx = 0; idx < n; idx++) lane_in[idx] = stereo[2*idx+ch];
+        msresamp_rrrf_execute(resamplers[ch], lane_in, n, lane_out[ch], &produced[ch]);
+    }
+    unsigned int out_len = (produced[0] < produced[1]) ? produced[0] : produced[1];
+    unsigned int start = (*skip < out_len) ? (unsigned int)*skip : out_len;
+    *skip -= start;
+    unsigned int keep = out_len - start;
+    if(keep > target - *written) keep = (unsigned int)(target - *written);
+    for(unsigned int idx = 0; idx < keep; idx++){
+        packed[2*idx+0] = lane_out[0][start+idx];
+        packed[2*idx+1] = lane_out[1][start+idx];
+    }
+    if(fwrite(packed, 2*sizeof(float), keep, fid) != keep) return 5;
+    *written += keep;
+    return 0;
+}
+
+int audio_cache_build(const char *path, wav_obj *wavs, uint32_t file_count, uint32_t sample_rate, uint64_t key){
+    // decode (and resample) every wav into {path}, written sequentially;
+    // the index is rewritten at the end once the real frame counts are known
+    if(path == NULL || wavs == NULL || file_count == 0 || sample_rate == 0) return 1;
+    FILE *fid = fopen(path, "wb");
+    if(fid == NULL) return 2;
+
+    size_t index_len = sizeof(audio_cache_header_t) + file_count*sizeof(audio_cache_entry_t);
+    uint64_t data_offset = ((index_len + AUDIO_CACHE_ALIGN - 1)/AUDIO_CACHE_ALIGN)*AUDIO_CACHE_ALIGN;
+
+    audio_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, AUDIO_CACHE_MAGIC, sizeof(header.magic));
+    header.version = AUDIO_CACHE_VERSION;
+    header.sample_rate = sample_rate;
+    header.channels = 2;
+    header.file_count = file_count;
+    header.key = key;
+    header.data_offset = data_offset;
+    audio_cache_entry_t *entries = (audio_cache_entry_t*)malloc(file_count*sizeof(audio_cache_entry_t));
+    memset(entries, 0, file_count*sizeof(audio_cache_entry_t));
+
+    float *stereo = (float*)malloc(2*AUDIO_CACHE_CHUNK*sizeof(float));
+    float *lane_in = (float*)malloc(AUDIO_CACHE_CHUNK*sizeof(float));
+    float *lane_out[2] = {NULL, NULL};
+    uint32_t lane_len = 0;
+    float *packed = NULL;
+
+    int rc = 0;
+    if(fseek(fid, data_offset, SEEK_SET)) rc = 3;
+    for(uint32_t fidx = 0; fidx < file_count && rc == 0; fidx++){
+        wav_obj wav = wavs[fidx];
+        entries[fidx].hash = audio_cache_fingerprint(wav);// for audio_cache_verify()
+        entries[fidx].frame_offset = header.total_frames;
+        if(wav == NULL || wav->err_state != 0 || wav->block_align == 0) continue;
+        entries[fidx].src_rate = wav->sample_rate;
+        uint64_t frames = wav->data_len/wav->block_align;
+        uint8_t resample = (wav->sample_rate != sample_rate);
+        float rate = (float)sample_rate/(float)wav->sample_rate;
+        msresamp_rrrf resamplers[2] = {NULL, NULL};
+        if(resample){
+            resamplers[0] = msresamp_rrrf_create(rate, 60.0f);
+            resamplers[1] = msresamp_rrrf_create(rate, 60.0f);
+            uint32_t need = (uint32_t)ceilf(AUDIO_CACHE_CHUNK*rate) + 64;
+            if(need > lane_len){
+                lane_out[0] = (float*)realloc(lane_out[0], need*sizeof(float));
+                lane_out[1] = (float*)realloc(lane_out[1], need*sizeof(float));
+                packed = (float*)realloc(packed, 2*need*sizeof(float));
+                lane_len = need;
+            }
+        }
+        // a resampled file keeps the length and timing of its source: the
+        // filter delay is dropped from the front and the tail is flushed
+        // out with silence
+        uint64_t written = 0;
+        uint64_t target = (resample) ? (uint64_t)llround((double)frames*sample_rate/wav->sample_rate) : frames;
+        uint64_t skip = (resample) ? (uint64_t)lroundf(msresamp_rrrf_get_delay(resamplers[0])) : 0;
+        for(uint64_t start = 0; start < frames && rc == 0; start += AUDIO_CACHE_CHUNK){
+            uint32_t span = (frames - start < AUDIO_CACHE_CHUNK) ? (uint32_t)(frames - start) : AUDIO_CACHE_CHUNK;
+            int decoded = wav_decode_span(wav, (uint32_t)start, span, stereo);
+            if(decoded <= 0){
+                rc = 4;
+                break;
+            }
+            if(!resample){
+                if(fwrite(stereo, 2*sizeof(float), decoded, fid) != (size_t)decoded) rc = 5;
+                written += decoded;
+                continue;
+            }
+            rc = audio_cache_resample(resamplers, stereo, decoded, lane_in, lane_out, packed,
+                                      &skip, &written, target, fid);
+        }
+        if(resample && rc == 0 && written < target){
+            // enough silence to push the delay and the last samples through
+            uint32_t span = (uint32_t)ceilf((skip + (target - written))/rate) + 64;
+            if(span > AUDIO_CACHE_CHUNK) span = AUDIO_CACHE_CHUNK;
+            memset(stereo, 0, 2*span*sizeof(float));
+            for(uint8_t pass = 0; pass < 4 && rc == 0 && written < target; pass++){
+                rc = audio_cache_resample(resamplers, stereo, span, lane_in, lane_out, packed,
+                                          &skip, &written, target, fid);
+            }
+        }
+        if(resamplers[0] != NULL) msresamp_rrrf_destroy(resamplers[0]);
+        if(resamplers[1] != NULL) msresamp_rrrf_destroy(resamplers[1]);
+        entries[fidx].frame_count = written;
+        header.total_frames += written;
+    }
+    if(rc == 0){
+        if(fseek(fid, 0, SEEK_SET)) rc = 3;
+        else if(fwrite(&header, sizeof(header), 1, fid) != 1) rc = 5;
+        else if(fwrite(entries, sizeof(audio_cache_entry_t), file_count, fid) != file_count) rc = 5;
+    }
+    if(fflush(fid) || fsync(fileno(fid))) rc = (rc == 0) ? 6 : rc;
+    fclose(fid);
+
+    free(entries);
+    free(stereo);
+    free(lane_in);
+    if(lane_out[0] != NULL) free(lane_out[0]);
+    if(lane_out[1] != NULL) free(lane_out[1]);
+    if(packed != NULL) free(packed);
+    if(rc != 0) unlink(path);
+    return rc;
+}
+
+audio_cache audio_cache_map(const char *path, uint64_t key, uint32_t sample_rate, uint32_t file_count){
+    // map an existing cache read-only, NULL if missing or not the corpus asked for
+    if(path == NULL) return NULL;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+    struct stat st;
+    if(fstat(fd, &st) || (size_t)st.st_size < sizeof(audio_cache_header_t)){
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);// the mapping holds its own reference
+    if(map == MAP_FAILED) return NULL;
+
+    const audio_cache_header_t *header = (const audio_cache_header_t*)map;
+    uint8_t valid = !memcmp(header->magic, AUDIO_CACHE_MAGIC, sizeof(header->magic))
+        && header->version == AUDIO_CACHE_VERSION
+        && header->key == key
+        && header->sample_rate == sample_rate
+        && header->file_count == file_count
+        && header->channels == 2
+        && header->data_offset + header->total_frames*2*sizeof(float) <= (uint64_t)st.st_size;
+    if(!valid){
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    audio_cache cache = (audio_cache)malloc(sizeof(struct audio_cache_s));
+    memset(cache, 0, sizeof(struct audio_cache_s));
+    cache->path = (char*)malloc(strlen(path)+1);
+    memcpy(cache->path, path, strlen(path)+1);
+    cache->map_len = st.st_size;
+    cache->map = map;
+    cache->header = header;
+    cache->entries = (const audio_cache_entry_t*)((const uint8_t*)map + sizeof(audio_cache_header_t));
+    cache->frames = (const float*)((const uint8_t*)map + header->data_offset);
+    return cache;
+}
+
+audio_cache audio_cache_open(wav_obj *wavs, uint32_t file_count, uint32_t sample_rate, const char *cache_dir){
+    // map the cache for this corpus and rate, building it first if no other
+    // process has done so yet
+    if(wavs == NULL || file_count == 0 || cache_dir == NULL) return NULL;
+    uint64_t key = audio_cache_key(wavs, file_count, sample_rate);
+    size_t path_len = strlen(cache_dir) + 64;
+    char *path = (char*)malloc(path_len);
+    char *lock_path = (char*)malloc(path_len);
+    char *tmp_path = (char*)malloc(path_len);
+    snprintf(path, path_len, "%s/wfgen_audio_%016llx_%u.f32", cache_dir, (unsigned long long)key, sample_rate);
+    snprintf(lock_path, path_len, "%s.lock", path);
+    snprintf(tmp_path, path_len, "%s.%d", path, (int)getpid());
+
+    audio_cache cache = audio_cache_map(path, key, sample_rate, file_count);
+    if(cache == NULL){
+        int lock_fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+        if(lock_fd >= 0 && flock(lock_fd, LOCK_EX) == 0){
+            // someone may have finished building while we waited on the lock
+            cache = audio_cache_map(path, key, sample_rate, file_count);
+            if(cache == NULL){
+                #ifdef __cplusplus
+                std::cout << "audio_cache building " << path << std::endl;
+                #else
+                printf("audio_cache building %s\n", path);
+                #endif
+                if(audio_cache_build(tmp_path, wavs, file_count, sample_rate, key) == 0
+                        && rename(tmp_path, path) == 0){
+                    cache = audio_cache_map(path, key, sample_rate, file_count);
+                }
+            }
+            flock(lock_fd, LOCK_UN);
+        }
+        if(lock_fd >= 0) close(lock_fd);
+    }
+    free(path);
+    free(lock_path);
+    free(tmp_path);
+    return cache;
+}
+
+int audio_cache_verify(audio_cache cache, wav_obj *wavs, uint32_t file_count){
+    // number of source files whose contents no longer match the cache; the
+    // key only covers their stat data, this reads every byte
+    if(cache == NULL || wavs == NULL || file_count != cache->header->file_count) return -1;
+    int stale = 0;
+    for(uint32_t idx = 0; idx < file_count; idx++){
+        if(audio_cache_fingerprint(wavs[idx]) != cache->entries[idx].hash) stale++;
+    }
+    return stale;
+}
+
+void audio_cache_destroy(audio_cache *cache){
+    if(cache == NULL) return;
+    if(*cache == NULL) return;
+    if((*cache)->map != NULL) munmap((*cache)->map, (*cache)->map_len);
+    if((*cache)->path != NULL) free((*cache)->path);
+    free(*cache);
+    *cache = NULL;
+}
+
+uint32_t audio_cache_sample_rate(audio_cache cache){
+    if(cache == NULL) return 0;
+    return cache->header->sample_rate;
+}
+
+uint64_t audio_cache_total_frames(audio_cache cache){
+    if(cache == NULL) return 0;
+    return cache->header->total_frames;
+}
+
+uint64_t audio_cache_file_frames(audio_cache cache, uint32_t file_idx){
+    if(cache == NULL || file_idx >= cache->header->file_count) return 0;
+    return cache->entries[file_idx].frame_count;
+}
+
+const float* audio_cache_file_data(audio_cache cache, uint32_t file_idx){
+    // interleaved stereo frames of one source file
+    if(cache == NULL || file_idx >= cache->header->file_count) return NULL;
+    return cache->frames + 2*cache->entries[file_idx].frame_offset;
+}
@@ -0,0 +1,316 @@
+#ifdef __cplusplus
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <omp.h>
+#endif
+#include "batch.hh"
+
+#ifdef __cplusplus
+
+// key to value of a flat JSON object, strings unquoted and null empty;
+// the scenario files hold nothing nested
+static std::map<std::string, std::string> batch_json_flat(const std::string & text, const std::string & path)
+{
+    std::map<std::string, std::string> values;
+    size_t i = 0, n = text.size();
+    auto fail = [&](const std::string & what) {
+        throw std::runtime_error(path+": "+what+" at offset "+std::to_string(i));
+    };
+    auto skip = [&]() {
+        while (i < n && isspace((unsigned char)text[i])) i++;
+    };
+    auto string_at = [&]() {
+        std::string s;
+        for (i++; i < n && text[i] != '"'; i++) {
+            if (text[i] == '\\' && i+1 < n) i++;
+            s += text[i];
+        }
+        if (i >= n) fail("unterminated string");
+        i++;
+        return s;
+    };
+
+    skip();
+    if (i >= n || text[i] != '{') fail("expected an object");
+    i++;
+    skip();
+    if (i < n && text[i] == '}') return values;
+    while (true) {
+        skip();
+        if (i >= n || text[i] != '"') fail("expected a key");
+        std::string key = string_at();
+        skip();
+        if (i >= n || text[i] != ':') fail("expected ':'");
+        i++;
+        skip();
+        std::string value;
+        if (i < n && text[i] == '"') {
+            value = string_at();
+        }
+        else if (i < n && (text[i] == '{' || text[i] == '[')) {
+            fail("nested value of "+key+" is not supported");
+        }
+        else {
+            size_t j = i;
+            while (i < n && text[i] != ',' && text[i] != '}' && !isspace((unsigned char)text[i])) i++;
+            value = text.substr(j, i - j);
+            if (value == "null") value.clear();
+        }
+        values[key] = value;
+        skip();
+        if (i < n && text[i] == ',') { i++; continue; }
+        if (i < n && text[i] == '}') break;
+        fail("expected ',' or '}'");
+    }
+    return values;
+}
+
+// kind and scheme of a scenario profile, trying each family in turn
+static bool batch_profile_lookup(const std::string & name, scene_kind * kind, int * scheme)
+{
+    int i;
+    if ((i = noise_type_lookup(name.c_str())) > 0) {
+        *kind = SCENE_NOISE;
+        *scheme = noise_types[i].scheme;
+        return true;
+    }
+    if ((i = fsk_type_lookup(name.c_str())) > 0) {
+        *kind = SCENE_FSK;
+        *scheme = i;
+        return true;
+    }
+    // the scenarios name the random message sources am_uni, fm_gauss, ...
+    if ((i = analog_type_lookup(name.c_str())) > 0 ||
+        (name.size() > 3 && (i = analog_type_lookup((name.substr(0,3)+"rand_"+name.substr(3)).c_str())) > 0)) {
+        *kind = SCENE_ANALOG;
+        *scheme = i;
+        return true;
+    }
+    if (name == "tone" || name == "ofdm") {
+        *kind = (name == "tone") ? SCENE_TONE : SCENE_OFDM;
+        *scheme = LIQUID_MODEM_QPSK;
+        return true;
+    }
+    for (i=1; i<LIQUID_MODEM_NUM_SCHEMES; i++) {
+        if (name == modulation_types[i].name) {
+            *kind = SCENE_LINEAR;
+            *scheme = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+batch_job batch_job_load(const std::string & path, const std::string & out_dir)
+{
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("could not open "+path);
+    std::stringstream text;
+    text << in.rdbuf();
+    std::map<std::string, std::string> values = batch_json_flat(text.str(), path);
+
+    auto number = [&](const char * key, double fallback) {
+        auto it = values.find(key);
+        if (it == values.end() || it->second.empty())
+            return fallback;
+        char * end = NULL;
+        double v = strtod(it->second.c_str(), &end);
+        if (end == it->second.c_str() || *end != '\0')
+            throw std::runtime_error(path+": "+key+" is not a number");
+        return v;
+    };
+
+    batch_job job;
+    job.scenario = path;
+    std::string profile = values["profile"];
+    scene_emitter e;
+    if (!batch_profile_lookup(profile, &e.kind, &e.scheme))
+        throw std::runtime_error(path+": unsupported profile '"+profile+"'");
+
+    double rate = number("rate", 1e6);
+    if (rate <= 0)
+        throw std::runtime_error(path+": rate must be positive");
+    e.bw = (float)(number("bw", 0.1*rate)/rate);
+    if (values["mode"] != "static") {
+        e.on_time  = number("dwell", -1.0);
+        e.off_time = number("absence", number("idle", 0.0));
+    }
+    double src_fq = number("src_fq", -1.0);
+    if (src_fq > 0)
+        e.src_freq = (float)(src_fq/rate);
+    job.emitters.push_back(e);
+
+    double time_start = number("time_start", 0.0);
+    double duration = number("duration", number("time_stop", -1.0) - time_start);
+    if (duration <= 0)
+        throw std::runtime_error(path+": needs a duration or time_start/time_stop");
+    double freq_lo = number("freq_lo", -1.0), freq_hi = number("freq_hi", -1.0);
+    job.config.sample_rate = rate;
+    job.config.duration    = duration;
+    job.config.start_time  = time_start;
+    job.config.seed        = (uint32_t)number("seed", 1.0);
+    job.config.center_freq = (freq_lo > 0 && freq_hi > 0) ? 0.5*(freq_lo + freq_hi)
+                                                          : number("frequency", number("band_center", 0.0));
+
+    std::string stem = path.substr(path.find_last_of('/') + 1);
+    if (stem.size() > 5 && stem.compare(stem.size() - 5, 5, ".json") == 0)
+        stem.resize(stem.size() - 5);
+    job.iq_path   = out_dir + "/" + stem + ".cf32";
+    job.json_path = out_dir + "/" + stem + "_truth.json";
+    return job;
+}
+
+static auto batch_emitter_key(const scene_emitter & e)
+{
+    return std::tie(e.kind, e.scheme, e.fc, e.bw, e.gain_db, e.start, e.stop, e.on_time,
+                    e.off_time, e.k, e.mod_index, e.cpf_type, e.src_freq, e.nfft);
+}
+
+// orders jobs so that those one scene can render are neighbours
+static bool batch_job_less(const batch_job & a, const batch_job & b)
+{
+    if (a.config.sample_rate != b.config.sample_rate) return a.config.sample_rate < b.config.sample_rate;
+    if (a.config.duration != b.config.duration) return a.config.duration < b.config.duration;
+    if (a.config.seed != b.config.seed) return a.config.seed < b.config.seed;
+    return std::lexicographical_compare(a.emitters.begin(), a.emitters.end(),
+        b.emitters.begin(), b.emitters.end(),
+        [](const scene_emitter & x, const scene_emitter & y) {
+            return batch_emitter_key(x) < batch_emitter_key(y); });
+}
+
+static bool batch_same_scene(const batch_job & a, const batch_job & b)
+{
+    return !batch_job_less(a, b) && !batch_job_less(b, a);
+}
+
+// A run of job numbers per worker. The owner works its run front to back;
+// a worker out of jobs steals from the back of another's run, the jobs
+// furthest from what that worker is on.
+class batch_queues {
+  public:
+    explicit batch_queues(unsigned int num_workers) : runs(num_workers), locks(num_workers) {}
+
+    // only before the workers start
+    void push(unsigned int worker, size_t job) { runs[worker].push_back(job); }
+
+    bool pop(unsigned int worker, size_t & job, bool & stolen) {
+        {
+            std::lock_guard<std::mutex> lock(locks[worker]);
+            if (!runs[worker].empty()) {
+                job = runs[worker].front();
+                runs[worker].pop_front();
+                stolen = false;
+                return true;
+            }
+        }
+        for (size_t k=1; k<runs.size(); k++) {
+            size_t victim = (worker + k) % runs.size();
+            std::lock_guard<std::mutex> lock(locks[victim]);
+            if (!runs[victim].empty()) {
+                job = runs[victim].back();
+                runs[victim].pop_back();
+                stolen = true;
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    std::vector<std::deque<size_t> > runs;
+    std::vector<std::mutex> locks;
+};
+
+batch_stats batch_render(std::vector<batch_job> & jobs, unsigned int num_workers)
+{
+    batch_stats stats = {0, 0, 0, 0};
+    if (jobs.empty()) return stats;
+    std::stable_sort(jobs.begin(), jobs.end(), batch_job_less);
+
+    int nw = num_workers ? (int)num_workers : omp_get_max_threads();
+    nw = (int)std::min((size_t)nw, jobs.size());
+    batch_queues queues(nw);
+    for (size_t j=0; j<jobs.size(); j++)
+        queues.push((unsigned int)(j*nw/jobs.size()), j);
+
+    std::atomic<size_t> rendered(0), failed(0), reused(0), stolen(0);
+    // the scenes render inside this region, so their own parallel regions
+    // run in the calling worker
+    #pragma omp parallel num_threads(nw)
+    {
+        unsigned int worker = omp_get_thread_num();
+        std::unique_ptr<scene> sc;
+        const batch_job * last = nullptr;
+        size_t j;
+        bool was_stolen;
+        while (queues.pop(worker, j, was_stolen)) {
+            const batch_job & job = jobs[j];
+            if (was_stolen) stolen++;
+            try {
+                if (sc && last != nullptr && batch_same_scene(*last, job)) {
+                    reused++;
+                }
+                else {
+                    // ofdm sources plan and destroy FFTs and FFTW's planner
+                    // is not thread safe; nothing may throw out of the critical
+                    last = nullptr;
+                    std::exception_ptr error = nullptr;
+                    #pragma omp critical(batch_fftw_planner)
+                    {
+                        try {
+                            sc.reset();
+                            sc.reset(new scene(job.emitters, job.config.sample_rate, job.config.duration,
+                                                 job.config.seed));
+                        }
+                        catch (...) {
+                            error = std::current_exception();
+                        }
+                    }
+                    if (error)
+                        std::rethrow_exception(error);
+                }
+                last = &job;
+
+                std::unique_ptr<labels> reporter;
+                if (!job.json_path.empty()) {
+                    reporter.reset(new labels(job.json_path.c_str(),"TXDL T","TXDL SG1","TXDL S1"));
+                    reporter->eng_bw = job.config.sample_rate;
+                    reporter->start_reports();
+                }
+                offline_render(*sc, job.config, job.iq_path, reporter.get());
+                if (reporter) {
+                    reporter->cache_to_misc("        \"scenario\": \""+job.scenario+"\"\n");
+                    reporter->protocol = "unknown";
+                    reporter->modality = "single_carrier";
+                    reporter->activity_type = "lowprob_anomaly";
+                    reporter->device_origin = "offline";
+                    reporter->finalize();
+                }
+                rendered++;
+            }
+            catch (std::exception & e) {
+                fprintf(stderr,"error: batch_render(), %s: %s\n", job.scenario.c_str(), e.what());
+                failed++;
+            }
+        }
+        #pragma omp critical(batch_fftw_planner)
+        sc.reset();
+    }
+    stats.rendered = rendered;
+    stats.failed   = failed;
+    stats.reused   = reused;
+    stats.stolen   = stolen;
+    return stats;
+}
+#endif
@@ -0,0 +1,217 @@
+#include "burst_index.hh"
+
+#ifdef __cplusplus
+using namespace wfgen::containers;
+#endif
+
+struct burst_index_s{
+    burst_box_t *boxes;
+    double *t1_max;             // latest stop below each node
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t indexed;           // boxes [0,indexed) are sorted and in the tree
+    int32_t root_k;             // level of the root, -1 when empty
+};
+
+static int burst_box_compare(const void *a, const void *b){
+    double ta = ((const burst_box_t*)a)->t0, tb = ((const burst_box_t*)b)->t0;
+    return (ta > tb) - (ta < tb);
+}
+
+static int burst_index_reserve(burst_index bi, uint64_t capacity){
+    if(capacity <= bi->capacity) return 0;
+    burst_box_t *boxes = (burst_box_t*)realloc(bi->boxes, capacity*sizeof(burst_box_t));
+    if(boxes == NULL) return 1;
+    bi->boxes = boxes;
+    double *t1_max = (double*)realloc(bi->t1_max, capacity*sizeof(double));
+    if(t1_max == NULL) return 1;
+    bi->t1_max = t1_max;
+    bi->capacity = capacity;
+    return 0;
+}
+
+burst_index burst_index_create(uint64_t capacity){
+    burst_index bi = (burst_index)malloc(sizeof(struct burst_index_s));
+    if(bi == NULL) return bi;
+    memset(bi, 0, sizeof(struct burst_index_s));
+    bi->root_k = -1;
+    if(burst_index_reserve(bi, (capacity) ? capacity : 1024)){
+        burst_index_destroy(&bi);
+    }
+    return bi;
+}
+
+void burst_index_destroy(burst_index *bi){
+    if(bi == NULL) return;
+    if(*bi == NULL) return;
+    free((*bi)->boxes);
+    free((*bi)->t1_max);
+    free(*bi);
+    *bi = NULL;
+}
+
+int burst_index_add(burst_index bi, double t0, double dur, double fc, double bw, uint64_t id){
+    if(bi == NULL) return 1;
+    if(bi->count == bi->capacity && burst_index_reserve(bi, 2*bi->capacity)) return 2;
+    burst_box_t *b = &bi->boxes[bi->count++];
+    b->t0 = t0;
+    b->t1 = t0 + dur;
+    b->f0 = fc - 0.5*bw;
+    b->f1 = fc + 0.5*bw;
+    b->id = id;
+    return 0;
+}
+
+int burst_index_add_cburst(burst_index bi, cburst b, uint64_t id){
+    if(b == NULL || b->sample_rate <= 0) return 1;
+    return burst_index_add(bi, b->time_offset, b->samples/b->sample_rate,
+                           b->carrier, b->relative_bandwidth*b->sample_rate, id);
+}
+
+uint64_t burst_index_count(burst_index bi){
+    if(bi == NULL) return 0;
+    return bi->count;
+}
+
+int burst_index_build(burst_index bi){
+    if(bi == NULL) return 1;
+    if(bi->indexed == bi->count) return 0;
+    burst_box_t *a = bi->boxes;
+    uint64_t n = bi->count, m = bi->indexed;
+    qsort(&a[m], n - m, sizeof(burst_box_t), burst_box_compare);
+    if(m > 0 && a[m].t0 < a[m-1].t0){
+        // out of order additions, merge the two sorted runs
+        burst_box_t *tmp = (burst_box_t*)malloc((n - m)*sizeof(burst_box_t));
+        if(tmp == NULL){
+            qsort(a, n, sizeof(burst_box_t), burst_box_compare);
+        }
+        else{
+            memcpy(tmp, &a[m], (n - m)*sizeof(burst_box_t));
+            uint64_t i = m, j = n - m, k = n;
+            while(j > 0){
+                if(i > 0 && a[i-1].t0 > tmp[j-1].t0) a[--k] = a[--i];
+                else a[--k] = tmp[--j];
+            }
+            free(tmp);
+        }
+    }
+
+    // leaves are the even slots, level k nodes sit at (2^k - 1) + i*2^(k+1)
+    double *e = bi->t1_max;
+    uint64_t i, last_i = 0;
+    double last = 0;
+    int32_t k;
+    for(i = 0; i < n; i += 2){
+        last_i = i;
+        last = e[i] = a[i].t1;
+    }
+    for(k = 1; (1ULL << k) <= n; k++){
+        uint64_t x = 1ULL << (k - 1), i0 = (x << 1) - 1, step = x << 2;
+        for(i = i0; i < n; i += step){
+            double el = e[i - x];
+            double er = (i + x < n) ? e[i + x] : last;
+            double t1 = a[i].t1;
+            t1 = (t1 > el) ? t1 : el;
+            t1 = (t1 > er) ? t1 : er;
+            e[i] = t1;
+        }
+        // the last subtree at this level may be cut short by n
+        last_i = ((last_i >> k) & 1) ? last_i - x : last_i + x;
+        if(last_i < n && e[last_i] > last) last = e[last_i];
+    }
+    bi->root_k = k - 1;
+    bi->indexed = n;
+    return 0;
+}
+
+uint64_t burst_index_query(burst_index bi, double t0, double t1, double f0, double f1,
+                           uint64_t *ids, uint64_t max_ids){
+    if(bi == NULL || burst_index_build(bi) || bi->count == 0) return 0;
+    const burst_box_t *a = bi->boxes;
+    const double *e = bi->t1_max;
+    uint64_t n = bi->count, hits = 0;
+    struct { uint64_t x; int32_t k; int32_t w; } stack[64];
+    int t = 0;
+    stack[t].x = (1ULL << bi->root_k) - 1;
+    stack[t].k = bi->root_k;
+    stack[t++].w = 0;
+    while(t > 0){
+        uint64_t x = stack[--t].x;
+        int32_t k = stack[t].k, w = stack[t].w;
+        if(k <= 3){
+            // small subtree, scan it
+            uint64_t i0 = x >> k << k, i1 = i0 + (1ULL << (k + 1)) - 1;
+            if(i1 > n) i1 = n;
+            for(uint64_t i = i0; i < i1 && a[i].t0 < t1; i++){
+                if(t0 < a[i].t1 && f0 < a[i].f1 && a[i].f0 < f1){
+                    if(hits < max_ids) ids[hits] = a[i].id;
+                    hits++;
+                }
+            }
+        }
+        else if(w == 0){
+            // revisit this node after its left subtree
+            uint64_t y = x - (1ULL << (k - 1));
+            stack[t].x = x;
+            stack[t].k = k;
+            stack[t++].w = 1;
+            if(y >= n || e[y] > t0){
+                stack[t].x = y;
+                stack[t].k = k - 1;
+                stack[t++].w = 0;
+            }
+        }
+        else if(x < n && a[x].t0 < t1){
+            if(t0 < a[x].t1 && f0 < a[x].f1 && a[x].f0 < f1){
+                if(hits < max_ids) ids[hits] = a[x].id;
+                hits++;
+            }
+            stack[t].x = x + (1ULL << (k - 1));
+            stack[t].k = k - 1;
+            stack[t++].w = 0;
+        }
+    }
+    return hits;
+}
+
+const burst_box_t* burst_index_get(burst_index bi, uint64_t idx){
+    if(bi == NULL || burst_index_build(bi) || idx >= bi->count) return NULL;
+    return &bi->boxes[idx];
+}
+
+int burst_index_save(burst_index bi, const char *path){
+    if(bi == NULL || path == NULL || burst_index_build(bi)) return 1;
+    FILE *fid = fopen(path, "wb");
+    if(fid == NULL) return 2;
+    burst_index_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BURST_INDEX_MAGIC, sizeof(h.magic));
+    h.version = BURST_INDEX_VERSION;
+    h.count = bi->count;
+    int rc = (fwrite(&h, sizeof(h), 1, fid) != 1);
+    if(!rc && bi->count) rc = (fwrite(bi->boxes, sizeof(burst_box_t), bi->count, fid) != bi->count);
+    rc |= (fclose(fid) != 0);
+    return (rc) ? 3 : 0;
+}
+
+burst_index burst_index_load(const char *path){
+    FILE *fid = fopen(path, "rb");
+    if(fid == NULL) return NULL;
+    burst_index_header_t h;
+    if(fread(&h, sizeof(h), 1, fid) != 1 || memcmp(h.magic, BURST_INDEX_MAGIC, sizeof(h.magic))
+            || h.version != BURST_INDEX_VERSION){
+        fclose(fid);
+        return NULL;
+    }
+    burst_index bi = burst_index_create(h.count);
+    if(bi == NULL || fread(bi->boxes, sizeof(burst_box_t), h.count, fid) != h.count){
+        burst_index_destroy(&bi);
+        fclose(fid);
+        return NULL;
+    }
+    fclose(fid);
+    // saved sorted, the build only lays the tree over them
+    bi->count = h.count;
+    burst_index_build(bi);
+    return bi;
+}
@@ -0,0 +1,96 @@
+#ifdef __cplusplus
+#include <iostream>
+#endif
+#include "chansynth.hh"
+
+#define liquid_error_config(format, ...) \
+    liquid_error_config_cs(__FILE__, __LINE__, format, ##__VA_ARGS__);
+
+struct chansynth_s {
+    unsigned int M;                 // number of channels
+    unsigned int m;                 // prototype filter semi-length
+    float        as;                // prototype stop-band attenuation [dB]
+    firpfbch2_crcf bank;            // polyphase synthesis filterbank
+    liquid_float_complex * X;       // one input sample per channel [size: M x 1]
+};
+
+chansynth chansynth_create(unsigned int _num_channels,
+                           unsigned int _m,
+                           float        _as)
+{
+    // validate input
+    if (_num_channels < 2 || _num_channels > 4096 || (_num_channels % 2))
+        return (chansynth)liquid_error_config("chansynth_create(), number of channels must be even and in [2,4096]");
+    if (_m == 0)
+        return (chansynth)liquid_error_config("chansynth_create(), filter semi-length must be greater than zero");
+    if (_as <= 0.0f)
+        return (chansynth)liquid_error_config("chansynth_create(), stop-band attenuation must be greater than zero");
+
+    chansynth q = (chansynth) malloc(sizeof(struct chansynth_s));
+    q->M  = _num_channels;
+    q->m  = _m;
+    q->as = _as;
+    q->bank = firpfbch2_crcf_create_kaiser(LIQUID_SYNTHESIZER, q->M, q->m, q->as);
+    q->X  = (liquid_float_complex*) malloc(q->M*sizeof(liquid_float_complex));
+    if (q->bank == NULL || q->X == NULL) {
+        chansynth_destroy(q);
+        return (chansynth)liquid_error_config("chansynth_create(), could not create filterbank");
+    }
+    return q;
+}
+
+int chansynth_destroy(chansynth _q)
+{
+    if (_q == NULL) return LIQUID_OK;
+    if (_q->bank != NULL)
+        firpfbch2_crcf_destroy(_q->bank);
+    free(_q->X);
+    free(_q);
+    return LIQUID_OK;
+}
+
+int chansynth_reset(chansynth _q)
+{
+    return firpfbch2_crcf_reset(_q->bank);
+}
+
+unsigned int chansynth_get_num_channels(chansynth _q)
+{
+    return _q->M;
+}
+
+unsigned int chansynth_get_interp(chansynth _q)
+{
+    return _q->M/2;
+}
+
+float chansynth_get_delay(chansynth _q)
+{
+    // prototype filter is 2*M*m+1 taps long at the output rate
+    return (float)(_q->M*_q->m);
+}
+
+float chansynth_get_channel_fc(chansynth _q, unsigned int _k)
+{
+    _k %= _q->M;
+    return (_k < _q->M/2) ? (float)_k/(float)_q->M : ((float)_k - (float)_q->M)/(float)_q->M;
+}
+
+unsigned int chansynth_get_channel(chansynth _q, float _fc)
+{
+    int k = (int)lroundf(_fc*(float)_q->M) % (int)_q->M;
+    return (unsigned int)((k < 0) ? k + (int)_q->M : k);
+}
+
+int chansynth_execute(chansynth _q, liquid_float_complex **_x, unsigned int _n,
+                      liquid_float_complex *_y)
+{
+    unsigned int i, k;
+    unsigned int interp = _q->M/2;
+    for (i=0; i<_n; i++) {
+        for (k=0; k<_q->M; k++)
+            _q->X[k] = (_x != NULL && _x[k] != NULL) ? _x[k][i] : 0;
+        firpfbch2_crcf_execute(_q->bank, _q->X, _y + (size_t)i*interp);
+    }
+    return LIQUID_OK;
+}
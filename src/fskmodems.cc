@@ -3,9 +3,10 @@
 #include <iostream>
 #endif
 #include "fskmodems.hh"
+#include "name_hash.hh"
 
 
-const struct fsk_type_s fsk_types[FSK_TYPE_COUNT] = {
+WFGEN_CONSTEXPR const struct fsk_type_s fsk_types[FSK_TYPE_COUNT] = {
     // name       fullname        scheme          bps
 
     // unknown
@@ -52,6 +53,25 @@ const struct fsk_type_s fsk_types[FSK_TYPE_COUNT] = {
     {"gcpfsk256",  "gaussian minimum-shift keying (256)", LIQUID_MODEM_GMSK256, 8}
 };
 
+#ifdef __cplusplus
+static constexpr auto fsk_type_table = name_hash::make_table<256>(fsk_types, &fsk_type_s::name);
+#endif
+
+int fsk_type_lookup(const char * _str)
+{
+#ifdef __cplusplus
+    return fsk_type_table.find(_str);
+#else
+    // compare each string to short name
+    unsigned int i;
+    for (i=0; i<FSK_TYPE_COUNT; i++) {
+        if (strcmp(_str,fsk_types[i].name)==0)
+            return i;
+    }
+    return -1;
+#endif
+}
+
 
 #define liquid_error_config(format, ...) \
     liquid_error_config_fl(__FILE__, __LINE__, format, ##__VA_ARGS__);
@@ -123,6 +143,7 @@ symstreamrfcf symstreamrfcf_create_fsk( int          _ftype,
     // set input parameters
     q->bps         = _bps;
     q->M           = 1<<_bps;
+    q->seed        = 0;
     // mod_idx = freq_dist / symbol_rate
     q->h           = _h;
     // k = samples / symbol ---> 1/k = symbol/sample
@@ -210,9 +231,9 @@ symstreamrfcf symstreamrfcf_create_fsk( int          _ftype,
     // sample buffer
     q->buf_internal = (liquid_float_complex*) malloc(int_buf_len*sizeof(liquid_float_complex));
     // printf("Internal(Symbol) buffer length = %u\n",2);
-    unsigned int buf_len = 1 << liquid_nextpow2((unsigned int)ceilf(rate));
-    // printf("External(Sample) buffer length = %u\n",buf_len);
-    q->buf = (liquid_float_complex*) malloc(buf_len*sizeof(liquid_float_complex));
+    q->buf_len = 1 << liquid_nextpow2((unsigned int)ceilf(rate));
+    // printf("External(Sample) buffer length = %u\n",q->buf_len);
+    q->buf = (liquid_float_complex*) malloc(q->buf_len*sizeof(liquid_float_complex));
 
     // reset and return main object
     symstreamrfcf_reset(q);
@@ -309,18 +330,128 @@ unsigned int gen_rand_sym(unsigned int M){
     return rand() % M;
 }
 
+int symstreamrfcf_set_seed(symstreamrfcf _q, uint32_t _seed){
+    _q->seed = _seed;
+    return LIQUID_OK;
+}
+
+// running state, each object a copy of the one in the stream
+struct symstreamrfcf_state_s {
+    int             mod_scheme;     // parameters of the stream,
+    unsigned int    bps;            // to check a restore against
+    float           h;
+    unsigned int    k;
+    unsigned int    m;
+    float           rate;
+    unsigned int    buf_len;
+    gmskmod         mod_g;
+    cpfskmod        mod_c;
+    fskmod          mod_f;
+    firinterp_crcf  interp;
+    msresamp_crcf   arb_interp;
+    liquid_float_complex * buf_internal;    // [size: buf_internal_len x 1]
+    liquid_float_complex * buf;             // [size: buf_size x 1]
+    unsigned int    buf_internal_len;
+    unsigned int    buf_internal_index;
+    unsigned int    buf_index;
+    unsigned int    buf_size;
+    uint32_t        seed;
+};
+
+symstreamrfcf_state symstreamrfcf_snapshot(symstreamrfcf _q)
+{
+    if (_q == NULL)
+        return (symstreamrfcf_state)liquid_error_config("symstreamrfcf_snapshot(), object cannot be NULL");
+
+    symstreamrfcf_state s = (symstreamrfcf_state) malloc(sizeof(struct symstreamrfcf_state_s));
+    s->mod_scheme = _q->mod_scheme;
+    s->bps        = _q->bps;
+    s->h          = _q->h;
+    s->k          = _q->k;
+    s->m          = _q->m;
+    s->rate       = _q->rate;
+    s->buf_len    = _q->buf_len;
+    s->mod_g      = (_q->mod_g  != NULL) ? gmskmod_copy(_q->mod_g)         : NULL;
+    s->mod_c      = (_q->mod_c  != NULL) ? cpfskmod_copy(_q->mod_c)        : NULL;
+    s->mod_f      = (_q->mod_f  != NULL) ? fskmod_copy(_q->mod_f)          : NULL;
+    s->interp     = (_q->interp != NULL) ? firinterp_crcf_copy(_q->interp) : NULL;
+    s->arb_interp = msresamp_crcf_copy(_q->arb_interp);
+
+    // the interpolator writes two samples per modulator sample
+    s->buf_internal_len = (_q->interp == NULL) ? _q->k : 2*_q->k;
+    s->buf_internal = (liquid_float_complex*) malloc(s->buf_internal_len*sizeof(liquid_float_complex));
+    memmove(s->buf_internal, _q->buf_internal, s->buf_internal_len*sizeof(liquid_float_complex));
+    s->buf = (liquid_float_complex*) malloc((_q->buf_size+1)*sizeof(liquid_float_complex));
+    memmove(s->buf, _q->buf, _q->buf_size*sizeof(liquid_float_complex));
+
+    s->buf_internal_index = _q->buf_internal_index;
+    s->buf_index          = _q->buf_index;
+    s->buf_size           = _q->buf_size;
+    s->seed               = _q->seed;
+    return s;
+}
+
+int symstreamrfcf_restore(symstreamrfcf _q, symstreamrfcf_state _s)
+{
+    // the buffers and resampler are sized by these, so nothing else fits
+    if (_s->mod_scheme != _q->mod_scheme || _s->bps != _q->bps || _s->h != _q->h ||
+        _s->k != _q->k || _s->m != _q->m || _s->rate != _q->rate || _s->buf_len != _q->buf_len ||
+        (_s->interp == NULL) != (_q->interp == NULL))
+        return fprintf(stderr,"symstreamrfcf_restore(), snapshot is of a stream with other parameters\n");
+
+    // liquid objects cannot be overwritten in place, so take fresh copies
+    if (_q->mod_g != NULL) { gmskmod_destroy(_q->mod_g); _q->mod_g = gmskmod_copy(_s->mod_g); }
+    if (_q->mod_c != NULL) { cpfskmod_destroy(_q->mod_c); _q->mod_c = cpfskmod_copy(_s->mod_c); }
+    if (_q->mod_f != NULL) { fskmod_destroy(_q->mod_f); _q->mod_f = fskmod_copy(_s->mod_f); }
+    if (_q->interp != NULL) { firinterp_crcf_destroy(_q->interp); _q->interp = firinterp_crcf_copy(_s->interp); }
+    msresamp_crcf_destroy(_q->arb_interp);
+    _q->arb_interp = msresamp_crcf_copy(_s->arb_interp);
+
+    memmove(_q->buf_internal, _s->buf_internal, _s->buf_internal_len*sizeof(liquid_float_complex));
+    memmove(_q->buf, _s->buf, _s->buf_size*sizeof(liquid_float_complex));
+    _q->buf_internal_index = _s->buf_internal_index;
+    _q->buf_index          = _s->buf_index;
+    _q->buf_size           = _s->buf_size;
+    _q->seed               = _s->seed;
+    return LIQUID_OK;
+}
+
+int symstreamrfcf_state_destroy(symstreamrfcf_state _s)
+{
+    if(_s->mod_g != NULL) gmskmod_destroy(_s->mod_g);
+    if(_s->mod_c != NULL) cpfskmod_destroy(_s->mod_c);
+    if(_s->mod_f != NULL) fskmod_destroy(_s->mod_f);
+    if(_s->interp != NULL) firinterp_crcf_destroy(_s->interp);
+    msresamp_crcf_destroy(_s->arb_interp);
+    free(_s->buf_internal);
+    free(_s->buf);
+    free(_s);
+    return LIQUID_OK;
+}
+
+// symbol from the object's own xorshift generator when it is seeded
+unsigned int symstreamrfcf_rand_sym(symstreamrfcf _q){
+    if(_q->seed == 0) return gen_rand_sym(_q->M);
+    uint32_t x = _q->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    _q->seed = x;
+    return x % _q->M;
+}
+
 unsigned int gmskmod_modulate_rand_sym(symstreamrfcf _q, liquid_float_complex *_y){
-    unsigned int s = gen_rand_sym(_q->M);
+    unsigned int s = symstreamrfcf_rand_sym(_q);
     gmskmod_modulate(_q->mod_g, s, _y);
     return s;
 }
 unsigned int cpfskmod_modulate_rand_sym(symstreamrfcf _q, liquid_float_complex *_y){
-    unsigned int s = gen_rand_sym(_q->M);
+    unsigned int s = symstreamrfcf_rand_sym(_q);
     cpfskmod_modulate(_q->mod_c, s, _y);
     return s;
 }
 unsigned int fskmod_modulate_rand_sym(symstreamrfcf _q, liquid_float_complex *_y){
-    unsigned int s = gen_rand_sym(_q->M);
+    unsigned int s = symstreamrfcf_rand_sym(_q);
     fskmod_modulate(_q->mod_f, s, _y);
     return s;
 }
@@ -0,0 +1,31 @@
+#include "iq_gain.hh"
+
+float iq_peak(const liquid_float_complex *_x, size_t _n, float _peak)
+{
+    // I and Q alike, as plain floats so the loop vectorizes
+    const float *v = (const float*)_x;
+    size_t i;
+    for (i=0; i<2*_n; i++) {
+        float a = fabsf(v[i]);
+        _peak = (a > _peak) ? a : _peak;
+    }
+    return _peak;
+}
+
+float iq_gain(float _peak, float _level)
+{
+    return (_peak > 0.0f) ? _level/_peak : 1.0f;
+}
+
+void iq_to_sc16(const liquid_float_complex *_x, size_t _n, float _gain, int16_t *_y)
+{
+    const float *v = (const float*)_x;
+    float scale = _gain*IQ_SC16_FULL_SCALE;
+    size_t i;
+    for (i=0; i<2*_n; i++) {
+        float a = v[i]*scale;
+        a = (a >  IQ_SC16_FULL_SCALE) ?  IQ_SC16_FULL_SCALE : a;
+        a = (a < -IQ_SC16_FULL_SCALE) ? -IQ_SC16_FULL_SCALE : a;
+        _y[i] = (int16_t)lrintf(a);
+    }
+}
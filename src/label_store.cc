@@ -0,0 +1,470 @@
+#include "label_store.hh"
+#include "modulation.hh"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct label_writer_s{
+    FILE *fid;
+    uint32_t block_records;
+    uint32_t pending;           // records in the open block
+    uint64_t written;           // records already in the file
+    double *t0;
+    double *dur;
+    double *fc;
+    double *bw;
+    uint16_t *mod;
+    uint32_t *meta;
+    // string table, 0 is ""; consecutive repeats of a meta string share an id
+    uint32_t next_string;
+    uint32_t last_meta_id;
+    char *last_meta;
+    char *strings;              // pending strings, NUL separated
+    size_t strings_len;
+    size_t strings_cap;
+    uint32_t strings_count;
+    // attributes, written when the file is closed
+    char *attrs;
+    size_t attrs_len;
+    size_t attrs_cap;
+    uint32_t attrs_count;
+};
+
+struct label_reader_s{
+    uint8_t *map;
+    size_t map_len;
+    uint64_t count;
+    uint32_t num_blocks;
+    label_block_t *blocks;
+    uint32_t num_strings;
+    const char **strings;
+    uint32_t num_attrs;
+    const char **attr_keys;
+    const char **attr_values;
+};
+
+static const char label_store_pad[8] = {0};
+
+int label_store_grow(char **buf, size_t *cap, size_t need){
+    if(need <= *cap) return 0;
+    size_t cap_new = (*cap) ? *cap : 256;
+    while(cap_new < need) cap_new <<= 1;
+    char *buf_new = (char*)realloc(*buf, cap_new);
+    if(buf_new == NULL) return 1;
+    *buf = buf_new;
+    *cap = cap_new;
+    return 0;
+}
+
+int label_writer_block(label_writer w, uint32_t kind, uint32_t count, uint64_t first,
+                       const void **parts, const size_t *lens, uint32_t num_parts){
+    // one block, every part padded to 8 bytes so columns stay aligned
+    label_block_header_t h;
+    memset(&h, 0, sizeof(h));
+    h.kind = kind;
+    h.count = count;
+    h.first = first;
+    for(uint32_t idx = 0; idx < num_parts; idx++) h.bytes += (lens[idx] + 7) & ~(size_t)7;
+    if(fwrite(&h, sizeof(h), 1, w->fid) != 1) return 1;
+    for(uint32_t idx = 0; idx < num_parts; idx++){
+        if(lens[idx] && fwrite(parts[idx], 1, lens[idx], w->fid) != lens[idx]) return 1;
+        size_t pad = ((lens[idx] + 7) & ~(size_t)7) - lens[idx];
+        if(pad && fwrite(label_store_pad, 1, pad, w->fid) != pad) return 1;
+    }
+    return 0;
+}
+
+label_writer label_writer_create(const char *path, uint32_t block_records){
+    if(path == NULL) return NULL;
+    if(block_records == 0) block_records = LABEL_STORE_BLOCK_RECORDS;
+    label_writer w = (label_writer)malloc(sizeof(struct label_writer_s));
+    if(w == NULL) return w;
+    memset(w, 0, sizeof(struct label_writer_s));
+    w->block_records = block_records;
+    w->next_string = 1;
+    w->t0 = (double*)malloc(4*block_records*sizeof(double));
+    w->mod = (uint16_t*)malloc(block_records*sizeof(uint16_t));
+    w->meta = (uint32_t*)malloc(block_records*sizeof(uint32_t));
+    w->fid = fopen(path, "wb");
+    if(w->t0 == NULL || w->mod == NULL || w->meta == NULL || w->fid == NULL){
+        if(w->fid != NULL) fclose(w->fid);
+        free(w->t0);
+        free(w->mod);
+        free(w->meta);
+        free(w);
+        return NULL;
+    }
+    w->dur = &w->t0[block_records];
+    w->fc = &w->t0[2*block_records];
+    w->bw = &w->t0[3*block_records];
+    setvbuf(w->fid, NULL, _IOFBF, 1<<20);
+    label_store_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LABEL_STORE_MAGIC, sizeof(h.magic));
+    h.version = LABEL_STORE_VERSION;
+    h.block_records = block_records;
+    fwrite(&h, sizeof(h), 1, w->fid);
+    fflush(w->fid);
+    return w;
+}
+
+int label_writer_append(label_writer w, double t0, double dur, double fc, double bw, uint16_t mod, const char *meta){
+    if(w == NULL) return 1;
+    uint32_t meta_id = 0;
+    if(meta != NULL && meta[0] != '\0'){
+        if(w->last_meta != NULL && strcmp(meta, w->last_meta) == 0){
+            meta_id = w->last_meta_id;
+        }
+        else{
+            size_t len = strlen(meta) + 1;
+            if(label_store_grow(&w->strings, &w->strings_cap, w->strings_len + len)) return 2;
+            memcpy(&w->strings[w->strings_len], meta, len);
+            free(w->last_meta);
+            w->last_meta = strdup(meta);
+            w->strings_len += len;
+            w->strings_count++;
+            meta_id = w->last_meta_id = w->next_string++;
+        }
+    }
+    uint32_t idx = w->pending++;
+    w->t0[idx] = t0;
+    w->dur[idx] = dur;
+    w->fc[idx] = fc;
+    w->bw[idx] = bw;
+    w->mod[idx] = mod;
+    w->meta[idx] = meta_id;
+    if(w->pending == w->block_records) return label_writer_flush(w);
+    return 0;
+}
+
+int label_writer_flush(label_writer w){
+    if(w == NULL) return 1;
+    if(w->strings_count){
+        // strings go first so every record block only points backwards
+        const void *parts[] = {w->strings};
+        size_t lens[] = {w->strings_len};
+        if(label_writer_block(w, LABEL_BLOCK_STRINGS, w->strings_count,
+                w->next_string - w->strings_count, parts, lens, 1)) return 2;
+        w->strings_len = 0;
+        w->strings_count = 0;
+    }
+    if(w->pending){
+        size_t n = w->pending;
+        const void *parts[] = {w->t0, w->dur, w->fc, w->bw, w->mod, w->meta};
+        size_t lens[] = {n*sizeof(double), n*sizeof(double), n*sizeof(double), n*sizeof(double),
+                         n*sizeof(uint16_t), n*sizeof(uint32_t)};
+        if(label_writer_block(w, LABEL_BLOCK_RECORDS, w->pending, w->written, parts, lens, 6)) return 2;
+        w->written += w->pending;
+        w->pending = 0;
+    }
+    return (fflush(w->fid)) ? 3 : 0;
+}
+
+int label_writer_set_attr(label_writer w, const char *key, const char *value){
+    if(w == NULL || key == NULL) return 1;
+    if(value == NULL) value = "";
+    size_t klen = strlen(key) + 1, vlen = strlen(value) + 1;
+    if(label_store_grow(&w->attrs, &w->attrs_cap, w->attrs_len + klen + vlen)) return 2;
+    memcpy(&w->attrs[w->attrs_len], key, klen);
+    memcpy(&w->attrs[w->attrs_len + klen], value, vlen);
+    w->attrs_len += klen + vlen;
+    w->attrs_count++;
+    return 0;
+}
+
+void label_writer_destroy(label_writer *w){
+    if(w == NULL) return;
+    if(*w == NULL) return;
+    label_writer_flush(*w);
+    if((*w)->attrs_count){
+        const void *parts[] = {(*w)->attrs};
+        size_t lens[] = {(*w)->attrs_len};
+        label_writer_block(*w, LABEL_BLOCK_ATTRS, (*w)->attrs_count, 0, parts, lens, 1);
+    }
+    fclose((*w)->fid);
+    free((*w)->t0);
+    free((*w)->mod);
+    free((*w)->meta);
+    free((*w)->last_meta);
+    free((*w)->strings);
+    free((*w)->attrs);
+    free(*w);
+    *w = NULL;
+}
+
+// Parse count NUL terminated strings out of a payload; returns how many
+// were whole
+uint32_t label_reader_split(const char *buf, uint64_t bytes, uint32_t count, const char **out){
+    uint64_t off = 0;
+    uint32_t idx = 0;
+    for(; idx < count && off < bytes; idx++){
+        const char *end = (const char*)memchr(buf + off, '\0', bytes - off);
+        if(end == NULL) break;
+        out[idx] = buf + off;
+        off = (end - buf) + 1;
+    }
+    return idx;
+}
+
+label_reader label_reader_open(const char *path){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+    struct stat st;
+    if(fstat(fd, &st) || st.st_size < (off_t)sizeof(label_store_header_t)){
+        close(fd);
+        return NULL;
+    }
+    uint8_t *map = (uint8_t*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == (uint8_t*)MAP_FAILED) return NULL;
+    const label_store_header_t *fh = (const label_store_header_t*)map;
+    if(memcmp(fh->magic, LABEL_STORE_MAGIC, sizeof(fh->magic)) || fh->version != LABEL_STORE_VERSION){
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    label_reader r = (label_reader)malloc(sizeof(struct label_reader_s));
+    memset(r, 0, sizeof(struct label_reader_s));
+    r->map = map;
+    r->map_len = st.st_size;
+    r->num_strings = 1;
+    r->strings = (const char**)malloc(sizeof(const char*));
+    r->strings[0] = "";
+    uint32_t blocks_cap = 0;
+    uint64_t off = sizeof(label_store_header_t);
+    while(off + sizeof(label_block_header_t) <= r->map_len){
+        label_block_header_t h;
+        memcpy(&h, &map[off], sizeof(h));
+        const uint8_t *payload = &map[off + sizeof(h)];
+        if(h.bytes > r->map_len - off - sizeof(h)) break;// cut short, keep what came before
+        if(h.kind == LABEL_BLOCK_RECORDS){
+            uint64_t n = h.count;
+            uint64_t need = 4*n*sizeof(double) + ((n*sizeof(uint16_t) + 7) & ~7ULL) + n*sizeof(uint32_t);
+            if(h.bytes < need || h.first != r->count) break;
+            if(r->num_blocks == blocks_cap){
+                blocks_cap = (blocks_cap) ? 2*blocks_cap : 64;
+                r->blocks = (label_block_t*)realloc(r->blocks, blocks_cap*sizeof(label_block_t));
+            }
+            label_block_t *b = &r->blocks[r->num_blocks++];
+            b->first = h.first;
+            b->count = h.count;
+            b->t0 = (const double*)payload;
+            b->dur = b->t0 + n;
+            b->fc = b->dur + n;
+            b->bw = b->fc + n;
+            b->mod = (const uint16_t*)(b->bw + n);
+            b->meta = (const uint32_t*)(payload + 4*n*sizeof(double) + ((n*sizeof(uint16_t) + 7) & ~7ULL));
+            r->count += n;
+        }
+        else if(h.kind == LABEL_BLOCK_STRINGS){
+            if(h.first != r->num_strings) break;
+            r->strings = (const char**)realloc(r->strings, (r->num_strings + h.count)*sizeof(const char*));
+            uint32_t got = label_reader_split((const char*)payload, h.bytes, h.count, &r->strings[r->num_strings]);
+            r->num_strings += got;
+            if(got != h.count) break;
+        }
+        else if(h.kind == LABEL_BLOCK_ATTRS){
+            const char **kv = (const char**)malloc(2*h.count*sizeof(const char*));
+            uint32_t got = label_reader_split((const char*)payload, h.bytes, 2*h.count, kv)/2;
+            r->attr_keys = (const char**)realloc(r->attr_keys, (r->num_attrs + got)*sizeof(const char*));
+            r->attr_values = (const char**)realloc(r->attr_values, (r->num_attrs + got)*sizeof(const char*));
+            for(uint32_t idx = 0; idx < got; idx++){
+                r->attr_keys[r->num_attrs] = kv[2*idx];
+                r->attr_values[r->num_attrs++] = kv[2*idx + 1];
+            }
+            free(kv);
+        }
+        off += sizeof(h) + h.bytes;
+    }
+    return r;
+}
+
+void label_reader_destroy(label_reader *r){
+    if(r == NULL) return;
+    if(*r == NULL) return;
+    munmap((*r)->map, (*r)->map_len);
+    free((*r)->blocks);
+    free((*r)->strings);
+    free((*r)->attr_keys);
+    free((*r)->attr_values);
+    free(*r);
+    *r = NULL;
+}
+
+uint64_t label_reader_count(label_reader r){
+    if(r == NULL) return 0;
+    return r->count;
+}
+
+uint32_t label_reader_num_blocks(label_reader r){
+    if(r == NULL) return 0;
+    return r->num_blocks;
+}
+
+const label_block_t* label_reader_block(label_reader r, uint32_t idx){
+    if(r == NULL || idx >= r->num_blocks) return NULL;
+    return &r->blocks[idx];
+}
+
+int label_reader_get(label_reader r, uint64_t idx, label_record_t *rec){
+    if(r == NULL || rec == NULL || idx >= r->count) return 1;
+    // last block starting at or before idx
+    uint32_t lo = 0, hi = r->num_blocks;
+    while(hi - lo > 1){
+        uint32_t mid = lo + (hi - lo)/2;
+        if(r->blocks[mid].first <= idx) lo = mid;
+        else hi = mid;
+    }
+    const label_block_t *b = &r->blocks[lo];
+    uint64_t at = idx - b->first;
+    rec->t0 = b->t0[at];
+    rec->dur = b->dur[at];
+    rec->fc = b->fc[at];
+    rec->bw = b->bw[at];
+    rec->mod = b->mod[at];
+    rec->meta = label_reader_meta(r, b->meta[at]);
+    return 0;
+}
+
+const char* label_reader_meta(label_reader r, uint32_t id){
+    if(r == NULL || id >= r->num_strings) return "";
+    return r->strings[id];
+}
+
+const char* label_reader_attr(label_reader r, const char *key){
+    if(r == NULL || key == NULL) return NULL;
+    for(uint32_t idx = r->num_attrs; idx > 0; idx--){// last one set wins
+        if(strcmp(r->attr_keys[idx-1], key) == 0) return r->attr_values[idx-1];
+    }
+    return NULL;
+}
+
+static const char* label_reader_attr_or(label_reader r, const char *key, const char *fallback){
+    const char *value = label_reader_attr(r, key);
+    return (value != NULL) ? value : fallback;
+}
+
+int label_reader_reports_json(label_reader r, FILE *fid, const char *suffix){
+    if(r == NULL || fid == NULL) return 1;
+    if(suffix == NULL) suffix = "";
+    const char *prefix = label_reader_attr_or(r, "prefix", "GT ENG");
+    double start = -1, stop = -1, freq_lo = -1, freq_hi = -1;
+    for(uint32_t b_idx = 0; b_idx < r->num_blocks; b_idx++){
+        const label_block_t *b = &r->blocks[b_idx];
+        for(uint32_t idx = 0; idx < b->count; idx++){
+            double tic = b->t0[idx], dur = b->dur[idx], fc = b->fc[idx], bw = b->bw[idx];
+            const char *mod = (b->mod[idx] < SIGNAL_MODULATION_LIST_LEN) ?
+                signal_modulation_list[b->mod[idx]].name_label : "unknown";
+            if (start < 0)
+                start = tic;
+            stop = tic + dur;
+            if (freq_lo < 0 || fc - 0.5*bw < freq_lo)
+                freq_lo = fc - 0.5*bw;
+            if (freq_hi < 0 || fc + 0.5*bw > freq_hi)
+                freq_hi = fc + 0.5*bw;
+            if (b->first + idx > 0)
+                fprintf(fid,",\n");
+            fprintf(fid,"        {\n");
+            fprintf(fid,"            \"report_type\": \"energy\",\n");
+            fprintf(fid,"            \"instance_name\": \"%s%.6u%s\",\n", prefix, (unsigned int)(b->first + idx), suffix);
+            fprintf(fid,"            \"freq_lo\": %.6f,\n", (fc-0.5*bw)*1e-6f); // MHz
+            fprintf(fid,"            \"freq_hi\": %.6f,\n", (fc+0.5*bw)*1e-6f); // MHz
+            fprintf(fid,"            \"bw\":      %.6f,\n", (       bw)*1e-6f); // MHz
+            fprintf(fid,"            \"time_start\": %.9f,\n", tic);
+            fprintf(fid,"            \"time_stop\":  %.9f,\n", tic + dur);
+            fprintf(fid,"            \"duration\":   %.16f,\n", dur);
+            fprintf(fid,"            \"modulation\": \"%s\",\n", mod);
+            fprintf(fid,"            \"meta\": \"%s\"\n", label_reader_meta(r, b->meta[idx]));
+            fprintf(fid,"        }");
+        }
+    }
+    double fc = 0.5*(freq_hi + freq_lo);
+    double bw =      freq_hi - freq_lo;
+    if (r->count > 0){
+        const char *signal = label_reader_attr_or(r, "signal", "GT SIG 0000001");
+        fprintf(fid,",\n");
+        fprintf(fid,"        {\n");
+        fprintf(fid,"            \"report_type\": \"signal\",\n");
+        fprintf(fid,"            \"instance_name\": \"%s%s\",\n", signal, suffix);
+        fprintf(fid,"            \"activity_type\": \"%s\",\n", label_reader_attr_or(r, "activity_type", "lowprob_anomaly"));
+        fprintf(fid,"            \"reference_time\": %.6f,\n", (stop-start)/2+stop);
+        fprintf(fid,"            \"reference_freq\": %.6f,\n", fc/1000000);
+        fprintf(fid,"            \"protocol\": \"%s\",\n", label_reader_attr_or(r, "protocol", "unknown"));
+        fprintf(fid,"            \"modulation\": \"%s\",\n", label_reader_attr_or(r, "modulation", "unknown"));
+        fprintf(fid,"            \"mod_name_label\": \"%s\",\n", label_reader_attr_or(r, "mod_name_label", "unknown"));
+        fprintf(fid,"            \"mod_family_label\": \"%s\",\n", label_reader_attr_or(r, "mod_family_label", ""));
+        fprintf(fid,"            \"mod_src_name\": \"%s\",\n", label_reader_attr_or(r, "mod_src_name", "nil"));
+        fprintf(fid,"            \"modality\": \"%s\",\n", label_reader_attr_or(r, "modality", "unknown"));
+        fprintf(fid,"            \"modification\": \"no_modification\",\n");
+        fprintf(fid,"            \"freq_lo\": %.6f,\n", fc/1000000 - 0.5*bw/1000000);
+        fprintf(fid,"            \"freq_hi\": %.6f,\n", fc/1000000 + 0.5*bw/1000000);
+        fprintf(fid,"            \"bw\": %.6f,\n", bw/1000000);
+        fprintf(fid,"            \"energy_bw\": %.6f,\n", atof(label_reader_attr_or(r, "energy_bw", "0")));
+        fprintf(fid,"            \"time_start\": %.6f,\n", start);
+        fprintf(fid,"            \"time_stop\": %.6f,\n", stop);
+        fprintf(fid,"            \"duration\": %.6f,\n", stop-start);
+        fprintf(fid,"            \"energy_set\": [\n");
+        for (uint64_t i=0; i<r->count; i++)
+            fprintf(fid,"                \"%s%06u%s\"%s\n", prefix, (unsigned int)i, suffix, i==r->count-1 ? "" : ",");
+        fprintf(fid,"            ],\n");
+        fprintf(fid,"            \"rx_center_freq\": {\n");
+        fprintf(fid,"                \"rx1\": %.6f\n", fc/1000000);
+        fprintf(fid,"            },\n");
+        fprintf(fid,"            \"rx_sample_rate\": {\n");
+        fprintf(fid,"                \"rx1\": 100\n");
+        fprintf(fid,"            },\n");
+        fprintf(fid,"            \"rx_input_snr\": {\n");
+        fprintf(fid,"                \"rx1\": -100 \n");
+        fprintf(fid,"            }\n");
+        fprintf(fid,"        }");
+    }
+    return 0;
+}
+
+int label_reader_source_json(label_reader r, FILE *fid, const char *suffix, const char **signals, uint32_t num_signals){
+    if(r == NULL || fid == NULL) return 1;
+    if(suffix == NULL) suffix = "";
+    const char *signal = label_reader_attr_or(r, "signal", "GT SIG 0000001");
+    if(signals == NULL){
+        signals = &signal;
+        num_signals = 1;
+    }
+    fprintf(fid,"        {\n");
+    fprintf(fid,"            \"report_type\": \"source\",\n");
+    fprintf(fid,"            \"instance_name\": \"%s%s\",\n", label_reader_attr_or(r, "source", "GT SRC 0000001"), suffix);
+    fprintf(fid,"            \"signal_set\": [\n");
+    for(uint32_t idx = 0; idx < num_signals; idx++)
+        fprintf(fid,"                \"%s\"%s\n", signals[idx], idx==num_signals-1 ? "" : ",");
+    fprintf(fid,"            ],\n");
+    fprintf(fid,"            \"device_origin\": \"%s\"\n", label_reader_attr_or(r, "device_origin", "custom label"));
+    fprintf(fid,"        }");
+    return 0;
+}
+
+int label_reader_to_json(label_reader r, FILE *fid){
+    // same document labels::json_close() writes
+    if(r == NULL || fid == NULL) return 1;
+    fprintf(fid,"{\n");
+    fprintf(fid,"    \"reports\": [\n");
+    label_reader_reports_json(r, fid, "");
+    if (r->count > 0){
+        fprintf(fid,",\n");
+        label_reader_source_json(r, fid, "", NULL, 0);
+        fprintf(fid,"\n");
+    }
+    else{
+        fprintf(fid,"\n");
+    }
+    const char *misc = label_reader_attr(r, "misc");
+    if (misc != NULL && strlen(misc) > 15){
+        fprintf(fid,"    ],\n");
+        fprintf(fid,"%s",misc);
+        fprintf(fid,"    }\n");
+    }
+    else{
+        fprintf(fid,"    ]\n");
+    }
+    fprintf(fid,"}\n");
+    return 0;
+}
@@ -1,7 +1,18 @@
 
+
 #include "labels.hh"
 #ifdef __cplusplus
 #include <iostream>
+#include <chrono>
+#include <stdarg.h>
+#include <unistd.h>
+
+static double labels_now()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 labels::labels(std::string _filename,
                std::string _prefix,
                std::string _signal,
@@ -12,6 +23,11 @@ labels::labels(std::string _filename,
     source(_source),
     misc("    \"misc\": {\n"),
     count(0), start(-1), stop(-1), freq_lo(-1), freq_hi(-1),
+    flush_bytes(1<<20), flush_seconds(1.0), last_flush(0), tail_len(0),
+    in_reports(false),
+    modulation_index(LABEL_STORE_MOD_UNSET),
+    binary(NULL),
+    index(NULL),
     protocol("unknown"),
     modality("unknown"),
     activity_type("lowprob_anomaly"),
@@ -26,7 +42,7 @@ labels::labels(std::string _filename,
 
 labels::~labels()
 {
-    if(fid != NULL)
+    if(fid != NULL || binary != NULL || index != NULL)
         json_close();
 }
 
@@ -36,71 +52,182 @@ void labels::json_init()
     if (!fid)
         throw std::runtime_error("could not open " + filename + " for writing");
     fclose(fid);
-    fid = fopen(filename.c_str(), "a");
-    fprintf(fid,"{\n");
+    fid = fopen(filename.c_str(), "r+");
+    if (!fid)
+        throw std::runtime_error("could not open " + filename + " for writing");
+    buf.reserve(flush_bytes + 4096);
+    last_flush = labels_now();
+    emit("{\n");
     // fprintf(fid,"    \"reports\": [\n");
+    write_out(true);
+}
+
+void labels::emit(const char *fmt, ...)
+{
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len < 0)
+        return;
+    if ((size_t)len < sizeof(line)){
+        buf.append(line, len);
+        return;
+    }
+    // long strings (prefix, meta) do not fit the stack line
+    size_t at = buf.size();
+    buf.resize(at + len + 1);
+    va_start(args, fmt);
+    vsnprintf(&buf[at], len + 1, fmt, args);
+    va_end(args);
+    buf.resize(at + len);
+}
+
+void labels::write_out(bool with_tail)
+{
+    if (fid == NULL)
+        return;
+    // the closing tail for where the document is now
+    const char *tail = (in_reports) ? "\n    ]\n}\n" : "}\n";
+    if (tail_len > 0)
+        fseek(fid, -tail_len, SEEK_END);
+    fwrite(buf.data(), 1, buf.size(), fid);
+    buf.clear();
+    tail_len = 0;
+    if (with_tail){
+        tail_len = strlen(tail);
+        fwrite(tail, 1, tail_len, fid);
+    }
+    fflush(fid);
+    last_flush = labels_now();
+}
+
+void labels::flush()
+{
+    write_out(true);
+}
+
+bool labels::enable_binary(std::string _path, uint32_t block_records)
+{
+    if (binary != NULL)
+        label_writer_destroy(&binary);
+    binary = label_writer_create(_path.c_str(), block_records);
+    return binary != NULL;
+}
+
+bool labels::enable_index(std::string _path)
+{
+    if (index == NULL)
+        index = burst_index_create(0);
+    index_path = _path;
+    return index != NULL;
 }
 
+void labels::binary_close()
+{
+    if (index != NULL){
+        if (burst_index_save(index, index_path.c_str()))
+            std::cout << "could not write " << index_path << std::endl;
+        burst_index_destroy(&index);
+    }
+    if (binary == NULL)
+        return;
+    char value[64];
+    snprintf(value, sizeof(value), "%.17g", eng_bw);
+    label_writer_set_attr(binary, "prefix", prefix.c_str());
+    label_writer_set_attr(binary, "signal", signal.c_str());
+    label_writer_set_attr(binary, "source", source.c_str());
+    label_writer_set_attr(binary, "activity_type", activity_type.c_str());
+    label_writer_set_attr(binary, "protocol", protocol.c_str());
+    label_writer_set_attr(binary, "modulation", modulation.c_str());
+    label_writer_set_attr(binary, "mod_name_label", modulation_origin.c_str());
+    label_writer_set_attr(binary, "mod_family_label", modulation_family.c_str());
+    label_writer_set_attr(binary, "mod_src_name", modulation_src.c_str());
+    label_writer_set_attr(binary, "modality", modality.c_str());
+    label_writer_set_attr(binary, "device_origin", device_origin.c_str());
+    label_writer_set_attr(binary, "energy_bw", value);
+    label_writer_set_attr(binary, "misc", misc.c_str());
+    label_writer_destroy(&binary);
+}
 
 void labels::json_close()
 {
+    binary_close();
+    if (fid == NULL)
+        return;
     // derive global center frequency and bandwidth
     double fc = 0.5*(freq_hi + freq_lo);
     double bw =      freq_hi - freq_lo;
 
     if (count > 0){
-        fprintf(fid,"        {\n");
-        fprintf(fid,"            \"report_type\": \"signal\",\n");
-        fprintf(fid,"            \"instance_name\": \"%s\",\n", signal.c_str());
-        fprintf(fid,"            \"activity_type\": \"%s\",\n", activity_type.c_str());
-        fprintf(fid,"            \"reference_time\": %.6f,\n", (stop-start)/2+stop);
-        fprintf(fid,"            \"reference_freq\": %.6f,\n", fc/1000000);
-        fprintf(fid,"            \"protocol\": \"%s\",\n",protocol.c_str());
-        fprintf(fid,"            \"modulation\": \"%s\",\n", modulation.c_str());
-        fprintf(fid,"            \"mod_name_label\": \"%s\",\n", modulation_origin.c_str());
-        fprintf(fid,"            \"mod_family_label\": \"%s\",\n", modulation_family.c_str());
-        fprintf(fid,"            \"mod_src_name\": \"%s\",\n", modulation_src.c_str());
-        fprintf(fid,"            \"modality\": \"%s\",\n", modality.c_str());
-        fprintf(fid,"            \"modification\": \"no_modification\",\n");
-        fprintf(fid,"            \"freq_lo\": %.6f,\n", fc/1000000 - 0.5*bw/1000000);
-        fprintf(fid,"            \"freq_hi\": %.6f,\n", fc/1000000 + 0.5*bw/1000000);
-        fprintf(fid,"            \"bw\": %.6f,\n", bw/1000000);
-        fprintf(fid,"            \"energy_bw\": %.6f,\n",eng_bw);
-        fprintf(fid,"            \"time_start\": %.6f,\n", start);
-        fprintf(fid,"            \"time_stop\": %.6f,\n", stop);
-        fprintf(fid,"            \"duration\": %.6f,\n", stop-start);
-        fprintf(fid,"            \"energy_set\": [\n");
-        for (unsigned int i=0; i<count; i++)
-            fprintf(fid,"                \"%s%06u\"%s\n", prefix.c_str(), i, i==count-1 ? "" : ",");
-        fprintf(fid,"            ],\n");
-        fprintf(fid,"            \"rx_center_freq\": {\n");
-        fprintf(fid,"                \"rx1\": %.6f\n", fc/1000000);
-        fprintf(fid,"            },\n");
-        fprintf(fid,"            \"rx_sample_rate\": {\n");
-        fprintf(fid,"                \"rx1\": 100\n");
-        fprintf(fid,"            },\n");
-        fprintf(fid,"            \"rx_input_snr\": {\n");
-        fprintf(fid,"                \"rx1\": -100 \n");
-        fprintf(fid,"            }\n");
-        fprintf(fid,"        },\n");
-        fprintf(fid,"        {\n");
-        fprintf(fid,"            \"report_type\": \"source\",\n");
-        fprintf(fid,"            \"instance_name\": \"%s\",\n", source.c_str());
-        fprintf(fid,"            \"signal_set\": [\n");
-        fprintf(fid,"                \"%s\"\n", signal.c_str());
-        fprintf(fid,"            ],\n");
-        fprintf(fid,"            \"device_origin\": \"%s\"\n",device_origin.c_str());
-        fprintf(fid,"        }\n");
+        emit(",\n");
+        emit("        {\n");
+        emit("            \"report_type\": \"signal\",\n");
+        emit("            \"instance_name\": \"%s\",\n", signal.c_str());
+        emit("            \"activity_type\": \"%s\",\n", activity_type.c_str());
+        emit("            \"reference_time\": %.6f,\n", (stop-start)/2+stop);
+        emit("            \"reference_freq\": %.6f,\n", fc/1000000);
+        emit("            \"protocol\": \"%s\",\n",protocol.c_str());
+        emit("            \"modulation\": \"%s\",\n", modulation.c_str());
+        emit("            \"mod_name_label\": \"%s\",\n", modulation_origin.c_str());
+        emit("            \"mod_family_label\": \"%s\",\n", modulation_family.c_str());
+        emit("            \"mod_src_name\": \"%s\",\n", modulation_src.c_str());
+        emit("            \"modality\": \"%s\",\n", modality.c_str());
+        emit("            \"modification\": \"no_modification\",\n");
+        emit("            \"freq_lo\": %.6f,\n", fc/1000000 - 0.5*bw/1000000);
+        emit("            \"freq_hi\": %.6f,\n", fc/1000000 + 0.5*bw/1000000);
+        emit("            \"bw\": %.6f,\n", bw/1000000);
+        emit("            \"energy_bw\": %.6f,\n",eng_bw);
+        emit("            \"time_start\": %.6f,\n", start);
+        emit("            \"time_stop\": %.6f,\n", stop);
+        emit("            \"duration\": %.6f,\n", stop-start);
+        emit("            \"energy_set\": [\n");
+        for (unsigned int i=0; i<count; i++){
+            emit("                \"%s%06u\"%s\n", prefix.c_str(), i, i==count-1 ? "" : ",");
+            if (buf.size() >= flush_bytes)
+                write_out(false);
+        }
+        emit("            ],\n");
+        emit("            \"rx_center_freq\": {\n");
+        emit("                \"rx1\": %.6f\n", fc/1000000);
+        emit("            },\n");
+        emit("            \"rx_sample_rate\": {\n");
+        emit("                \"rx1\": 100\n");
+        emit("            },\n");
+        emit("            \"rx_input_snr\": {\n");
+        emit("                \"rx1\": -100 \n");
+        emit("            }\n");
+        emit("        },\n");
+        emit("        {\n");
+        emit("            \"report_type\": \"source\",\n");
+        emit("            \"instance_name\": \"%s\",\n", source.c_str());
+        emit("            \"signal_set\": [\n");
+        emit("                \"%s\"\n", signal.c_str());
+        emit("            ],\n");
+        emit("            \"device_origin\": \"%s\"\n",device_origin.c_str());
+        emit("        }\n");
+    }
+    else if (in_reports){
+        emit("\n");
+    }
+    if (in_reports){
         if (misc.length() > 15){
-            fprintf(fid,"    ],\n");
-            fprintf(fid,"%s",misc.c_str());
-            fprintf(fid,"    }\n");
+            emit("    ],\n");
+            emit("%s",misc.c_str());
+            emit("    }\n");
         }
         else{
-            fprintf(fid,"    ]\n");
+            emit("    ]\n");
         }
-        fprintf(fid,"}\n");
     }
+    emit("}\n");
+    in_reports = false;
+    write_out(false);
+    // the final document may be shorter than the previous one plus tail
+    fflush(fid);
+    if (ftruncate(fileno(fid), ftell(fid)))
+        std::cout << "could not trim " << filename << std::endl;
     fclose(fid);
     fid = NULL;
     std::cout << ".json log written to " << filename << std::endl;
@@ -108,7 +235,9 @@ void labels::json_close()
 
 void labels::start_reports()
 {
-    fprintf(fid,"    \"reports\": [\n");
+    emit("    \"reports\": [\n");
+    in_reports = true;
+    write_out(true);
 }
 
 void labels::append(double tic, double dur, double fc, double bw, std::string meta)
@@ -125,21 +254,32 @@ void labels::append(double tic, double dur, double fc, double bw, std::string me
     freq_lo = std::min(freq_lo, fc - 0.5*bw);
     freq_hi = std::max(freq_hi, fc + 0.5*bw);
 
-    fprintf(fid,"        {\n");
-    fprintf(fid,"            \"report_type\": \"energy\",\n");
-    fprintf(fid,"            \"instance_name\": \"%s%.6u\",\n", prefix.c_str(), count);
-    fprintf(fid,"            \"freq_lo\": %.6f,\n", (fc-0.5*bw)*1e-6f); // MHz
-    fprintf(fid,"            \"freq_hi\": %.6f,\n", (fc+0.5*bw)*1e-6f); // MHz
-    fprintf(fid,"            \"bw\":      %.6f,\n", (       bw)*1e-6f); // MHz
-    fprintf(fid,"            \"time_start\": %.9f,\n", tic);
-    fprintf(fid,"            \"time_stop\":  %.9f,\n", tic + dur);
-    fprintf(fid,"            \"duration\":   %.16f,\n", dur);
-    fprintf(fid,"            \"modulation\": \"%s\",\n", modulation.c_str());
-    fprintf(fid,"            \"meta\": \"%s\"\n", meta.c_str());
-    fprintf(fid,"        },\n");
+    // separator first, so the last report never has a trailing comma
+    if (count > 0)
+        emit(",\n");
+    emit("        {\n");
+    emit("            \"report_type\": \"energy\",\n");
+    emit("            \"instance_name\": \"%s%.6u\",\n", prefix.c_str(), count);
+    emit("            \"freq_lo\": %.6f,\n", (fc-0.5*bw)*1e-6f); // MHz
+    emit("            \"freq_hi\": %.6f,\n", (fc+0.5*bw)*1e-6f); // MHz
+    emit("            \"bw\":      %.6f,\n", (       bw)*1e-6f); // MHz
+    emit("            \"time_start\": %.9f,\n", tic);
+    emit("            \"time_stop\":  %.9f,\n", tic + dur);
+    emit("            \"duration\":   %.16f,\n", dur);
+    emit("            \"modulation\": \"%s\",\n", modulation.c_str());
+    emit("            \"meta\": \"%s\"\n", meta.c_str());
+    emit("        }");
+
+    if (binary != NULL)
+        label_writer_append(binary, tic, dur, fc, bw, modulation_index, meta.c_str());
+    if (index != NULL)
+        burst_index_add(index, tic, dur, fc, bw, count);
 
     // update internal counter
     count++;
+
+    if (buf.size() >= flush_bytes || labels_now() - last_flush >= flush_seconds)
+        write_out(true);
 }
 
 
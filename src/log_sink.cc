@@ -0,0 +1,171 @@
+#include "log_sink.hh"
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static double log_sink_now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static void log_sink_segment_path(log_sink sink, uint32_t seq, char *path, size_t len){
+    snprintf(path, len, "%s.%06u.log", sink->prefix, seq);
+}
+
+static int log_sink_open_segment(log_sink sink, uint64_t min_bytes){
+    uint64_t capacity = (min_bytes > sink->segment_bytes) ? min_bytes : sink->segment_bytes;
+    log_sink_segment_path(sink, sink->seq, sink->path, strlen(sink->prefix) + 32);
+    int fd = open(sink->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) return 1;
+    if(ftruncate(fd, capacity + LOG_SINK_TRAILER_BYTES)){
+        close(fd);
+        return 2;
+    }
+    uint8_t *map = (uint8_t*)mmap(NULL, capacity + LOG_SINK_TRAILER_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(map == (uint8_t*)MAP_FAILED){
+        close(fd);
+        return 3;
+    }
+    madvise(map, capacity, MADV_SEQUENTIAL);
+    sink->fd = fd;
+    sink->map = map;
+    sink->map_len = capacity + LOG_SINK_TRAILER_BYTES;
+    sink->cursor = 0;
+    sink->synced = 0;
+    sink->opened_at = log_sink_now();
+    sink->synced_at = sink->opened_at;
+    sink->trailer = (log_sink_trailer_t*)&map[capacity];
+    memcpy(sink->trailer->magic, LOG_SINK_MAGIC, sizeof(sink->trailer->magic));
+    sink->trailer->seq = sink->seq;
+    sink->trailer->records = 0;
+    __atomic_store_n(&sink->trailer->committed, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void log_sink_close_segment(log_sink sink){
+    if(sink->map == NULL) return;
+    // rotation and close always sync, fsync_interval only paces the syncs in between
+    log_sink_sync(sink);
+    munmap(sink->map, sink->map_len);
+    // a clean segment is just its data, no trailer
+    if(ftruncate(sink->fd, sink->cursor) == 0) fsync(sink->fd);
+    close(sink->fd);
+    sink->map = NULL;
+    sink->trailer = NULL;
+    sink->fd = -1;
+    sink->seq++;
+}
+
+log_sink log_sink_create(const char *prefix, uint64_t segment_bytes, double rotate_seconds, double fsync_interval){
+    if(prefix == NULL || segment_bytes == 0) return NULL;
+    log_sink sink = (log_sink)malloc(sizeof(struct log_sink_s));
+    if(sink == NULL) return sink;
+    memset(sink, 0, sizeof(struct log_sink_s));
+    sink->prefix = strdup(prefix);
+    sink->path = (char*)malloc(strlen(prefix) + 32);
+    sink->segment_bytes = segment_bytes;
+    sink->rotate_seconds = rotate_seconds;
+    sink->fsync_interval = fsync_interval;
+    sink->fd = -1;
+    if(sink->prefix == NULL || sink->path == NULL){
+        log_sink_destroy(&sink);
+        return NULL;
+    }
+    // repair segments a crashed run left open, then start after the last one
+    struct stat st;
+    while(1){
+        log_sink_segment_path(sink, sink->seq, sink->path, strlen(prefix) + 32);
+        if(stat(sink->path, &st)) break;
+        log_sink_recover(sink->path);
+        sink->seq++;
+    }
+    if(log_sink_open_segment(sink, 0)){
+        log_sink_destroy(&sink);
+        return NULL;
+    }
+    return sink;
+}
+
+void log_sink_destroy(log_sink *sink){
+    if(sink == NULL) return;
+    if(*sink == NULL) return;
+    log_sink_close_segment(*sink);
+    if((*sink)->prefix != NULL) free((*sink)->prefix);
+    if((*sink)->path != NULL) free((*sink)->path);
+    free(*sink);
+    *sink = NULL;
+}
+
+int log_sink_write(log_sink sink, const void *data, uint64_t len){
+    if(sink == NULL || sink->map == NULL) return 1;
+    uint64_t capacity = sink->map_len - LOG_SINK_TRAILER_BYTES;
+    uint8_t rotate = (sink->cursor + len > capacity);
+    if(!rotate && sink->rotate_seconds > 0 && sink->cursor > 0)
+        rotate = (log_sink_now() - sink->opened_at >= sink->rotate_seconds);
+    if(rotate){
+        log_sink_close_segment(sink);
+        if(log_sink_open_segment(sink, len)) return 2;
+    }
+    memcpy(&sink->map[sink->cursor], data, len);
+    sink->cursor += len;
+    sink->records++;
+    // the record is whole, now let the tail marker cover it
+    sink->trailer->records++;
+    __atomic_store_n(&sink->trailer->committed, sink->cursor, __ATOMIC_RELEASE);
+    if(sink->fsync_interval == 0) return log_sink_sync(sink);
+    if(sink->fsync_interval > 0 && log_sink_now() - sink->synced_at >= sink->fsync_interval)
+        return log_sink_sync(sink);
+    return 0;
+}
+
+int log_sink_sync(log_sink sink){
+    if(sink == NULL || sink->map == NULL) return 1;
+    // data first, then the trailer that vouches for it
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t start = sink->synced & ~(page - 1);
+    int rc = 0;
+    if(sink->cursor > start)
+        rc |= msync(&sink->map[start], sink->cursor - start, MS_SYNC);
+    uint64_t trailer_at = (sink->map_len - LOG_SINK_TRAILER_BYTES) & ~(page - 1);
+    rc |= msync(&sink->map[trailer_at], sink->map_len - trailer_at, MS_SYNC);
+    sink->synced = sink->cursor;
+    sink->synced_at = log_sink_now();
+    return (rc) ? 3 : 0;
+}
+
+int log_sink_rotate(log_sink sink){
+    if(sink == NULL) return 1;
+    log_sink_close_segment(sink);
+    return log_sink_open_segment(sink, 0);
+}
+
+uint64_t log_sink_records(log_sink sink){
+    if(sink == NULL) return 0;
+    return sink->records;
+}
+
+const char* log_sink_path(log_sink sink){
+    if(sink == NULL) return NULL;
+    return sink->path;
+}
+
+int64_t log_sink_recover(const char *path){
+    int fd = open(path, O_RDWR);
+    if(fd < 0) return -1;
+    struct stat st;
+    log_sink_trailer_t trailer;
+    if(fstat(fd, &st) || st.st_size < LOG_SINK_TRAILER_BYTES
+        || pread(fd, &trailer, sizeof(trailer), st.st_size - LOG_SINK_TRAILER_BYTES) != sizeof(trailer)
+        || memcmp(trailer.magic, LOG_SINK_MAGIC, sizeof(trailer.magic))
+        || trailer.committed > (uint64_t)(st.st_size - LOG_SINK_TRAILER_BYTES)){
+        close(fd);// closed cleanly, or not ours
+        return -1;
+    }
+    int64_t kept = trailer.committed;
+    if(ftruncate(fd, kept) == 0) fsync(fd);
+    close(fd);
+    return kept;
+}
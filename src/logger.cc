@@ -5,6 +5,7 @@
 #include <iomanip>
 #include <ios>
 #include <ctime>
+#include <limits>
 #endif
 #include <unistd.h>
 
@@ -51,7 +52,12 @@ logger_client::logger_client()
     z_connected(false),
     auto_connect(false),
     use_cout(false),
-    enabled(1)
+    enabled(1),
+    a_running(false),
+    a_dropped(0),
+    a_sent(0),
+    a_truncated(0),
+    a_batch(64)
 {
   std::string file = file_name(__FILE__);
   std::stringstream temp;
@@ -76,7 +82,12 @@ logger_client::logger_client(std::string tag, std::string frontend_addr, bool au
     z_connected(false),
     auto_connect(auto_connect),
     use_cout(false),
-    enabled(1)
+    enabled(1),
+    a_running(false),
+    a_dropped(0),
+    a_sent(0),
+    a_truncated(0),
+    a_batch(64)
 {
   if (header_tag.size() == 0){
     std::string file = file_name(__FILE__);
@@ -100,6 +111,7 @@ logger_client::~logger_client()
 {
   *this << set_level(logger::INFO) << "Disconnecting\n";
   commit();
+  disable_async();
   shutdown_network();
 }
 
@@ -266,6 +278,35 @@ void logger_client::shutdown_network(){
   }
 }
 void logger_client::disable(){ enabled = 0; use_cout = 0; shutdown_network(); }
+void logger_client::set_shards(uint32_t shards){
+  // hash the client id (tag, pid, instance) onto one of the server's
+  // shard endpoints so each client always lands on the same ingest thread
+  if(shards == 0) return;
+  if(z_shard_base.size() == 0) z_shard_base = z_frontend_addr;
+  std::stringstream id;
+  id << header_tag << ":" << ::getpid() << ":" << (void*)this;
+  const std::string key = id.str();
+  uint64_t hash = 14695981039346656037ULL;
+  for(char c : key){
+    hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+  }
+  const std::string addr = logger_shard_addr(z_shard_base, hash % shards);
+  if(addr == z_frontend_addr) return;
+  shutdown_network();
+  z_connected = false;
+  z_frontend_addr = addr;
+  if(enabled && !use_cout && !a_running) setup_network();
+}
+std::string logger_shard_addr(const std::string &base, uint32_t idx){
+  if(base.compare(0, 6, "tcp://") == 0){
+    size_t colon = base.rfind(':');
+    if(colon != std::string::npos && colon > 5){
+      uint32_t port = std::stoul(base.substr(colon + 1));
+      return base.substr(0, colon + 1) + std::to_string(port + idx);
+    }
+  }
+  return base + "-" + std::to_string(idx);
+}
 void logger_client::flush(){
   // Take the payload structs out of the holder and push the string
   // serialization over the frontend_socket
@@ -277,30 +318,84 @@ std::string logger_client::debug_me(double &ts){
   ts = last_timestamp;
   return streamer.str();
 }
+static bool log_record_later(const log_record &a, const log_record &b){
+  return a.timestamp > b.timestamp;// makes std::*_heap a min-heap
+}
 void logger_server::debug_me(std::string line,double &ts){
-  payload p = {ts,CHAR,line.size(),(void*)line.c_str()};
-  size_t len;
-  void *s = nullptr;
-  uint rc;
-  if((rc = serialize_payload(&s, &len, p))){
-    // return rc;
-  }
-  std::string buf((char*)s,len);
-  holder.push(buf);
+  // local records live in the extra inbox past the workers'
+  log_frame *frame = take_frame(z_workers);
+  frame->msg = zmq::message_t(line.data(), line.size());
+  std::unique_lock<std::mutex> w_lock(inboxes[z_workers].lock);
+  frame->refs++;
+  inboxes[z_workers].records.push_back({ts, CHAR, (const char*)frame->msg.data(), line.size(), frame});
+  inboxes[z_workers].ingested++;
 }
 uint8_t logger_client::commit(payload_t t){
   if(!enabled || use_cout) return 0;
+  if(a_running){
+    // never block the caller: format straight into the next free slot of
+    // the queue, nothing is allocated, or count a drop
+    logger::async_slot *slot = a_queue->claim();
+    if(slot == nullptr){
+      a_dropped++;
+      streamer.str(std::string());
+      streamer.clear();
+      return 1;
+    }
+    uint16_t itemsize = get_payload_itemsize(t);
+    size_t room = sizeof(slot->data) - sizeof(payload_header);
+    room -= room % itemsize;
+    std::streambuf *sb = streamer.rdbuf();
+    size_t bytes = (size_t)sb->sgetn(slot->data + sizeof(payload_header), room);
+    if(sb->sgetc() != std::char_traits<char>::eof()) a_truncated++;
+    bytes -= bytes % itemsize;
+    write_payload_header(slot->data, t, last_timestamp, bytes/itemsize);
+    slot->bytes = sizeof(payload_header) + bytes;
+    a_queue->publish();
+    streamer.str(std::string());
+    streamer.clear();
+    return 0;
+  }
   std::string line = streamer.str();
-  payload p = {last_timestamp,t,line.size(),(void*)line.c_str()};
-  size_t len;
-  void *s = nullptr;
-  uint rc;
-  if((rc = serialize_payload(&s, &len, p))){
-    return rc;
-  }
-  // std::string buf((char*)s,len);
+  streamer.str(std::string());
+  streamer.clear();
+  uint64_t length = line.size()/get_payload_itemsize(t);
   ///// SEND TO SERVER HERE
-  zmq::message_t z_msg(s,len);
+  // header frame, then the body frame which zmq takes over without a copy
+  payload_header hdr;
+  write_payload_header(&hdr, t, last_timestamp, length,
+      (line.size()) ? PAYLOAD_BODY_NEXT_FRAME : 0);
+  zmq::message_t z_head(&hdr, sizeof(hdr));
+  if(line.size() == 0) return send_frames(z_head, nullptr);
+  std::string *body = new std::string(std::move(line));
+  zmq::message_t z_body((void*)body->data(), body->size(),
+      [](void *, void *hint){ delete (std::string*)hint; }, body);
+  return send_frames(z_head, &z_body);
+}
+uint8_t logger_client::emit(const log_event &e){
+  // no formatting on this side, the server pretty prints events
+  if(!enabled || use_cout) return 0;
+  auto now = std::chrono::high_resolution_clock::now();
+  auto micro = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
+  if(a_running){
+    logger::async_slot *slot = a_queue->claim();
+    if(slot == nullptr){
+      a_dropped++;
+      return 1;
+    }
+    write_payload_header(slot->data, EVENT, micro.count()/1e6, 1);
+    memcpy(slot->data + sizeof(payload_header), &e, sizeof(log_event));
+    slot->bytes = sizeof(payload_header) + sizeof(log_event);
+    a_queue->publish();
+    return 0;
+  }
+  char record[sizeof(payload_header) + sizeof(log_event)];
+  write_payload_header(record, EVENT, micro.count()/1e6, 1);
+  memcpy(record + sizeof(payload_header), &e, sizeof(log_event));
+  zmq::message_t z_msg(record, sizeof(record));
+  return send_frames(z_msg, nullptr);
+}
+uint8_t logger_client::send_frames(zmq::message_t &head, zmq::message_t *body){
   zmq::message_t r_msg;
 
   zmq::pollitem_t z_items[] = {{z_frontend_socket,0,ZMQ_POLLIN | ZMQ_POLLOUT,0}};
@@ -329,17 +424,19 @@ uint8_t logger_client::commit(payload_t t){
     z_connected = false;
     setup_network();
     if(!z_connected){//failed to reconnect
-      streamer.str(std::string());
-      streamer.clear();
       return 1;
     }
   }
   try{
-    z_frontend_socket.send(z_msg);
+    if(body != nullptr){
+      z_frontend_socket.send(head, ZMQ_SNDMORE);
+      z_frontend_socket.send(*body);
+    }
+    else{
+      z_frontend_socket.send(head);
+    }
   }
   catch(const zmq::error_t &ex){
-    streamer.str(std::string());
-    streamer.clear();
     return 1;
   }
   try{
@@ -348,17 +445,83 @@ uint8_t logger_client::commit(payload_t t){
       z_frontend_socket.recv(&r_msg);//should probably confirm good msg, but eh.
   }
   catch(const zmq::error_t &ex){
-    streamer.str(std::string());
-    streamer.clear();
     return 1;
   }
   /////
-  reset_payload(p,0);
-  streamer.str(std::string());
-  streamer.clear();
   return 0;
 }
 
+uint8_t logger_client::enable_async(size_t queue_len, size_t batch){
+  if(a_running) return 0;
+  if(queue_len == 0 || batch == 0) return 1;
+  a_queue.reset(new logger::spsc_queue<logger::async_slot>(queue_len));
+  a_batch = batch;
+  a_running = true;
+  enabled = 1;
+  use_cout = 0;
+  a_thread = std::thread(&logger_client::async_sender, this);
+  return 0;
+}
+void logger_client::disable_async(){
+  // stop taking records, let the sender drain what is queued, then join
+  if(!a_running) return;
+  a_running = false;
+  if(a_thread.joinable()) a_thread.join();
+}
+void logger_client::async_sender(){
+  // owns its own context and DEALER socket; each batch goes out as
+  // [empty, records...] with the records packed back to back in one frame,
+  // so the server's REP workers see one request carrying all of them
+  zmq::context_t a_context;
+  zmq::socket_t a_socket(a_context, ZMQ_DEALER);
+  int timeout = 100;
+  a_socket.setsockopt(ZMQ_LINGER, &timeout, sizeof(timeout));
+  a_socket.connect(z_frontend_addr);
+  zmq::message_t reply;
+  logger::async_slot *slot;
+  while(true){
+    bool running = a_running.load(std::memory_order_acquire);
+    std::string *batch = nullptr;
+    size_t count = 0;
+    while(count < a_batch && (slot = a_queue->front()) != nullptr){
+      if(batch == nullptr){
+        batch = new std::string();
+        batch->reserve(a_batch*sizeof(slot->data));
+      }
+      batch->append(slot->data, slot->bytes);
+      a_queue->drop();
+      count++;
+    }
+    if(count){
+      try{
+        zmq::message_t delimiter;
+        if(!a_socket.send(delimiter, ZMQ_SNDMORE | ZMQ_DONTWAIT)){
+          a_dropped += count;// server not keeping up, shed the batch
+          delete batch;
+        }
+        else{
+          zmq::message_t z_msg((void*)batch->data(), batch->size(),
+              [](void *, void *hint){ delete (std::string*)hint; }, batch);
+          a_socket.send(z_msg);
+          a_sent += count;
+        }
+      }
+      catch(const zmq::error_t &ex){
+        a_dropped += count;
+      }
+    }
+    try{
+      while(a_socket.recv(&reply, ZMQ_DONTWAIT)){}// acks are not needed, just drained
+    }
+    catch(const zmq::error_t &ex){}
+    if(count == 0){
+      if(!running) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  a_socket.close();
+  a_context.close();
+}
 
 logger_server::logger_server()
   : tag(std::string()),
@@ -378,7 +541,7 @@ logger_server::logger_server()
   setup_network();
   log_c = new logger_client("",z_frontend_addr);
 }
-logger_server::logger_server(std::string tag, std::ostream &s, std::string frontend_addr, std::string backend_addr)
+logger_server::logger_server(std::string tag, std::ostream &s, std::string frontend_addr, std::string backend_addr, uint8_t shards)
   : tag(tag),dumper(s),
     z_frontend_addr(frontend_addr),
     z_backend_addr(backend_addr),
@@ -398,8 +561,21 @@ logger_server::logger_server(std::string tag, std::ostream &s, std::string front
     z_backend_addr = "tcp://127.0.1.1:40000";
   }
   _init_defaults();
+  if(shards){
+    z_shards = shards;
+    z_workers = shards;
+    z_sockets = std::vector<zmq::socket_t>(z_workers);
+    inboxes.reset(new worker_inbox[z_workers + 1]);
+    for(uint8_t idx = 0; idx < z_shards; idx++){
+      this->shards.emplace_back(new shard_queues(1 << 16));
+    }
+  }
   setup_network();
-  log_c = new logger_client("",z_frontend_addr);
+  log_c = new logger_client("",z_frontend_addr, !shards);
+  if(shards){
+    log_c->set_shards(shards);
+    log_c->connect();
+  }
 }
 logger_server::~logger_server()
 {
@@ -433,7 +609,13 @@ logger_server::~logger_server()
 
 void logger_server::_init_defaults(){
   z_workers = 20;
+  z_shards = 0;
   z_sockets = std::vector<zmq::socket_t>(z_workers);
+  inboxes.reset(new worker_inbox[z_workers + 1]);
+  for(uint8_t idx = 0; idx <= z_workers; idx++) inboxes[idx].ingested = 0;
+  written = 0;
+  reorder_window = 0;
+  sink = nullptr;
 }
 
 std::ostream& operator<<(logger_server &log, char * const &t){
@@ -448,35 +630,80 @@ std::ostream& operator<<(logger_server &log, const logger::level_t &t){
   if(log.log_c == nullptr) return log.null_stream;
   return (*(log.log_c) << t);
 }
-void logger_server::sort_holder(){// not thread safe
-  // if (holder.size() <= 1) return;
-  std::vector<payload> sortee(holder.size());
-  size_t index = 0;
-  size_t l;
-  while(holder.empty() == false){
-    const std::string str = holder.front();
-    const char *s = str.c_str();
-    l = str.size();
-    deserialize_payload(&sortee[index++], (void**)&s, l);
-    holder.pop();
+void logger_server::merge_inboxes(){// not thread safe, hold q_mutex
+  // O(new records * log(held records)); records are moved, never reparsed
+  for(uint8_t idx = 0; idx <= z_workers; idx++){
+    std::unique_lock<std::mutex> w_lock(inboxes[idx].lock);
+    incoming.swap(inboxes[idx].records);// hands back last round's capacity
+    w_lock.unlock();
+    for(auto &r : incoming){
+      heap.push_back(r);
+      std::push_heap(heap.begin(), heap.end(), log_record_later);
+    }
+    incoming.clear();
   }
-
-  std::sort(sortee.begin(), sortee.end(),
-          [](payload a, payload b){ return a.timestamp < b.timestamp; });
-  
-  
-  void *c = nullptr;
-  l = 0;
-  for(index = 0; index < sortee.size(); index++){
-    serialize_payload(&c, &l, sortee[index]);
-    std::string s((char*)c,l);
-    holder.push(s);
-    free(c);
-    c = nullptr;
-    l = 0;
+  log_record r;
+  for(auto &shard : shards){
+    while(shard->records.pop(r)){
+      heap.push_back(r);
+      std::push_heap(heap.begin(), heap.end(), log_record_later);
+    }
+    // blocked is set under drain_lock, so a shard that saw the queue full
+    // is either waiting by now or sees it drained before it waits
+    if(shard->blocked){
+      std::lock_guard<std::mutex> d_lock(shard->drain_lock);
+      shard->drained.notify_one();
+    }
   }
 }
+log_frame* logger_server::take_frame(uint8_t rank){
+  std::unique_lock<std::mutex> w_lock(inboxes[rank].lock);
+  worker_inbox &inbox = inboxes[rank];
+  if(inbox.spare.empty()){
+    inbox.frames.emplace_back(new log_frame());
+    inbox.frames.back()->refs = 0;
+    inbox.frames.back()->owner = rank;
+    return inbox.frames.back().get();
+  }
+  log_frame *frame = inbox.spare.back();
+  inbox.spare.pop_back();
+  return frame;
+}
+void logger_server::release_frames(){// not thread safe, hold q_mutex
+  // shard frames go back over their queue, those that do not fit stay in
+  // released and are offered again by the next flush; the rest go back to
+  // their inbox pools, one lock per pool
+  size_t kept = 0;
+  if(z_shards){
+    std::vector<log_frame*> pooled;
+    for(size_t idx = 0; idx < released.size(); idx++){
+      log_frame *f = released[idx];
+      if(f->owner >= z_shards) pooled.push_back(f);
+      else if(!shards[f->owner]->returns.push(std::move(f))) released[kept++] = released[idx];
+    }
+    released.resize(kept);
+    released.insert(released.end(), pooled.begin(), pooled.end());
+  }
+  std::sort(released.begin() + kept, released.end(),
+          [](log_frame *a, log_frame *b){ return a->owner < b->owner; });
+  size_t idx = kept;
+  while(idx < released.size()){
+    uint8_t owner = released[idx]->owner;
+    std::unique_lock<std::mutex> w_lock(inboxes[owner].lock);
+    for(; idx < released.size() && released[idx]->owner == owner; idx++){
+      inboxes[owner].spare.push_back(released[idx]);
+    }
+  }
+  released.resize(kept);
+}
 void logger_server::setup_network(){
+  if(z_shards){
+    z_running = true;
+    for(uint8_t idx = 0; idx < z_shards; idx++){
+      z_threads.emplace_back(&logger_server::shard_worker, this, idx);
+    }
+    return;
+  }
   int timeout = 100;
   z_frontend.setsockopt(ZMQ_LINGER, &timeout, sizeof(timeout));
   z_backend.setsockopt(ZMQ_LINGER, &timeout, sizeof(timeout));
@@ -548,8 +775,7 @@ void logger_server::enqueue_worker(uint8_t rank){
   zmq::pollitem_t z_poll_items[] = {{z_sockets[rank], 0, ZMQ_POLLIN, 0}};
   int more;
   size_t more_size = sizeof(more);
-  std::string buf;
-  payload p;
+  std::vector<log_frame*> parts;
   while(z_running){
     try{
       zmq::poll(z_poll_items, 1, 100);
@@ -571,20 +797,32 @@ void logger_server::enqueue_worker(uint8_t rank){
       z_sockets[rank] = zmq::socket_t(local_context, ZMQ_REP);
       z_sockets[rank].setsockopt(ZMQ_LINGER, &timeout, sizeof(timeout));
       z_sockets[rank].connect(z_backend_addr);
+      std::unique_lock<std::mutex> w_lock(inboxes[rank].lock);
+      inboxes[rank].spare.insert(inboxes[rank].spare.end(), parts.begin(), parts.end());
+      parts.clear();
       continue;
     }
     if(z_poll_items[0].revents & ZMQ_POLLIN){
-      zmq::message_t z_message;// cleaned up when out of scope
-      z_sockets[rank].recv(&z_message);
+      // receive straight into a pooled frame, records are views into it
+      log_frame *frame = take_frame(rank);
+      z_sockets[rank].recv(&frame->msg);
       z_sockets[rank].getsockopt(ZMQ_RCVMORE, &more, &more_size);
       // std::cout << "worker: b->w m(" << more <<")\n";
-      buf += z_message.to_string();
+      parts.push_back(frame);
       if(!more){
-        // full message is done. So enqueue
+        // full message is done. A frame holds one or more inline records,
+        // or a header whose body is the next frame. So enqueue
         zmq::message_t z_msg;
-        const char *c = buf.c_str();
-        size_t len = buf.size();
-        if(!deserialize_payload(&p,(void**)&c,len)){
+        std::unique_lock<std::mutex> w_lock(inboxes[rank].lock);
+        worker_inbox &inbox = inboxes[rank];
+        size_t before = inbox.records.size();
+        uint8_t all_good = parse_frames(parts.data(), parts.size(), inbox.records);
+        inbox.ingested += inbox.records.size() - before;
+        for(auto f : parts){
+          if(f->refs == 0) inbox.spare.push_back(f);
+        }
+        w_lock.unlock();
+        if(all_good){
           z_msg = zmq::message_t("good",5);
         }
         else{
@@ -592,12 +830,8 @@ void logger_server::enqueue_worker(uint8_t rank){
         }
         z_sockets[rank].send(z_msg);
         // std::cout << "worker: w->b\n";
-        std::unique_lock<std::mutex> p_lock(q_mutex);
-        holder.push(buf);
         q_event.notify_all();
-        p_lock.unlock();
-        reset_payload(p,0);
-        buf = std::string();
+        parts.clear();
       }
     }
   }
@@ -608,6 +842,127 @@ void logger_server::enqueue_worker(uint8_t rank){
   z_sockets[rank].close();
   local_context.close();
 }
+uint8_t logger_server::parse_frames(log_frame **parts, size_t count, std::vector<log_record> &out){
+  // A frame holds one or more inline records, or a header whose body is
+  // the next frame. Frame refs are final before the caller publishes out.
+  uint8_t all_good = 1;
+  payload_view v;
+  for(size_t idx = 0; idx < count; idx++){
+    const char *buf = (const char*)parts[idx]->msg.data();
+    size_t len = parts[idx]->msg.size();
+    size_t off = 0, used;
+    while(off < len){
+      if(read_payload_view(&v, buf + off, len - off, &used)){
+        all_good = 0;
+        break;
+      }
+      off += used;
+      log_frame *holder = parts[idx];
+      const char *body = (const char*)v.body;
+      size_t bytes = get_payload_itemsize(v.type)*v.length;
+      if(v.flags & PAYLOAD_BODY_NEXT_FRAME){
+        if(off != len || idx + 1 >= count || parts[idx+1]->msg.size() != bytes){
+          all_good = 0;
+          break;
+        }
+        holder = parts[++idx];
+        body = (const char*)holder->msg.data();
+      }
+      holder->refs++;
+      out.push_back({v.timestamp, v.type, body, bytes, holder});
+    }
+  }
+  return all_good;
+}
+void logger_server::shard_worker(uint8_t rank){
+  // One ingest shard: owns a ROUTER on its own endpoint and talks to
+  // flush() only through its two lock-free queues
+  zmq::context_t local_context;
+  int timeout = 100;
+  z_sockets[rank] = zmq::socket_t(local_context, ZMQ_ROUTER);
+  z_sockets[rank].setsockopt(ZMQ_LINGER, &timeout, sizeof(timeout));
+  z_sockets[rank].bind(logger_shard_addr(z_frontend_addr, rank));
+
+  shard_queues &q = *shards[rank];
+  zmq::pollitem_t z_poll_items[] = {{z_sockets[rank], 0, ZMQ_POLLIN, 0}};
+  int more;
+  size_t more_size = sizeof(more);
+  std::vector<log_frame*> parts;
+  std::vector<log_frame*> spare;
+  std::vector<log_record> parsed;
+  log_frame *frame = nullptr;
+  while(z_running){
+    try{
+      zmq::poll(z_poll_items, 1, 100);
+    }
+    catch (zmq::error_t &ex){
+      if(ex.num() != EINTR) throw;
+      continue;
+    }
+    if(!(z_poll_items[0].revents & ZMQ_POLLIN)) continue;
+    while(z_running){// drain whatever is ready
+      if(frame == nullptr){
+        if(!spare.empty()){
+          frame = spare.back();
+          spare.pop_back();
+        }
+        else if(!q.returns.pop(frame)){
+          q.frames.emplace_back(new log_frame());
+          frame = q.frames.back().get();
+          frame->refs = 0;
+          frame->owner = rank;
+        }
+      }
+      if(!z_sockets[rank].recv(&frame->msg, ZMQ_DONTWAIT)) break;
+      z_sockets[rank].getsockopt(ZMQ_RCVMORE, &more, &more_size);
+      parts.push_back(frame);
+      frame = nullptr;
+      if(more) continue;
+      // [client id, empty, records...]
+      uint8_t all_good = 0;
+      parsed.clear();
+      if(parts.size() > 2){
+        all_good = parse_frames(&parts[2], parts.size() - 2, parsed);
+      }
+      // frames nothing points into are ours to reuse (the client id is only
+      // read by the reply below, in this thread); decide before publishing,
+      // after that flush() may drop refs and return the rest
+      for(auto f : parts){
+        if(f->refs == 0) spare.push_back(f);
+      }
+      // counted before they are published, so flush() never gets ahead
+      q.ingested.store(q.ingested.load(std::memory_order_relaxed) + parsed.size(),
+                       std::memory_order_release);
+      for(auto &r : parsed){
+        while(!q.records.push(std::move(r)) && z_running){
+          // flush() is behind: sleep until it drains the queue, the client
+          // waits on its reply meanwhile
+          std::unique_lock<std::mutex> d_lock(q.drain_lock);
+          q.blocked = true;
+          q.drained.wait_for(d_lock, std::chrono::milliseconds(100),
+              [&]{ return q.records.size() < q.records.capacity() || !z_running; });
+          q.blocked = false;
+        }
+      }
+      if(parts.size() >= 2){
+        zmq::message_t z_id(parts[0]->msg.data(), parts[0]->msg.size());
+        zmq::message_t z_empty;
+        zmq::message_t z_msg = (all_good) ? zmq::message_t("good",5) : zmq::message_t("bad",4);
+        try{
+          z_sockets[rank].send(z_id, ZMQ_SNDMORE);
+          z_sockets[rank].send(z_empty, ZMQ_SNDMORE);
+          z_sockets[rank].send(z_msg);
+        }
+        catch(const zmq::error_t &ex){}
+      }
+      parts.clear();
+      if(parsed.size()) q_event.notify_all();
+    }
+  }
+  if(frame != nullptr) spare.push_back(frame);
+  z_sockets[rank].close();
+  local_context.close();
+}
 void logger_server::stop(){
   uint8_t shutdown = (z_running == true);
   z_running = false;
@@ -620,23 +975,66 @@ void logger_server::wait(){
   if (z_broker_thread.joinable()) z_broker_thread.join();
 }
 void logger_server::flush(){
-  // Take the payload structs out of the holder and push the string
-  // to the dumper. Likely want a mutex with this and enque_worker()
+  auto now = std::chrono::high_resolution_clock::now();
+  auto micro = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
+  flush(micro.count()/1e6 - reorder_window);
+}
+void logger_server::flush(double watermark){
+  // Pull the new records out of the worker inboxes and push everything
+  // stamped at or before the watermark to the dumper, oldest first. Newer
+  // records stay held so a slower client can still slot in ahead of them.
   std::unique_lock<std::mutex> p_lock(q_mutex);
-  sort_holder();
-  size_t len;
-  payload p;
-  while(holder.empty() == false){
-    const std::string line = holder.front();
-    len = line.size();
-    const char *s = line.c_str();
-    deserialize_payload(&p, (void**)&s, len);
-    const std::string log((char*)p.buffer,p.length);
-    dumper << log << std::flush;
-    holder.pop();
+  merge_inboxes();
+  uint64_t count = 0;
+  while(heap.empty() == false && heap.front().timestamp <= watermark){
+    std::pop_heap(heap.begin(), heap.end(), log_record_later);
+    log_record &r = heap.back();
+    if(r.type == EVENT) write_events(r);
+    else if(sink != nullptr) log_sink_write(sink, r.body, r.bytes);
+    else dumper.write(r.body, r.bytes);
+    if(--(r.frame->refs) == 0) released.push_back(r.frame);
+    heap.pop_back();
+    count++;
   }
+  written += count;
+  if(sink == nullptr) dumper << std::flush;
+  release_frames();
   p_lock.unlock();
 }
+bool logger_server::empty(){
+  // written first: ingested only grows and never trails written, so equal
+  // sums mean nothing was pending when written was read
+  uint64_t flushed = written.load();
+  uint64_t ingested = 0;
+  for(uint8_t idx = 0; idx <= z_workers; idx++) ingested += inboxes[idx].ingested.load();
+  for(auto &shard : shards) ingested += shard->ingested.load(std::memory_order_acquire);
+  return ingested == flushed;
+}
+void logger_server::write_events(const log_record &r){
+  log_event e;
+  for(size_t off = 0; off + sizeof(log_event) <= r.bytes; off += sizeof(log_event)){
+    memcpy(&e, r.body + off, sizeof(log_event));// body may not be aligned
+    if(sink == nullptr){
+      print_event(dumper, r.timestamp, e, event_names);
+      continue;
+    }
+    event_text.str(std::string());
+    print_event(event_text, r.timestamp, e, event_names);
+    const std::string line = event_text.str();
+    log_sink_write(sink, line.data(), line.size());
+  }
+}
+void logger_server::set_sink(log_sink s){
+  std::unique_lock<std::mutex> p_lock(q_mutex);
+  sink = s;
+}
+void logger_server::name_event(uint32_t id, std::string name){
+  std::unique_lock<std::mutex> p_lock(q_mutex);
+  event_names[id] = name;
+}
+void logger_server::flush_all(){
+  flush(std::numeric_limits<double>::infinity());
+}
 uint8_t logger_server::commit(payload_t t){
   if(log_c == nullptr) return 1;
   return log_c->commit(t);
@@ -688,6 +1086,9 @@ uint16_t get_payload_itemsize(payload_t &type){
     case WCHAR:
       scale = sizeof(wchar_t);
       break;
+    case EVENT:
+      scale = sizeof(log_event);
+      break;
     default:
       scale = 1;
       break;
@@ -696,13 +1097,64 @@ uint16_t get_payload_itemsize(payload_t &type){
 }
 
 size_t get_sizeof_payload(payload &p){
-  size_t size = sizeof(serial_key) + sizeof(double) + sizeof(payload_t)
-            + sizeof(uint64_t);
+  size_t size = sizeof(payload_header);
   size_t scale = get_payload_itemsize(p.type);
   size += p.length*scale;
   return size;
 }
 
+size_t write_payload_header(void *s, payload_t type, double timestamp, uint64_t length, uint8_t flags){
+  payload_header h;
+  memcpy(h.key, serial_key, sizeof(h.key));
+  h.version = PAYLOAD_WIRE_VERSION;
+  h.type = type;
+  h.flags = flags;
+  h.timestamp = timestamp;
+  h.length = length;
+  memcpy(s, &h, sizeof(h));
+  return sizeof(h);
+}
+uint8_t read_payload_view(payload_view *v, const void *s, size_t l, size_t *used){
+  if(v == nullptr || s == nullptr) return 2U;
+  if(l < sizeof(payload_header)) return 2U;
+  const char *buf = (const char*)s;
+  if(memcmp(buf, serial_key, sizeof(payload_header::key))) return 1U;
+  uint8_t pd;
+  if(buf[5] == serial_key[5]){
+    // version 1: "wfgen:\0", timestamp, u8 type, u64 length, body
+    if(buf[6] != '\0') return 1U;
+    memcpy(&(v->timestamp), buf + 7, sizeof(double));
+    memcpy(&pd, buf + 15, sizeof(uint8_t));
+    memcpy(&(v->length), buf + 16, sizeof(uint64_t));
+    v->flags = 0;
+  }
+  else if(buf[5] == PAYLOAD_WIRE_VERSION){
+    payload_header h;
+    memcpy(&h, buf, sizeof(h));// fixed size, the body is not touched
+    v->timestamp = h.timestamp;
+    pd = h.type;
+    v->length = h.length;
+    v->flags = h.flags;
+  }
+  else{
+    return 1U;// unknown version
+  }
+  if(pd > EVENT) return 1U;
+  v->type = static_cast<payload_t>(pd);
+  size_t bytes = get_payload_itemsize(v->type)*v->length;
+  size_t total = sizeof(payload_header);
+  if(v->flags & PAYLOAD_BODY_NEXT_FRAME){
+    v->body = nullptr;
+  }
+  else{
+    if(v->length > l || bytes > l - sizeof(payload_header)) return 2U;// truncated
+    v->body = buf + sizeof(payload_header);
+    total += bytes;
+  }
+  if(used != nullptr) *used = total;
+  return 0U;
+}
+
 uint8_t serialize_payload(void **s, size_t *l, payload &p){
   if(s == nullptr){
     return 3U;
@@ -719,58 +1171,69 @@ uint8_t serialize_payload(void **s, size_t *l, payload &p){
   }
   uint8_t *buf = (uint8_t*)(*s);
   size_t scale = get_payload_itemsize(p.type);
-  memcpy(buf, serial_key, sizeof(serial_key));
-  buf += sizeof(serial_key);
-  memcpy(buf, &p.timestamp, sizeof(double));
-  buf += sizeof(double);
-  uint8_t pd = p.type;
-  memcpy(buf, &pd, sizeof(uint8_t));
-  buf += sizeof(uint8_t);
-  memcpy(buf, &p.length, sizeof(uint64_t));
-  buf += sizeof(uint64_t);
+  buf += write_payload_header(buf, p.type, p.timestamp, p.length);
   memcpy(buf, p.buffer, scale*p.length);
   return 0U;
 }
 uint8_t deserialize_payload(payload *p, void **s, size_t &l){
-  uint8_t good_start = 1;
-  if(s == nullptr){
-    good_start = 0;
-  }
-  else if(*s == nullptr){
-    good_start = 0;
-  }
-  if (l < sizeof(serial_key)){
-    good_start = 0;
-  }
-  if (!good_start) return 2U;
-  char *buf = (char*)(*s);
-  // std::cout << "--large scale checks seem good\n";
-  for(size_t idx = 0; idx < sizeof(serial_key); idx++){
-    if(serial_key[idx] != buf[idx]) good_start = 0;
-  }
-  if (!good_start) return 1U;
-  // std::cout << "--the expected key is there\n";
+  // copying wrapper around read_payload_view(), the body is malloc'd
+  if(s == nullptr) return 2U;
+  payload_view v;
+  uint8_t rc = read_payload_view(&v, *s, l, nullptr);
+  if(rc) return rc;
+  if(v.body == nullptr) return 2U;// body is in another frame
   if(p == nullptr){
     p = (payload *)malloc(sizeof(payload));
   }
   else{
     reset_payload(*p);
   }
-  buf += sizeof(serial_key);
-  memcpy(&(p->timestamp), buf, sizeof(double));
-  buf += sizeof(double);
-  uint8_t pd;
-  memcpy(&pd, buf, sizeof(uint8_t));
-  p->type = static_cast<payload_t>(pd);
-  buf += sizeof(uint8_t);
-  memcpy(&(p->length), buf, sizeof(uint64_t));
-  buf += sizeof(uint64_t);
+  p->timestamp = v.timestamp;
+  p->type = v.type;
+  p->length = v.length;
   size_t scale = get_payload_itemsize(p->type);
   p->buffer = malloc(scale*p->length);
-  memcpy((p->buffer), buf, scale*p->length);
+  memcpy((p->buffer), v.body, scale*p->length);
   return 0U;
 }
 
+uint8_t log_event_add(log_event &e, int64_t v){
+  if(e.count >= LOG_EVENT_MAX_FIELDS) return 1;
+  e.kinds[e.count] = EVENT_I64;
+  e.values[e.count++].i = v;
+  return 0;
+}
+uint8_t log_event_add(log_event &e, uint64_t v){
+  if(e.count >= LOG_EVENT_MAX_FIELDS) return 1;
+  e.kinds[e.count] = EVENT_U64;
+  e.values[e.count++].u = v;
+  return 0;
+}
+uint8_t log_event_add(log_event &e, double v){
+  if(e.count >= LOG_EVENT_MAX_FIELDS) return 1;
+  e.kinds[e.count] = EVENT_F64;
+  e.values[e.count++].f = v;
+  return 0;
+}
+void print_event(std::ostream &os, double timestamp, const log_event &e,
+                 const std::map<uint32_t, std::string> &names){
+  auto name = names.find(e.id);
+  os << "[ " << std::fixed << std::setprecision(6) << timestamp << " ] EVENT - ";
+  if(name != names.end()) os << name->second;
+  else os << "event_" << e.id;
+  uint8_t count = (e.count < LOG_EVENT_MAX_FIELDS) ? e.count : LOG_EVENT_MAX_FIELDS;
+  for(uint8_t idx = 0; idx < count; idx++){
+    os << ((idx) ? ", " : " : ");
+    switch(e.kinds[idx]){
+      case EVENT_I64: os << e.values[idx].i; break;
+      case EVENT_U64: os << e.values[idx].u; break;
+      case EVENT_F64: os << std::defaultfloat << std::setprecision(9) << e.values[idx].f; break;
+      default: os << "?"; break;
+    }
+  }
+  os << std::defaultfloat << "\n";
+}
+
 void destroy_payload(payload **p){
   if(p==nullptr) return;
   if(*p==nullptr) return;
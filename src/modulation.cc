@@ -3,8 +3,9 @@
 #include <iostream>
 #endif
 #include "modulation.hh"
+#include "name_hash.hh"
 
-const struct signal_modulation_s signal_modulation_list[SIGNAL_MODULATION_LIST_LEN] =
+WFGEN_CONSTEXPR const struct signal_modulation_s signal_modulation_list[SIGNAL_MODULATION_LIST_LEN] =
 {
   // name_label      family_label        scheme
     {"ask",          "ask",              LIQUID_MODEM_UNKNOWN,   LIQUID_FSK_UNKNOWN,     LIQUID_ANALOG_UNKNOWN,      LIQUID_NOISE_UNKNOWN},
@@ -90,16 +91,53 @@ const struct signal_modulation_s signal_modulation_list[SIGNAL_MODULATION_LIST_L
 };
 
 #ifdef __cplusplus
+// name and scheme lookups over the list, laid out at compile time
+static constexpr auto signal_modulation_label_table =
+    name_hash::make_table<1024>(signal_modulation_list, &signal_modulation_s::name_label);
+static constexpr auto signal_modulation_ms_index =
+    name_hash::make_scheme_index<LIQUID_MODEM_NUM_SCHEMES>(signal_modulation_list,
+        &signal_modulation_s::scheme, LIQUID_MODEM_UNKNOWN, SIGNAL_MODULATION_LIST_LEN-1);
+static constexpr auto signal_modulation_msf_index =
+    name_hash::make_scheme_index<FSK_TYPE_COUNT>(signal_modulation_list,
+        &signal_modulation_s::f_scheme, LIQUID_FSK_UNKNOWN, SIGNAL_MODULATION_LIST_LEN-1);
+static constexpr auto signal_modulation_msa_index =
+    name_hash::make_scheme_index<ANALOG_TYPE_COUNT>(signal_modulation_list,
+        &signal_modulation_s::a_scheme, LIQUID_ANALOG_UNKNOWN, SIGNAL_MODULATION_LIST_LEN-1);
+static constexpr auto signal_modulation_msn_index =
+    name_hash::make_scheme_index<LIQUID_NOISE_AWGN+1>(signal_modulation_list,
+        &signal_modulation_s::n_scheme, LIQUID_NOISE_UNKNOWN, SIGNAL_MODULATION_LIST_LEN-1);
+
 // get index of above map given label name as input
 unsigned int signal_modulation_map_label_to_index(std::string _name_label)
 {
-    for (uint8_t i=0U; i<SIGNAL_MODULATION_LIST_LEN; i++) {
-        if (strcmp(_name_label.c_str(), signal_modulation_list[i].name_label)==0)
-            return i;
-    }
-    return SIGNAL_MODULATION_LIST_LEN-1; // unknown
+    int i = signal_modulation_label_table.find(_name_label.c_str());
+    return (i >= 0) ? (unsigned int)i : SIGNAL_MODULATION_LIST_LEN-1; // unknown
 }
-#endif
+
+// get index of above map given modulation type as input
+unsigned int signal_modulation_map_ms_to_index(modulation_scheme _ms)
+{
+    return signal_modulation_ms_index.find(_ms, SIGNAL_MODULATION_LIST_LEN-1);
+}
+
+// get index of above map given modulation type as input
+unsigned int signal_modulation_map_msf_to_index(fsk_scheme _ms)
+{
+    return signal_modulation_msf_index.find(_ms, SIGNAL_MODULATION_LIST_LEN-1);
+}
+
+// get index of above map given modulation type as input
+unsigned int signal_modulation_map_msa_to_index(analog_scheme _ms)
+{
+    return signal_modulation_msa_index.find(_ms, SIGNAL_MODULATION_LIST_LEN-1);
+}
+
+// get index of above map given modulation type as input
+unsigned int signal_modulation_map_msn_to_index(noise_scheme _ms)
+{
+    return signal_modulation_msn_index.find(_ms, SIGNAL_MODULATION_LIST_LEN-1);
+}
+#else
 
 // get index of above map given modulation type as input
 unsigned int signal_modulation_map_ms_to_index(modulation_scheme _ms)
@@ -144,4 +182,5 @@ unsigned int signal_modulation_map_msn_to_index(noise_scheme _ms)
     }
     return SIGNAL_MODULATION_LIST_LEN-1; // unknown
 }
+#endif
 
@@ -3,8 +3,9 @@
 #include <iostream>
 #endif
 #include "noisemodem.hh"
+#include "name_hash.hh"
 
-const struct noise_type_s noise_types[noise_type_count] = {
+WFGEN_CONSTEXPR const struct noise_type_s noise_types[noise_type_count] = {
     // name      fullname                         scheme          bps
 
     // unknown
@@ -15,6 +16,25 @@ const struct noise_type_s noise_types[noise_type_count] = {
     {"noise",    "additive white gaussian noise", LIQUID_NOISE_AWGN, 1}
 };
 
+#ifdef __cplusplus
+static constexpr auto noise_type_table = name_hash::make_table<16>(noise_types, &noise_type_s::name);
+#endif
+
+int noise_type_lookup(const char * _str)
+{
+#ifdef __cplusplus
+    return noise_type_table.find(_str);
+#else
+    // compare each string to short name
+    unsigned int i;
+    for (i=0; i<noise_type_count; i++) {
+        if (strcmp(_str,noise_types[i].name)==0)
+            return i;
+    }
+    return -1;
+#endif
+}
+
 #define liquid_error_config(format, ...) \
     liquid_error_config_nl(__FILE__, __LINE__, format, ##__VA_ARGS__);
 
@@ -174,6 +194,7 @@ symstreamrncf symstreamrncf_create_noise(int          _ftype,
     q->mod_scheme  = _ms;
     q->gain        = 1.0f;
     q->k           = 2;
+    q->seed        = 0;
 
     // modulator
     q->mod = noisemod_create(2, _bandwidth);
@@ -194,9 +215,9 @@ symstreamrncf symstreamrncf_create_noise(int          _ftype,
     q->arb_interp = msresamp_crcf_create(q->rate, 60.0f);
 
     // printf("Internal(Symbol) buffer length = %u\n",2);
-    unsigned int buf_len = 1 << liquid_nextpow2((unsigned int)ceilf(q->rate));
-    // printf("External(Sample) buffer length = %u\n",buf_len);
-    q->buf = (liquid_float_complex*) malloc(buf_len*sizeof(liquid_float_complex));
+    q->buf_len = 1 << liquid_nextpow2((unsigned int)ceilf(q->rate));
+    // printf("External(Sample) buffer length = %u\n",q->buf_len);
+    q->buf = (liquid_float_complex*) malloc(q->buf_len*sizeof(liquid_float_complex));
 
     // reset and return main object
     symstreamrncf_reset(q);
@@ -269,9 +290,110 @@ int symstreamrncf_set_scheme(symstreamrncf _q, int _ms){
     return LIQUID_OK;
 }
 
+int symstreamrncf_set_seed(symstreamrncf _q, uint32_t _seed){
+    _q->seed = _seed;
+    return LIQUID_OK;
+}
+
+// running state, each object a copy of the one in the stream
+struct symstreamrncf_state_s {
+    unsigned int    k;              // parameters of the stream, to check a restore against
+    unsigned int    m;
+    float           rate;
+    unsigned int    buf_len;
+    noisemod        mod;            // oscillator phase
+    firinterp_crcf  interp;
+    msresamp_crcf   arb_interp;
+    liquid_float_complex * buf_internal;    // [size: k x 1]
+    liquid_float_complex * buf;             // [size: buf_size x 1]
+    unsigned int    buf_internal_index;
+    unsigned int    buf_index;
+    unsigned int    buf_size;
+    uint32_t        seed;
+};
+
+symstreamrncf_state symstreamrncf_snapshot(symstreamrncf _q)
+{
+    if (_q == NULL)
+        return (symstreamrncf_state)liquid_error_config("symstreamrncf_snapshot(), object cannot be NULL");
+
+    symstreamrncf_state s = (symstreamrncf_state) malloc(sizeof(struct symstreamrncf_state_s));
+    s->k          = _q->k;
+    s->m          = _q->m;
+    s->rate       = _q->rate;
+    s->buf_len    = _q->buf_len;
+    s->mod        = noisemod_copy(_q->mod);
+    s->interp     = firinterp_crcf_copy(_q->interp);
+    s->arb_interp = msresamp_crcf_copy(_q->arb_interp);
+
+    s->buf_internal = (liquid_float_complex*) malloc(_q->k*sizeof(liquid_float_complex));
+    memmove(s->buf_internal, _q->buf_internal, _q->k*sizeof(liquid_float_complex));
+    s->buf = (liquid_float_complex*) malloc((_q->buf_size+1)*sizeof(liquid_float_complex));
+    memmove(s->buf, _q->buf, _q->buf_size*sizeof(liquid_float_complex));
+
+    s->buf_internal_index = _q->buf_internal_index;
+    s->buf_index          = _q->buf_index;
+    s->buf_size           = _q->buf_size;
+    s->seed               = _q->seed;
+    return s;
+}
+
+int symstreamrncf_restore(symstreamrncf _q, symstreamrncf_state _s)
+{
+    // the buffers and resampler are sized by these, so nothing else fits
+    if (_s->k != _q->k || _s->m != _q->m || _s->rate != _q->rate || _s->buf_len != _q->buf_len)
+        return fprintf(stderr,"symstreamrncf_restore(), snapshot is of a stream with other parameters\n");
+
+    // liquid objects cannot be overwritten in place, so take fresh copies
+    noisemod_destroy(_q->mod);
+    _q->mod = noisemod_copy(_s->mod);
+    firinterp_crcf_destroy(_q->interp);
+    _q->interp = firinterp_crcf_copy(_s->interp);
+    msresamp_crcf_destroy(_q->arb_interp);
+    _q->arb_interp = msresamp_crcf_copy(_s->arb_interp);
+
+    memmove(_q->buf_internal, _s->buf_internal, _s->k*sizeof(liquid_float_complex));
+    memmove(_q->buf, _s->buf, _s->buf_size*sizeof(liquid_float_complex));
+    _q->buf_internal_index = _s->buf_internal_index;
+    _q->buf_index          = _s->buf_index;
+    _q->buf_size           = _s->buf_size;
+    _q->seed               = _s->seed;
+    return LIQUID_OK;
+}
+
+int symstreamrncf_state_destroy(symstreamrncf_state _s)
+{
+    noisemod_destroy(_s->mod);
+    firinterp_crcf_destroy(_s->interp);
+    msresamp_crcf_destroy(_s->arb_interp);
+    free(_s->buf_internal);
+    free(_s->buf);
+    free(_s);
+    return LIQUID_OK;
+}
+
+// uniform in (0,1] from the object's own xorshift generator
+static float symstreamrncf_randf(symstreamrncf _q){
+    uint32_t x = _q->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    _q->seed = x;
+    return ((x >> 8) + 1)*(1.0f/16777216.0f);
+}
+
 unsigned int noisemod_modulate_rand_sym(symstreamrncf _q, liquid_float_complex *_y){
     // void cawgn(liquid_float_complex *_x, float _nstd);
-    noisemod_modulate(_q->mod,_y);
+    if(_q->seed == 0){
+        noisemod_modulate(_q->mod,_y);
+        return 0;
+    }
+    // Box-Muller, scaled as noisemod_modulate scales crandnf()
+    float r = sqrtf(-2.0f*logf(symstreamrncf_randf(_q)));
+    float t = 2.0f*(float)M_PI*symstreamrncf_randf(_q);
+    float *y = (float*)_y;// {re, im} in both the C and C++ layouts
+    y[0] = r*cosf(t)*.707106781186547f;
+    y[1] = r*sinf(t)*.707106781186547f;
     return 0;
 }
 
@@ -0,0 +1,134 @@
+#ifdef __cplusplus
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <omp.h>
+#endif
+#include "offline.hh"
+#include "iq_gain.hh"
+
+#ifdef __cplusplus
+namespace w = wfgen::writer;
+namespace c = wfgen::containers;
+
+static w::writer offline_open(const std::string & iq_path)
+{
+    w::writer f = w::writer_create(w::WRITER_IQ, iq_path.c_str(), 0);
+    if (f->fptr == NULL) {
+        w::writer_destroy(&f);
+        throw std::runtime_error("could not open "+iq_path+" for writing");
+    }
+    return f;
+}
+
+float offline_render(scene & sc, const offline_config & config,
+                     const std::string & iq_path, labels * reporter)
+{
+    uint64_t num_samples = (uint64_t)(config.duration*config.sample_rate + 0.5);
+    uint64_t block_len = std::max(1U, config.block_len);
+    w::writer f = offline_open(iq_path);
+    std::vector<std::complex<float> > buf(block_len);
+    c::container iq = c::container_create(c::CFLOAT32 | c::POINTER, block_len, buf.data());
+    std::vector<scene_burst> bursts;
+
+    float peak = 0.0f;
+    bool short_write = false;
+    sc.seek(0);
+    for (uint64_t t=0; t<num_samples && !short_write; t+=block_len) {
+        uint64_t n = std::min(block_len, num_samples - t);
+        bursts.clear();
+        peak = std::max(peak, sc.render(buf.data(), (unsigned int)n, &bursts));
+        short_write = w::writer_store_head(f, iq, n) != n;
+        sc.report(reporter, bursts, config.start_time, config.center_freq);
+    }
+    c::container_destroy(&iq);
+    w::writer_destroy(&f);
+    if (short_write)
+        throw std::runtime_error("could not write all samples to "+iq_path);
+    return peak;
+}
+
+float offline_render(const std::vector<scene_emitter> & emitters, const offline_config & config,
+                     const std::string & iq_path, labels * reporter)
+{
+    double rate = config.sample_rate;
+    uint64_t num_samples = (uint64_t)(config.duration*rate + 0.5);
+    uint64_t seg_len = std::max((uint64_t)1, (uint64_t)(config.segment_time*rate + 0.5));
+    uint64_t block_len = std::max(1U, config.block_len);
+    long num_segments = (long)((num_samples + seg_len - 1)/seg_len);
+    int num_threads = config.num_threads ? (int)config.num_threads : omp_get_max_threads();
+    num_threads = (int)std::max(1L, std::min((long)num_threads, num_segments));
+
+    // An analog emitter plays its audio on from wherever it stopped and its
+    // source cannot seek, so the analog emitters go in one scene rendered a
+    // segment at a time in order, and everything else in a scene per thread.
+    // Both are built here so that a bad emitter throws here.
+    const unsigned int serial_kinds = SCENE_KIND_BIT(SCENE_ANALOG);
+    std::vector<std::unique_ptr<scene> > scenes;
+    for (int i=0; i<num_threads; i++)
+        scenes.emplace_back(new scene(emitters, rate, config.duration, config.seed,
+                                         SCENE_KINDS_ALL & ~serial_kinds));
+    std::unique_ptr<scene> serial(new scene(emitters, rate, config.duration, config.seed, serial_kinds));
+    if (serial->num_lanes() == 0)
+        serial.reset();
+    uint64_t settle = scenes[0]->settling();
+
+    w::writer f = offline_open(iq_path);
+
+    float peak = 0.0f;
+    bool short_write = false;
+    std::vector<std::complex<float> > serial_buf(serial ? block_len : 0);
+    std::vector<scene_burst> serial_bursts;
+    #pragma omp parallel num_threads(num_threads) reduction(max:peak)
+    {
+        scene & sc = *scenes[omp_get_thread_num()];
+        // a segment is rendered after the settling samples ahead of it
+        std::vector<std::complex<float> > buf(settle + seg_len);
+        std::complex<float> * seg = buf.data() + settle;
+        c::container iq = c::container_create(c::CFLOAT32 | c::POINTER, seg_len, seg);
+        std::vector<scene_burst> bursts, own;
+
+        #pragma omp for ordered schedule(dynamic)
+        for (long s=0; s<num_segments; s++) {
+            uint64_t t0 = (uint64_t)s*seg_len;
+            uint64_t n = std::min(seg_len, num_samples - t0);
+            uint64_t pre = std::min(settle, t0);
+            std::complex<float> * y = seg - pre;
+            sc.seek(t0 - pre);
+            bursts.clear();
+            for (uint64_t i=0; i<pre+n; i+=block_len)
+                sc.render(y + i, (unsigned int)std::min(block_len, pre + n - i), &bursts);
+
+            // bursts starting in the settling samples belong to the segment before
+            own.clear();
+            for (auto &b: bursts)
+                if (b.t0 >= t0/rate)
+                    own.push_back(b);
+
+            #pragma omp ordered
+            {
+                if (serial) {
+                    // the serial scene is exactly at t0 here
+                    serial_bursts.clear();
+                    for (uint64_t i=0; i<n; i+=block_len) {
+                        unsigned int m = (unsigned int)std::min(block_len, n - i);
+                        serial->render(serial_buf.data(), m, &serial_bursts);
+                        for (unsigned int j=0; j<m; j++)
+                            seg[i+j] += serial_buf[j];
+                    }
+                    own.insert(own.end(), serial_bursts.begin(), serial_bursts.end());
+                }
+                peak = iq_peak(seg, n, peak);
+                if (!short_write && w::writer_store_head(f, iq, n) != n)
+                    short_write = true;
+                sc.report(reporter, own, config.start_time, config.center_freq);
+            }
+        }
+        c::container_destroy(&iq);
+    }
+    w::writer_destroy(&f);
+    if (short_write)
+        throw std::runtime_error("could not write all samples to "+iq_path);
+    return peak;
+}
+#endif
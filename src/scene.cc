@@ -0,0 +1,417 @@
+#ifdef __cplusplus
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#endif
+#include "scene.hh"
+#include "generator.hh"
+#include "wbofdmgen.hh"
+#include "iq_gain.hh"
+
+#ifdef __cplusplus
+using namespace wfgen::generators;
+
+// samples summed per slice of a block, a slice of every lane stays in cache
+#define SCENE_SLICE 2048
+// label length of an emitter that is on throughout an open-ended scene
+#define SCENE_SEGMENT_TIME 1.0
+
+scene_emitter::scene_emitter() :
+    kind(SCENE_LINEAR), scheme(LIQUID_MODEM_QPSK), fc(0.0f), bw(0.05f), gain_db(0.0f),
+    start(0.0), stop(-1.0), on_time(-1.0), off_time(0.0),
+    k(8), mod_index(-1.0f), cpf_type(0), src_freq(-1.0f), nfft(1024)
+{
+}
+
+static const char * scene_kind_names[SCENE_KIND_COUNT] = {
+    "linear", "fsk", "analog", "noise", "ofdm", "tone"
+};
+
+// scheme named _mod for an emitter of kind _kind, the kind's default if empty
+static int scene_scheme_lookup(scene_kind _kind, const std::string & _mod)
+{
+    int i;
+    switch (_kind) {
+    case SCENE_LINEAR:
+    case SCENE_OFDM:
+        if (_mod.empty()) return LIQUID_MODEM_QPSK;
+        i = liquid_getopt_str2mod(_mod.c_str());
+        break;
+    case SCENE_FSK:
+        if (_mod.empty()) return LIQUID_MODEM_FSK4;
+        i = liquid_getopt_str2fsk(_mod.c_str());
+        break;
+    case SCENE_ANALOG:
+        if (_mod.empty()) return LIQUID_ANALOG_FM_SINUSOID;
+        i = liquid_getopt_str2analog(_mod.c_str());
+        break;
+    case SCENE_NOISE:
+        if (_mod.empty()) return LIQUID_NOISE_AWGN;
+        i = liquid_getopt_str2noise(_mod.c_str());
+        break;
+    default:
+        return 0;
+    }
+    // the unknown scheme of every family is 0
+    if (i <= 0)
+        throw std::invalid_argument("unknown "+std::string(scene_kind_names[_kind])+" modulation: "+_mod);
+    return i;
+}
+
+scene_emitter scene_emitter_parse(const std::string & spec)
+{
+    scene_emitter e;
+    std::string mod;
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+        std::string item = spec.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty()) continue;
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            throw std::invalid_argument("emitter option without a value: "+item);
+        std::string key = item.substr(0, eq);
+        std::string val = item.substr(eq + 1);
+        const char * v = val.c_str();
+        if (key == "type") {
+            int kind = -1;
+            for (int i=0; i<SCENE_KIND_COUNT; i++)
+                if (val == scene_kind_names[i]) kind = i;
+            if (kind < 0)
+                throw std::invalid_argument("unknown emitter type: "+val);
+            e.kind = (scene_kind)kind;
+        }
+        else if (key == "mod")   mod = val;
+        else if (key == "fc")    e.fc       = strtof(v, NULL);
+        else if (key == "bw")    e.bw       = strtof(v, NULL);
+        else if (key == "gain")  e.gain_db  = strtof(v, NULL);
+        else if (key == "start") e.start    = strtod(v, NULL);
+        else if (key == "stop")  e.stop     = strtod(v, NULL);
+        else if (key == "on")    e.on_time  = strtod(v, NULL);
+        else if (key == "off")   e.off_time = strtod(v, NULL);
+        else if (key == "k")     e.k        = strtoul(v, NULL, 10);
+        else if (key == "index") e.mod_index= strtof(v, NULL);
+        else if (key == "cpf")   e.cpf_type = strtoul(v, NULL, 10);
+        else if (key == "src")   e.src_freq = strtof(v, NULL);
+        else if (key == "nfft")  e.nfft     = strtoul(v, NULL, 10);
+        else
+            throw std::invalid_argument("unknown emitter option: "+key);
+    }
+    e.scheme = scene_scheme_lookup(e.kind, mod);
+    return e;
+}
+
+// wideband ofdm symbols as a sample stream, ncar = bw*nfft subcarriers
+// around DC at the scene rate
+class ofdm_generator : public generator<ofdm_generator>{
+  public:
+    ofdm_generator(unsigned int nfft, float bw, int ms) :
+        ofdm(nfft, nfft/8, std::max(2U, (unsigned int)(bw*nfft + 0.5f)), ms),
+        symbols(ofdm.get_buf_len(8)), index(symbols.size()), gain(1.0f) {}
+
+    int do_write(std::complex<float> * buf, unsigned int n) {
+        for (unsigned int i=0; i<n; i++) {
+            if (index == symbols.size()) {
+                ofdm.generate(symbols.data(), 8);
+                index = 0;
+            }
+            buf[i] = gain*symbols[index++];
+        }
+        return LIQUID_OK;
+    }
+    int do_set_gain(float g) { gain = g; return LIQUID_OK; }
+    float do_get_delay() { return 0.0f; }
+    int do_reset() { index = symbols.size(); return LIQUID_OK; }
+
+  private:
+    wbofdmgen ofdm;
+    std::vector<std::complex<float> > symbols;
+    size_t index;
+    float gain;
+};
+
+// Seed of the generator of emitter i from sample t on. Lanes draw their
+// symbols from their own generator instead of rand(), so they neither
+// contend on its lock nor depend on the order threads reach it.
+static uint32_t scene_lane_seed(uint32_t seed, unsigned int i, uint64_t t)
+{
+    uint64_t z = seed + (i + 1)*0x9e3779b97f4a7c15ULL + t*0xd1b54a32d192ed03ULL;
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return ((uint32_t)z) ? (uint32_t)z : 1;
+}
+
+// generators with a symbol sequence of their own; the rest have none
+// (tone), draw from their message source (analog) or from rand() in
+// wbofdmgen (ofdm)
+template<class G>
+static int scene_set_seed(G &, uint32_t) { return LIQUID_OK; }
+static int scene_set_seed(seeded_linear_generator & g, uint32_t seed) { return g.set_seed(seed); }
+static int scene_set_seed(fsk_generator & g, uint32_t seed) { return symstreamrfcf_set_seed(g.get(), seed); }
+static int scene_set_seed(noise_generator & g, uint32_t seed) { return symstreamrncf_set_seed(g.get(), seed); }
+
+// The lanes hold generators of every family side by side, so they are
+// reached through one virtual call per run of samples; the sample loops
+// themselves stay in the generators.
+class scene_source {
+  public:
+    virtual ~scene_source() {}
+    virtual int write(std::complex<float> * buf, unsigned int n) = 0;
+    virtual int set_gain(float gain) = 0;
+    virtual int set_seed(uint32_t seed) = 0;
+    virtual float get_delay() = 0;
+    virtual int reset() = 0;
+};
+
+template<class G>
+class scene_source_of : public scene_source {
+  public:
+    template<class... A>
+    explicit scene_source_of(A&&... a) : gen(std::forward<A>(a)...) {}
+    int write(std::complex<float> * buf, unsigned int n) { return gen.write(buf, n); }
+    int set_gain(float gain) { return gen.set_gain(gain); }
+    int set_seed(uint32_t seed) { return scene_set_seed(gen, seed); }
+    float get_delay() { return gen.get_delay(); }
+    int reset() { return gen.reset(); }
+    G & get() { return gen; }
+  private:
+    G gen;
+};
+
+static scene_source * scene_source_create(const scene_emitter & e)
+{
+    switch (e.kind) {
+    case SCENE_LINEAR:
+        // liquid's linear stream draws from rand(), this one can be seeded
+        return new scene_source_of<seeded_linear_generator>(
+            LIQUID_FIRFILT_ARKAISER, e.bw, 12, 0.25f, (modulation_scheme)e.scheme, 1);
+    case SCENE_FSK:
+        return new scene_source_of<fsk_generator>(symstreamrfcf_create_fsk(
+            LIQUID_FIRFILT_ARKAISER, e.k, e.mod_index > 0 ? e.mod_index : 1.0f, 12, e.bw, 0.35f,
+            e.cpf_type, e.scheme));
+    case SCENE_ANALOG:
+        return new scene_source_of<analog_generator>(symstreamracf_create_analog(
+            LIQUID_FIRFILT_ARKAISER, e.bw, 12, 0.25f, e.mod_index, e.src_freq, e.scheme));
+    case SCENE_NOISE:
+        return new scene_source_of<noise_generator>(symstreamrncf_create_noise(
+            LIQUID_FIRFILT_ARKAISER, e.bw, 12, 0.25f, e.scheme));
+    case SCENE_OFDM:
+        return new scene_source_of<ofdm_generator>(e.nfft, e.bw, e.scheme);
+    case SCENE_TONE:
+        return new scene_source_of<tone_generator>();
+    default:
+        throw std::invalid_argument("unknown emitter type");
+    }
+}
+
+// runtime state of an emitter, times in samples from the scene start
+struct scene::lane {
+    unsigned int index;         // emitter of the lane
+    std::unique_ptr<scene_source> src;
+    nco_crcf     mixer;
+    float        amp;           // linear gain applied while summing
+    unsigned int flush;         // samples written off after a burst to empty the filters
+    uint64_t     first;         // start of the first burst
+    uint64_t     stop;          // no burst starts from here on
+    uint64_t     on, period;    // burst length and spacing
+    uint64_t     burst_start;   // current or next burst, UINT64_MAX once there are none
+    uint64_t     burst_end;
+    uint64_t     flush_end;     // end of the tail after the last burst
+    bool         written;       // lane holds samples of the current block
+    std::vector<std::complex<float> > buf;
+    std::vector<scene_burst> bursts;
+
+    void next_burst() {
+        burst_start += period;
+        if (burst_start >= stop) {
+            burst_start = burst_end = UINT64_MAX;
+            return;
+        }
+        burst_end = std::min(burst_start + on, stop);
+    }
+};
+
+scene::scene(const std::vector<scene_emitter> & _emitters, double _sample_rate, double _duration,
+             uint32_t _seed, unsigned int _kinds) :
+    rate(_sample_rate), seed(_seed), clock(0), emitters(_emitters)
+{
+    uint64_t end = (_duration > 0) ? (uint64_t)(_duration*rate + 0.5) : UINT64_MAX;
+    for (size_t i=0; i<emitters.size(); i++) {
+        const scene_emitter & e = emitters[i];
+        if (e.bw <= 0.0f || e.bw >= 1.0f || e.fc < -0.5f || e.fc > 0.5f)
+            throw std::invalid_argument("emitter "+std::to_string(i)+" does not fit the band");
+        if (!(_kinds & SCENE_KIND_BIT(e.kind)))
+            continue;
+        lanes.emplace_back();
+        lane & l = lanes.back();
+        l.index = (unsigned int)i;
+        l.src.reset(scene_source_create(e));
+        l.mixer = nco_crcf_create(LIQUID_VCO);
+        nco_crcf_set_frequency(l.mixer, 2*M_PI*e.fc);
+        l.amp   = powf(10.0f, e.gain_db/20.0f);
+        l.flush = 2*(unsigned int)(l.src->get_delay() + 1.5f);
+
+        l.first = (uint64_t)(std::max(0.0, e.start)*rate + 0.5);
+        l.stop  = (e.stop > 0) ? std::min(end, (uint64_t)(e.stop*rate + 0.5)) : end;
+        if (e.on_time > 0) {
+            l.on     = std::max((uint64_t)1, (uint64_t)(e.on_time*rate + 0.5));
+            l.period = l.on + (uint64_t)(std::max(0.0, e.off_time)*rate + 0.5);
+        }
+        else {
+            // on throughout, labelled in one piece if the scene has an end
+            l.on = (l.stop != UINT64_MAX && l.stop > l.first) ? l.stop - l.first
+                                                             : (uint64_t)(SCENE_SEGMENT_TIME*rate);
+            l.on = l.period = std::max((uint64_t)1, l.on);
+        }
+    }
+    seek(0);
+}
+
+scene::~scene()
+{
+    for (auto &l: lanes)
+        nco_crcf_destroy(l.mixer);
+}
+
+void scene::seek(uint64_t t)
+{
+    for (size_t i=0; i<lanes.size(); i++) {
+        lane & l = lanes[i];
+        l.src->reset();
+        l.src->set_seed(scene_lane_seed(seed, l.index, t));
+        // back up one period so next_burst() lands on the burst around t
+        uint64_t n = (t > l.first) ? (t - l.first)/l.period : 0;
+        l.burst_start = l.first + n*l.period - l.period;
+        l.next_burst();
+        if (l.burst_end <= t)
+            l.next_burst();
+        l.flush_end = 0;
+        l.written = false;
+    }
+    clock = t;
+}
+
+unsigned int scene::num_lanes() const
+{
+    return (unsigned int)lanes.size();
+}
+
+unsigned int scene::settling() const
+{
+    unsigned int n = 0;
+    for (auto &l: lanes)
+        n = std::max(n, l.flush);
+    return n;
+}
+
+// write lane l for the block [clock, clock+n)
+void scene::render_lane(lane & l, unsigned int n, unsigned int index)
+{
+    l.bursts.clear();
+    uint64_t t = clock, end = clock + n;
+    l.written = false;
+    if (l.burst_start >= end && l.flush_end <= t)
+        return;                 // off for the whole block
+
+    std::complex<float> * y = l.buf.data();
+    while (t < end) {
+        if (t >= l.burst_start && t < l.burst_end) {
+            if (t == l.burst_start)
+                l.bursts.push_back(scene_burst{index, l.burst_start/rate,
+                    (l.burst_end - l.burst_start)/rate, emitters[index].fc, emitters[index].bw});
+            uint64_t m = std::min(l.burst_end, end) - t;
+            l.src->set_gain(1.0f);
+            l.src->write(y + (t - clock), (unsigned int)m);
+            t += m;
+            l.written = true;
+            if (t == l.burst_end) {
+                l.flush_end = t + l.flush;
+                l.next_burst();
+            }
+        }
+        else if (t < l.flush_end) {
+            uint64_t m = std::min(std::min(l.flush_end, end), l.burst_start) - t;
+            l.src->set_gain(0.0f);
+            l.src->write(y + (t - clock), (unsigned int)m);
+            t += m;
+            l.written = true;
+        }
+        else {
+            uint64_t m = std::min(l.burst_start, end) - t;
+            std::fill(y + (t - clock), y + (t - clock) + m, std::complex<float>(0.0f, 0.0f));
+            t += m;
+        }
+    }
+    if (l.written) {
+        // the carrier phase follows the scene clock, idle blocks and seeks included
+        nco_crcf_set_phase(l.mixer, (float)fmod(2*M_PI*emitters[index].fc*(double)clock, 2*M_PI));
+        nco_crcf_mix_block_up(l.mixer, y, y, n);
+    }
+}
+
+float scene::render(std::complex<float> * buf, unsigned int n, std::vector<scene_burst> * bursts)
+{
+    for (auto &l: lanes)
+        if (l.buf.size() < n)
+            l.buf.resize(n);
+
+    long num_lanes = (long)lanes.size();
+    #pragma omp parallel for schedule(dynamic)
+    for (long i=0; i<num_lanes; i++)
+        render_lane(lanes[i], n, lanes[i].index);
+
+    active.clear();
+    for (size_t i=0; i<lanes.size(); i++) {
+        if (lanes[i].written)
+            active.push_back((unsigned int)i);
+        if (bursts != nullptr)
+            bursts->insert(bursts->end(), lanes[i].bursts.begin(), lanes[i].bursts.end());
+    }
+
+    // sum the lanes written, each thread over its own slices of the block;
+    // a complex sample is two floats, so the inner loop is plain multiply-add
+    float peak = 0.0f;
+    long num_slices = ((long)n + SCENE_SLICE - 1)/SCENE_SLICE;
+    #pragma omp parallel for schedule(static) reduction(max:peak)
+    for (long s=0; s<num_slices; s++) {
+        unsigned int i0 = (unsigned int)s*SCENE_SLICE;
+        unsigned int len = std::min(n - i0, (unsigned int)SCENE_SLICE);
+        float * y = reinterpret_cast<float*>(buf + i0);
+        std::fill(y, y + 2*len, 0.0f);
+        for (unsigned int a: active) {
+            const float * x = reinterpret_cast<const float*>(lanes[a].buf.data() + i0);
+            float g = lanes[a].amp;
+            #pragma omp simd
+            for (unsigned int j=0; j<2*len; j++)
+                y[j] += g*x[j];
+        }
+        peak = iq_peak(buf + i0, len, peak);
+    }
+
+    clock += n;
+    return peak;
+}
+
+void scene::report(labels * reporter, const std::vector<scene_burst> & bursts,
+                   double start, double center_freq) const
+{
+    if (reporter == nullptr) return;
+    for (auto &b: bursts) {
+        const scene_emitter & e = emitters[b.emitter];
+        switch (e.kind) {
+        case SCENE_LINEAR: reporter->set_modulation((modulation_scheme)e.scheme); break;
+        case SCENE_FSK:    reporter->set_modulation((fsk_scheme)e.scheme); break;
+        case SCENE_ANALOG: reporter->set_modulation((analog_scheme)e.scheme); break;
+        case SCENE_NOISE:  reporter->set_modulation((noise_scheme)e.scheme); break;
+        default:           reporter->set_modulation(std::string(scene_kind_names[e.kind])); break;
+        }
+        reporter->append(start + b.t0, b.dur, center_freq + b.fc*rate, b.bw*rate,
+                         "emitter " + std::to_string(b.emitter));
+    }
+}
+#endif
@@ -0,0 +1,137 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // memfd_create
+#endif
+#include "spsc_ring.hh"
+#include <unistd.h>
+#include <sys/mman.h>
+
+uint8_t spsc_ring_map_mirror(spsc_ring ring){
+    // reserve 2x the address space, then map one memfd into both halves
+    size_t bytes = ring->capacity*sizeof(float);
+    int fd = memfd_create("wfgen_spsc_ring", 0);
+    if(fd < 0) return 0;
+    if(ftruncate(fd, bytes)){
+        close(fd);
+        return 0;
+    }
+    uint8_t *base = (uint8_t*)mmap(NULL, 2*bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == (uint8_t*)MAP_FAILED){
+        close(fd);
+        return 0;
+    }
+    void *lo = mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    void *hi = mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    close(fd);// both mappings keep the memory alive
+    if(lo != (void*)base || hi != (void*)(base + bytes)){
+        munmap(base, 2*bytes);
+        return 0;
+    }
+    ring->data = (float*)base;
+    return 1;
+}
+
+spsc_ring spsc_ring_create(uint64_t min_capacity){
+    void *mem = NULL;
+    if(posix_memalign(&mem, SPSC_RING_CACHE_LINE, sizeof(struct spsc_ring_s))) return NULL;
+    spsc_ring ring = (spsc_ring)mem;
+    memset(ring, 0, sizeof(struct spsc_ring_s));
+    // whole pages so the two halves of the mirror line up
+    uint64_t page_floats = sysconf(_SC_PAGESIZE)/sizeof(float);
+    uint64_t capacity = page_floats;
+    while(capacity < min_capacity) capacity <<= 1;
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    ring->mirrored = spsc_ring_map_mirror(ring);
+    if(!ring->mirrored){
+        ring->data = (float*)malloc(2*capacity*sizeof(float));
+        if(ring->data == NULL){
+            free(ring);
+            return NULL;
+        }
+        memset(ring->data, 0, 2*capacity*sizeof(float));
+    }
+    return ring;
+}
+
+void spsc_ring_destroy(spsc_ring *ring){
+    if(ring == NULL) return;
+    if(*ring == NULL) return;
+    if((*ring)->data != NULL){
+        if((*ring)->mirrored) munmap((*ring)->data, 2*(*ring)->capacity*sizeof(float));
+        else free((*ring)->data);
+    }
+    free(*ring);
+    *ring = NULL;
+}
+
+void spsc_ring_reset(spsc_ring ring){
+    if(ring == NULL) return;
+    __atomic_store_n(&ring->tail, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+}
+
+uint64_t spsc_ring_capacity(spsc_ring ring){
+    if(ring == NULL) return 0;
+    return ring->capacity;
+}
+
+uint64_t spsc_ring_size(spsc_ring ring){
+    if(ring == NULL) return 0;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+uint64_t spsc_ring_space(spsc_ring ring){
+    if(ring == NULL) return 0;
+    return ring->capacity - spsc_ring_size(ring);
+}
+
+uint64_t spsc_ring_write_ptr(spsc_ring ring, float **ptr){
+    if(ring == NULL || ptr == NULL) return 0;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);// only we move head
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    *ptr = &ring->data[head & ring->mask];
+    return ring->capacity - (head - tail);
+}
+
+int spsc_ring_commit(spsc_ring ring, uint64_t n){
+    if(ring == NULL) return 1;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    if(n > ring->capacity - (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))) return 2;
+    if(!ring->mirrored && n > 0){
+        // the span may run past capacity; copy each piece to its twin
+        uint64_t start = head & ring->mask;
+        uint64_t low = (start + n > ring->capacity) ? ring->capacity - start : n;
+        memcpy(&ring->data[start + ring->capacity], &ring->data[start], low*sizeof(float));
+        if(low < n) memcpy(&ring->data[0], &ring->data[ring->capacity], (n - low)*sizeof(float));
+    }
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+    return 0;
+}
+
+uint64_t spsc_ring_write(spsc_ring ring, const float *in, uint64_t n){
+    float *ptr;
+    uint64_t space = spsc_ring_write_ptr(ring, &ptr);
+    if(n > space) n = space;
+    if(n == 0) return 0;
+    memcpy(ptr, in, n*sizeof(float));
+    spsc_ring_commit(ring, n);
+    return n;
+}
+
+uint64_t spsc_ring_read_ptr(spsc_ring ring, float **ptr){
+    if(ring == NULL || ptr == NULL) return 0;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);// only we move tail
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    *ptr = &ring->data[tail & ring->mask];
+    return head - tail;
+}
+
+int spsc_ring_release(spsc_ring ring, uint64_t n){
+    if(ring == NULL) return 1;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    if(n > __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail) return 2;
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+    return 0;
+}
@@ -1,6 +1,9 @@
 
 #include "wav.hh"
+#include "audio_cache.hh"
 #include <glob.h>
+#include <time.h>
+#include <unistd.h>
 #ifdef __cplusplus
 #include <iostream>
 #include <cstdlib>
@@ -66,6 +69,7 @@ wav_obj_t* open_wav(std::string fp){
         out->err_state = 2;// couldn't mmap
         return out;
     }
+    madvise(out->data_ptr, out->filesize, MADV_SEQUENTIAL);// decoded front to back in spans
 
     uint8_t *ptr8;
     ptr8 = (uint8_t*)out->data_ptr;
@@ -94,7 +98,7 @@ wav_obj_t* open_wav(std::string fp){
         return out;
     }
 
-    if(*((uint32_t*)(&ptr8[fmt_offset+4])) != 16){
+    if(*((uint32_t*)(&ptr8[fmt_offset+4])) < 16){
         out->err_state = 5; // something is wrong with the fmt section
         return out;
     }
@@ -105,7 +109,7 @@ wav_obj_t* open_wav(std::string fp){
     out->block_align = *((uint16_t*)(&ptr8[fmt_offset+20]));
     out->bit_depth = *((uint16_t*)(&ptr8[fmt_offset+22]));
 
-    if(out->audio_fmt != 1){
+    if(out->audio_fmt != 1 && !(out->audio_fmt == 3 && out->bit_depth == 32)){
         out->err_state = 0xF0;//don't know how to handle this format
         return out;
     }
@@ -159,6 +163,7 @@ wav_obj_t* open_wav(char* fp){
         out->err_state = 2;// couldn't mmap
         return out;
     }
+    madvise(out->data_ptr, out->filesize, MADV_SEQUENTIAL);// decoded front to back in spans
 
     uint8_t *ptr8;
     ptr8 = (uint8_t*)out->data_ptr;
@@ -178,7 +183,7 @@ wav_obj_t* open_wav(char* fp){
         return out;
     }
 
-    if(*((uint32_t*)(&ptr8[fmt_offset+4])) != 16){
+    if(*((uint32_t*)(&ptr8[fmt_offset+4])) < 16){
         out->err_state = 5; // something is wrong with the fmt section
         return out;
     }
@@ -189,14 +194,14 @@ wav_obj_t* open_wav(char* fp){
     out->block_align = *((uint16_t*)(&ptr8[fmt_offset+20]));
     out->bit_depth = *((uint16_t*)(&ptr8[fmt_offset+22]));
 
-    if(out->audio_fmt != 1){
+    if(out->audio_fmt != 1 && !(out->audio_fmt == 3 && out->bit_depth == 32)){
         out->err_state = 0xF0;//don't know how to handle this format
         return out;
     }
 
     out->data_len = (size_t) *((uint32_t*)(&ptr8[out->data_offset+4]));
     // out->data_type = uint8_t(int((float)(out->bit_depth)/8.0f));
-    out->data_type = (uint8_t)((float)(out->bit_depth))/8.0f;
+    out->data_type = (uint8_t)(out->bit_depth/8);
     out->data_offset += 8;
 
     return out;
@@ -275,82 +280,106 @@ void print_wav_info(wav_obj wav, uint8_t mode, uint32_t offset, int32_t length){
     #endif
 }
 
+int wav_decode_span(wav_obj wav, uint32_t start_idx, uint32_t stereo_samples, float* out_ptr){
+    // decode a contiguous run of frames straight from the mapped file into
+    // interleaved stereo floats, stopping at the end of the data chunk
+    if (wav == NULL) return -1;
+    if (out_ptr == NULL) return -2;
+    if (wav->block_align == 0) return -3;
+    size_t len = wav->data_len/wav->block_align;
+    if (start_idx >= len) return 0;
+    uint32_t count = (stereo_samples < len - start_idx) ? stereo_samples : (uint32_t)(len - start_idx);
+    size_t stride = wav->block_align;
+    const uint8_t *src = &((const uint8_t*)wav->data_ptr)[wav->data_offset + (size_t)start_idx*stride];
+    uint8_t stereo = (wav->num_channels > 1);
+    float scaling;
+    switch(wav->data_type){
+        case 1:
+            // 8 bit PCM is unsigned, centred on 128
+            scaling = 1.0f/128.0f;
+            #pragma omp simd
+            for(uint32_t idx = 0; idx < count; idx++){
+                const uint8_t *frame = src + idx*stride;
+                float left = scaling*((float)frame[0]-128.0f);
+                float right = stereo ? scaling*((float)frame[1]-128.0f) : left;
+                out_ptr[2*idx+0] = stereo ? left : 0.5f*left;
+                out_ptr[2*idx+1] = stereo ? right : 0.5f*left;
+            }
+            break;
+        case 2:
+            scaling = 1.0f/32768.0f;
+            #pragma omp simd
+            for(uint32_t idx = 0; idx < count; idx++){
+                const uint8_t *frame = src + idx*stride;
+                int16_t l, r;
+                memcpy(&l, frame, 2);
+                memcpy(&r, frame + (stereo ? 2 : 0), 2);
+                out_ptr[2*idx+0] = (stereo ? scaling : 0.5f*scaling)*(float)l;
+                out_ptr[2*idx+1] = (stereo ? scaling : 0.5f*scaling)*(float)r;
+            }
+            break;
+        case 3:
+            // packed little endian 24 bit, sign extended through the top byte
+            scaling = 1.0f/8388608.0f;
+            #pragma omp simd
+            for(uint32_t idx = 0; idx < count; idx++){
+                const uint8_t *frame = src + idx*stride;
+                const uint8_t *rf = frame + (stereo ? 3 : 0);
+                int32_t l = (int32_t)(((uint32_t)frame[0] << 8) | ((uint32_t)frame[1] << 16) | ((uint32_t)frame[2] << 24)) >> 8;
+                int32_t r = (int32_t)(((uint32_t)rf[0] << 8) | ((uint32_t)rf[1] << 16) | ((uint32_t)rf[2] << 24)) >> 8;
+                out_ptr[2*idx+0] = (stereo ? scaling : 0.5f*scaling)*(float)l;
+                out_ptr[2*idx+1] = (stereo ? scaling : 0.5f*scaling)*(float)r;
+            }
+            break;
+        case 4:
+            if (wav->audio_fmt == 3){
+                // IEEE float, already normalized
+                #pragma omp simd
+                for(uint32_t idx = 0; idx < count; idx++){
+                    const uint8_t *frame = src + idx*stride;
+                    float l, r;
+                    memcpy(&l, frame, 4);
+                    memcpy(&r, frame + (stereo ? 4 : 0), 4);
+                    out_ptr[2*idx+0] = stereo ? l : 0.5f*l;
+                    out_ptr[2*idx+1] = stereo ? r : 0.5f*r;
+                }
+            }
+            else{
+                scaling = 1.0f/2147483648.0f;
+                #pragma omp simd
+                for(uint32_t idx = 0; idx < count; idx++){
+                    const uint8_t *frame = src + idx*stride;
+                    int32_t l, r;
+                    memcpy(&l, frame, 4);
+                    memcpy(&r, frame + (stereo ? 4 : 0), 4);
+                    out_ptr[2*idx+0] = (stereo ? scaling : 0.5f*scaling)*(float)l;
+                    out_ptr[2*idx+1] = (stereo ? scaling : 0.5f*scaling)*(float)r;
+                }
+            }
+            break;
+        default:
+            return -3;
+    }
+    return count;
+}
+
 int index_wav(wav_obj wav, uint32_t start_idx, uint32_t stereo_samples, float* out_ptr){
     if (wav == NULL) return -1;
     if (out_ptr == NULL) return -2;
-    uint8_t bytes_per_sample = wav->block_align;
-    float scaling = 512;
-    float shift = -1.0;
-    if (wav->data_type == 2){
-        scaling = 32768.0;
-        shift = 0.0;
-    }
-    else if (wav->data_type == 4){
-        scaling = 2147483648.0;
-        shift = 0.0;
-    }
-    else if (wav->data_type != 1){
-        return -3;
-    }
-    scaling = 1.0/scaling;
-    size_t len = wav->data_len/bytes_per_sample;
-    size_t offset = 0;
+    if (wav->block_align == 0) return -3;
+    size_t len = wav->data_len/wav->block_align;
     uint32_t xfer = 0;
-    float samp[2];
-    uint8_t *data_ptr = &((uint8_t*)wav->data_ptr)[wav->data_offset];
+    int span;
     while(xfer < stereo_samples){
-        samp[0] = 0.;
-        samp[1] = 0.;
-        if(start_idx+xfer >= len){
+        if(start_idx >= len){
             if (xfer >= len) break;
             start_idx = 0;
-            offset = 0;
-        }
-        switch(wav->data_type){
-            case 1:
-                samp[0] = scaling*(float)(data_ptr[start_idx*bytes_per_sample + offset++])+shift;
-                if(wav->num_channels > 1){
-                    samp[1] = scaling*(float)(data_ptr[start_idx*bytes_per_sample + offset++])+shift;
-                }
-                else{
-                    //assume it's mono and just dumbly make it stereo
-                    samp[0] /= 2.0f;
-                    samp[1] = samp[0];
-                }
-                break;
-            case 2:
-                samp[0] = scaling*(float)(*((int16_t*)&data_ptr[start_idx*bytes_per_sample + offset]));
-                offset += 2;
-                if(wav->num_channels > 1){
-                    samp[1] = scaling*(float)(*((int16_t*)&data_ptr[start_idx*bytes_per_sample + offset]));
-                    offset += 2;
-                }
-                else{
-                    //assume it's mono and just dumbly make it stereo
-                    samp[0] /= 2.0f;
-                    samp[1] = samp[0];
-                }
-                break;
-            case 4:
-                samp[0] = scaling*(float)(*((int32_t*)&data_ptr[start_idx*bytes_per_sample + offset]));
-                offset += 4;
-                if(wav->num_channels > 1){
-                    samp[1] = scaling*(float)(*((int32_t*)&data_ptr[start_idx*bytes_per_sample + offset]));
-                    offset += 4;
-                }
-                else{
-                    //assume it's mono and just dumbly make it stereo
-                    samp[0] /= 2.0f;
-                    samp[1] = samp[0];
-                }
-                break;
-            default:
-                return -3;
-                break;
         }
-        out_ptr[2*xfer+0] = samp[0];
-        out_ptr[2*xfer+1] = samp[1];
-        xfer++;
+        span = wav_decode_span(wav, start_idx, stereo_samples-xfer, &out_ptr[2*xfer]);
+        if(span < 0) return span;
+        if(span == 0) break;
+        xfer += span;
+        start_idx += span;
     }
     return xfer;
 }
@@ -358,7 +387,7 @@ int index_wav(wav_obj wav, uint32_t start_idx, uint32_t stereo_samples, float* o
 void load_files(char **filepaths, int file_count, wav_reader wav){
     if(wav == NULL) return;
     if(wav->wavs != NULL){
-        for(uint8_t idx = 0; idx < wav->file_count; idx++)
+        for(uint32_t idx = 0; idx < wav->file_count; idx++)
             destroy_wav_obj(&wav->wavs[idx]);
         free(wav->wavs);
     }
@@ -394,7 +423,7 @@ int find_default_valid(char **filepaths){
         }
         if(valid_files > 0){
             wav_obj wav;
-            for(uint8_t idx = 0; idx < globbuf.gl_pathc; idx++){
+            for(size_t idx = 0; idx < globbuf.gl_pathc; idx++){
                 wav = open_wav(globbuf.gl_pathv[idx]);
                 if(wav == NULL){
                     valid_files--;
@@ -403,9 +432,11 @@ int find_default_valid(char **filepaths){
                     if (wav->err_state != 0){
                         valid_files--;
                     }
-                    good_files.emplace_back(globbuf.gl_pathv[idx]);
+                    else{
+                        good_files.emplace_back(globbuf.gl_pathv[idx]);
+                    }
                 }
-                close_wav(&wav);
+                destroy_wav_obj(&wav);
             }
         }
         globfree(&globbuf);
@@ -433,35 +464,47 @@ wav_reader wav_reader_create_default(){
     wav->file_idx = 0;
     wav->itemsize = 1;
     wav->offsets = NULL;
+    wav->starts = NULL;
     wav->prefetch = 0;
     wav->read_as = ALL;//assume by default for now
     wav->sample_length = 0;
     wav->processed = 0;
+    wav->position = 0;
     wav->wavs = NULL;
+    wav->cache = NULL;
+    wav->prefetching = 0;
+    wav->starved = 0;
+    wav->underruns = 0;
+    pthread_mutex_init(&wav->wake_lock, NULL);
+    pthread_cond_init(&wav->wake, NULL);
+    pthread_cond_init(&wav->filled, NULL);
     char** filepaths = NULL;
     int file_count = find_default_valid(filepaths);
     load_files(filepaths,file_count,wav);
+    wav->itemsize = wav_reader_sample_bytes(wav);
+    wav_reader_build_index(wav);
+    char* cache_dir = getenv("WFGEN_AUDIO_CACHE");
+    if(cache_dir != NULL && wav->file_count > 0){
+        // canonical rate defaults to the first file's rate; the offsets
+        // must exist before attaching, it rewinds them
+        char* cache_rate = getenv("WFGEN_AUDIO_RATE");
+        uint32_t sample_rate = (cache_rate != NULL) ? strtoul(cache_rate, NULL, 10) : wav->wavs[0]->sample_rate;
+        if(wav_reader_attach_cache(wav, sample_rate, cache_dir) == 0 && getenv("WFGEN_AUDIO_CACHE_VERIFY") != NULL
+                && audio_cache_verify(wav->cache, wav->wavs, wav->file_count) != 0){
+            // same stat data but other contents, drop the stale cache and build again
+            unlink(wav->cache->path);
+            wav_reader_attach_cache(wav, sample_rate, cache_dir);
+        }
+    }
     wav->prefetch = 20000;
     wav->file_idx = 0;
-    wav->itemsize = wav_reader_sample_bytes(wav);
-    wav->sample_length = 0;
-    size_t byte_length = 0;
-    size_t bytes_per_sample = 1;
-    size_t sample_len = 0;
-    for(uint8_t idx = 0; idx < wav->file_count; idx++){
-        byte_length = wav->wavs[idx]->data_len;
-        bytes_per_sample = wav->wavs[idx]->block_align;
-        sample_len = byte_length/bytes_per_sample;
-        wav->sample_length += sample_len;
-    }
-    wav->offsets = (uint32_t*) malloc(file_count*sizeof(uint32_t));
-    memset(wav->offsets, 0, file_count*sizeof(uint32_t));
-    wav->buffer = cbufferf_create(wav->prefetch);
+    wav->buffer = spsc_ring_create(wav->prefetch*(wav->itemsize/sizeof(float)));
     wav_reader_fill_buffer(wav);
+    wav_reader_start_prefetch(wav);
     return wav;
 }
 
-wav_reader wav_reader_create(wav_mode_t mode, uint8_t file_count, char **filepaths, uint32_t prefetch){
+wav_reader wav_reader_create(wav_mode_t mode, uint32_t file_count, char **filepaths, uint32_t prefetch){
     if (!(mode == MONO || mode == STEREO)){
         return NULL;
     }
@@ -471,47 +514,101 @@ wav_reader wav_reader_create(wav_mode_t mode, uint8_t file_count, char **filepat
     wav->file_idx = 0;
     wav->itemsize = 1;
     wav->offsets = NULL;
+    wav->starts = NULL;
     wav->prefetch = 0;
     wav->read_as = ALL;//assume by default for now
     wav->sample_length = 0;
     wav->processed = 0;
+    wav->position = 0;
     wav->wavs = NULL;
+    wav->cache = NULL;
+    wav->prefetching = 0;
+    wav->starved = 0;
+    wav->underruns = 0;
+    pthread_mutex_init(&wav->wake_lock, NULL);
+    pthread_cond_init(&wav->wake, NULL);
+    pthread_cond_init(&wav->filled, NULL);
     load_files(filepaths,file_count,wav);
     wav->prefetch = prefetch;
     wav->file_idx = 0;
     wav->itemsize = wav_reader_sample_bytes(wav);
-    wav->sample_length = 0;
-    size_t byte_length = 0;
-    size_t bytes_per_sample = 1;
-    size_t sample_len = 0;
-    for(uint8_t idx = 0; idx < wav->file_count; idx++){
-        byte_length = wav->wavs[idx]->data_len;
-        bytes_per_sample = wav->wavs[idx]->block_align;
-        sample_len = byte_length/bytes_per_sample;
-        wav->sample_length += sample_len;
-    }
-    wav->offsets = (uint32_t*) malloc(file_count*sizeof(uint32_t));
-    memset(wav->offsets, 0, file_count*sizeof(uint32_t));
-    wav->buffer = cbufferf_create(wav->prefetch*(wav->itemsize/sizeof(float)));
+    wav_reader_build_index(wav);
+    wav->buffer = spsc_ring_create(wav->prefetch*(wav->itemsize/sizeof(float)));
     wav_reader_fill_buffer(wav);
+    wav_reader_start_prefetch(wav);
     return wav;
 }
 
 void wav_reader_destroy(wav_reader *wav){
     if (wav == NULL) return;
     if (*wav == NULL) return;
+    wav_reader_stop_prefetch(*wav);
     if ((*wav)->wavs != NULL){
-    for(int idx = 0; idx < (*wav)->file_count; idx++){
+    for(uint32_t idx = 0; idx < (*wav)->file_count; idx++){
             destroy_wav_obj(&((*wav)->wavs[idx]));
         }
         free((*wav)->wavs);
     }
     if ((*wav)->offsets != NULL) free((*wav)->offsets);
-    cbufferf_destroy((*wav)->buffer);
+    if ((*wav)->starts != NULL) free((*wav)->starts);
+    if ((*wav)->cache != NULL) audio_cache_destroy(&((*wav)->cache));
+    spsc_ring_destroy(&((*wav)->buffer));
+    pthread_mutex_destroy(&((*wav)->wake_lock));
+    pthread_cond_destroy(&((*wav)->wake));
+    pthread_cond_destroy(&((*wav)->filled));
     free((*wav));
     *wav = NULL;
 }
 
+int wav_reader_attach_cache(wav_reader wav, uint32_t sample_rate, const char *cache_dir){
+    // serve samples from a shared pre-decoded copy of the corpus at sample_rate
+    if(wav == NULL) return 1;
+    if(wav->file_count == 0 || sample_rate == 0) return 2;
+    audio_cache cache = audio_cache_open(wav->wavs, wav->file_count, sample_rate, cache_dir);
+    if(cache == NULL) return 3;
+    uint8_t restart = wav->prefetching;
+    wav_reader_stop_prefetch(wav);
+    if(wav->cache != NULL) audio_cache_destroy(&(wav->cache));
+    wav->cache = cache;
+    wav_reader_build_index(wav);// frame counts change with the cache rate
+    wav->file_idx = 0;
+    wav->position = 0;
+    if(wav->buffer != NULL){
+        spsc_ring_reset(wav->buffer);
+        wav_reader_fill_buffer(wav);
+    }
+    if(restart) wav_reader_start_prefetch(wav);
+    return 0;
+}
+
+uint64_t wav_reader_file_frames(wav_reader wav, uint32_t file_idx){
+    // number of stereo samples the reader produces from one file
+    if(wav == NULL || file_idx >= wav->file_count) return 0;
+    if(wav->cache != NULL) return audio_cache_file_frames(wav->cache, file_idx);
+    wav_obj file = wav->wavs[file_idx];
+    if(file == NULL || file->block_align == 0) return 0;
+    return file->data_len/file->block_align;
+}
+
+int wav_reader_build_index(wav_reader wav){
+    // (re)build the seek index: starts[i] is the first reader sample of file
+    // i and starts[file_count] the total, so seeking is a binary search and
+    // the current offset is one add
+    if(wav == NULL) return 1;
+    uint64_t *starts = (uint64_t*)realloc(wav->starts, (wav->file_count+1)*sizeof(uint64_t));
+    uint64_t *offsets = (uint64_t*)realloc(wav->offsets, (wav->file_count+1)*sizeof(uint64_t));
+    if(starts == NULL || offsets == NULL) return 2;
+    wav->starts = starts;
+    wav->offsets = offsets;
+    memset(wav->offsets, 0, (wav->file_count+1)*sizeof(uint64_t));
+    wav->starts[0] = 0;
+    for(uint32_t idx = 0; idx < wav->file_count; idx++){
+        wav->starts[idx+1] = wav->starts[idx] + wav_reader_file_frames(wav, idx);
+    }
+    wav->sample_length = wav->starts[wav->file_count];
+    return 0;
+}
+
 uint8_t wav_reader_sample_bytes(wav_reader wav){
     // how many bytes is a sample in the reader's internal buffer
     if(wav == NULL) return 0;
@@ -530,113 +627,214 @@ uint64_t wav_reader_fill_buffer(wav_reader wav){
         return 0;
         #endif
     }
+    if(wav->file_count == 0) return 0;
     uint64_t loaded = 0;
-    uint64_t floats_available = cbufferf_space_available(wav->buffer);//if read_as is ALL, then itemsize = 2*float
+    float *dst = NULL;
+    uint64_t floats_available = spsc_ring_write_ptr(wav->buffer, &dst);//if read_as is ALL, then itemsize = 2*float
     uint8_t scaler = wav->itemsize/sizeof(float);// sooo this should be 2 if read_as==ALL
     uint64_t samples_available = floats_available/scaler;
-    float sample[2];
-    // int count = 0;
-    uint64_t file_limit = wav->wavs[wav->file_idx]->data_len/wav->wavs[wav->file_idx]->block_align;
-    while(loaded < samples_available){
-        // index_wav produces stereo output no matter what format the file is
-        index_wav(wav->wavs[wav->file_idx], wav->offsets[wav->file_idx],1,sample);
-
-        cbufferf_push(wav->buffer,sample[0]);
-        cbufferf_push(wav->buffer,sample[1]);
-        wav->offsets[wav->file_idx]++;  // one more sample read
-        loaded++;                       // one more sample loaded
-        if(wav->offsets[wav->file_idx] == file_limit){
+    if(samples_available == 0) return 0;
+    // decode whole spans up to the end of the current file, then wrap to the
+    // next file; empty files are skipped, a corpus of only empty files stops
+    uint32_t empty_files = 0;
+    while(loaded < samples_available && empty_files < wav->file_count){
+        uint64_t file_limit = wav_reader_file_frames(wav, wav->file_idx);
+        uint64_t span = file_limit - wav->offsets[wav->file_idx];
+        if(span > samples_available - loaded) span = samples_available - loaded;
+        int decoded = 0;
+        if(span > 0 && wav->cache != NULL){
+            // already stereo float at the canonical rate
+            const float *frames = audio_cache_file_data(wav->cache, wav->file_idx);
+            memcpy(&dst[scaler*loaded], &frames[2*wav->offsets[wav->file_idx]], span*2*sizeof(float));
+            decoded = span;
+        }
+        else if(span > 0){
+            decoded = wav_decode_span(wav->wavs[wav->file_idx], (uint32_t)wav->offsets[wav->file_idx], span, &dst[scaler*loaded]);
+        }
+        if(decoded > 0){
+            empty_files = 0;
+            wav->offsets[wav->file_idx] += decoded;  // samples read
+            loaded += decoded;                       // samples loaded
+        }
+        else{
+            empty_files++;
+        }
+        if(decoded <= 0 || wav->offsets[wav->file_idx] >= file_limit){
             wav->file_idx++;
             if(wav->file_idx == wav->file_count) wav->file_idx = 0;
             wav->offsets[wav->file_idx] = 0;
             wav->itemsize = wav_reader_sample_bytes(wav); // at the moment this shouldn't change for any wav_file
         }
     }
+    spsc_ring_commit(wav->buffer, loaded*scaler);// decoded in place, publish in one go
     return loaded;
 }
 
+void* wav_reader_prefetch_loop(void* arg){
+    // keep the ring topped up; sleep while it is full until the consumer
+    // frees space (or a short timeout, in case a wake was missed)
+    wav_reader wav = (wav_reader)arg;
+    while(__atomic_load_n(&wav->prefetching, __ATOMIC_ACQUIRE)){
+        if(wav_reader_fill_buffer(wav) > 0){
+            // starved is set under the lock before the consumer looks again,
+            // so either it sees this fill or it is woken by it
+            if(__atomic_load_n(&wav->starved, __ATOMIC_SEQ_CST)){
+                pthread_mutex_lock(&wav->wake_lock);
+                pthread_cond_signal(&wav->filled);
+                pthread_mutex_unlock(&wav->wake_lock);
+            }
+            continue;
+        }
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += 2000000;
+        if(until.tv_nsec >= 1000000000){
+            until.tv_nsec -= 1000000000;
+            until.tv_sec++;
+        }
+        pthread_mutex_lock(&wav->wake_lock);
+        if(__atomic_load_n(&wav->prefetching, __ATOMIC_ACQUIRE)
+                && spsc_ring_space(wav->buffer) < (uint64_t)(wav->itemsize/sizeof(float))){
+            pthread_cond_timedwait(&wav->wake, &wav->wake_lock, &until);
+        }
+        pthread_mutex_unlock(&wav->wake_lock);
+    }
+    return NULL;
+}
+
+int wav_reader_start_prefetch(wav_reader wav){
+    // hand the producer side of the ring to a background thread
+    if(wav == NULL) return 1;
+    if(wav->prefetching) return 0;
+    if(wav->file_count == 0 || wav->buffer == NULL) return 2;
+    __atomic_store_n(&wav->prefetching, 1, __ATOMIC_RELEASE);
+    if(pthread_create(&wav->prefetcher, NULL, wav_reader_prefetch_loop, (void*)wav)){
+        __atomic_store_n(&wav->prefetching, 0, __ATOMIC_RELEASE);
+        return 3;
+    }
+    return 0;
+}
+
+int wav_reader_stop_prefetch(wav_reader wav){
+    // take the producer side back; the caller may fill/seek synchronously after
+    if(wav == NULL) return 1;
+    if(!wav->prefetching) return 0;
+    pthread_mutex_lock(&wav->wake_lock);
+    __atomic_store_n(&wav->prefetching, 0, __ATOMIC_RELEASE);
+    pthread_cond_signal(&wav->wake);
+    pthread_mutex_unlock(&wav->wake_lock);
+    pthread_join(wav->prefetcher, NULL);
+    return 0;
+}
+
 #ifdef __cplusplus
 uint64_t wav_reader_data_ptr(wav_reader wav, float* &ptr){
 #else
 uint64_t wav_reader_data_ptr(wav_reader wav, float* ptr){
 #endif
-    // set the ptr to where to read from, and return number of samples in buffer
-    uint64_t max_len = cbufferf_max_read(wav->buffer); // floats
-    uint32_t max_read = 0;
+    // set the ptr to where to read from, and return number of samples in
+    // buffer; 0 is an underrun, the caller goes on without audio
     uint8_t scaler = wav->itemsize/sizeof(float);
-    cbufferf_read(wav->buffer, max_len, &ptr, &max_read); // floats
+    uint64_t max_read = spsc_ring_read_ptr(wav->buffer, &ptr); // floats
+    if(max_read < scaler){
+        // only on start up or after a stall: either refill here or sleep
+        // until the prefetch thread publishes something, at most
+        // WAV_READER_WAIT_NS so a stalled disk cannot hold up the caller
+        if(!wav->prefetching){
+            wav_reader_fill_buffer(wav);
+        }
+        else{
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += WAV_READER_WAIT_NS;
+            if(until.tv_nsec >= 1000000000){
+                until.tv_nsec -= 1000000000;
+                until.tv_sec++;
+            }
+            pthread_mutex_lock(&wav->wake_lock);
+            __atomic_store_n(&wav->starved, 1, __ATOMIC_SEQ_CST);
+            while(spsc_ring_size(wav->buffer) < scaler && __atomic_load_n(&wav->prefetching, __ATOMIC_ACQUIRE)){
+                if(pthread_cond_timedwait(&wav->filled, &wav->wake_lock, &until)) break;
+            }
+            __atomic_store_n(&wav->starved, 0, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&wav->wake_lock);
+        }
+        max_read = spsc_ring_read_ptr(wav->buffer, &ptr);
+        if(max_read < scaler) wav->underruns++;
+    }
     return max_read/scaler; // samples
 }
 
 uint64_t wav_reader_advance(wav_reader wav, uint64_t samples){
     // set the ptr to where to read from, and return number of samples in buffer
     uint8_t scaler = wav->itemsize/sizeof(float);
-    if(cbufferf_release(wav->buffer,samples*scaler)){
-        return 0; // something went wrong, likeyl samples*scaler > buffer_max_size
+    if(spsc_ring_release(wav->buffer,samples*scaler)){
+        return 0; // something went wrong, likely samples*scaler > what was read
     }
     wav->processed += samples;
-    wav_reader_fill_buffer(wav);
+    wav->position += samples;
+    if(wav->sample_length > 0) wav->position %= wav->sample_length;
+    if(wav->prefetching){
+        pthread_cond_signal(&wav->wake);// refill happens off this thread
+    }
+    else{
+        wav_reader_fill_buffer(wav);
+    }
     return samples;
 }
 
 int wav_reader_set_offset(wav_reader wav, uint64_t offset){
     //set the offset in terms of samples held by the reader
     if(offset > wav->sample_length) return 1;
-    // printf("Requesting an offset of %lu with a maximum limit of %lu\t%lu/%lu\n",offset,wav->sample_length,offset,wav->sample_length);
-    memset(wav->offsets, 0, sizeof(uint32_t)*wav->file_count);
-    uint64_t filesize = 0;
-    // uint64_t decr = 0;
-    uint8_t fidx = 0;
+    if(wav->file_count == 0) return 2;
+    uint8_t restart = wav->prefetching;
+    wav_reader_stop_prefetch(wav); // the producer side is ours until the refill below
     uint8_t scaler = wav->itemsize / sizeof(float); // should allways be two for now
     assert(scaler == 2);
-    size_t byte_len;
-    size_t bytes_per_sample;
-    size_t sample_len;
-    while( offset > 0 ){
-        //// (A) number of data floats in the file : wav->wavs[fidx]->data_len
-        //// (B) bytes per sample in the data : wav->wavs[fidx]->block_align
-        //// (C) number of floats in a sample : 2
-        //// (D) number of samples in the file: A/B
-        byte_len = wav->wavs[fidx]->data_len;
-        bytes_per_sample = wav->wavs[fidx]->block_align;
-        sample_len = byte_len/bytes_per_sample;
-        filesize = sample_len;// number of samples
-        if(offset > filesize){
-            offset -= filesize;
-            // store in terms of float items
-            wav->offsets[fidx] = filesize;// num_samps
-            fidx++;
-        }
-        else{
-            wav->offsets[fidx] = offset;
-            offset = 0;
-        }
-    }
-    wav->file_idx = fidx;
-    cbufferf_reset(wav->buffer); // clear out any old cached buffer since it's out of date now
+    // last file starting at or before offset (skips past empty files)
+    uint32_t lo = 0, hi = wav->file_count - 1;
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo + 1)/2;
+        if(wav->starts[mid] <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+    wav->file_idx = lo;
+    wav->offsets[lo] = offset - wav->starts[lo];
+    wav->position = offset;
+    spsc_ring_reset(wav->buffer); // clear out any old cached buffer since it's out of date now
     wav_reader_fill_buffer(wav); // now fill it back up.
+    if(restart) wav_reader_start_prefetch(wav);
     return 0;
 }
 
+uint32_t wav_reader_set_offsets(wav_reader *readers, const uint64_t *offsets, uint32_t count){
+    // seek many readers at once (e.g. randomized starts for a batch of
+    // emitters); the refills run in parallel, returns the number that failed
+    if(readers == NULL || offsets == NULL) return count;
+    uint32_t failed = 0;
+    int64_t idx;
+    #pragma omp parallel for private(idx) schedule(dynamic) reduction(+:failed)
+    for(idx = 0; idx < (int64_t)count; idx++){
+        if(readers[idx] == NULL || wav_reader_set_offset(readers[idx], offsets[idx])) failed++;
+    }
+    return failed;
+}
+
 uint64_t wav_reader_get_len(wav_reader wav){
     // get the number of samples in the reader
     return wav->sample_length;
 }
 
 uint64_t wav_reader_get_offset(wav_reader wav){
-    // get offset in number of floats
-    uint64_t offset = 0;
-    // uint8_t scaler = wav->itemsize / sizeof(float);
-    for(uint8_t idx = 0; idx <= wav->file_idx; idx++){
-        // offset += (wav->offsets[idx] * scaler);
-        offset += wav->offsets[idx];
-    }
-    return offset;
+    // get offset in number of samples, the next one the consumer reads; the
+    // decode position is the prefetch thread's and runs ahead of it
+    if(wav->file_count == 0) return 0;
+    return wav->position;
 }
 
 uint64_t wav_reader_samples_processed(wav_reader wav){
     // This is the number of samples extracted by the reader into it's own buffer
     uint8_t scaler = wav->itemsize / sizeof(float);
-    return wav->processed + cbufferf_max_size(wav->buffer)/scaler;
+    return wav->processed + spsc_ring_capacity(wav->buffer)/scaler;
 }
 ///////WAV END
@@ -0,0 +1,164 @@
+#ifdef __cplusplus
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "burst_index.hh"
+
+#define BI_BOXES   3000
+#define BI_QUERIES 500
+
+static std::vector<burst_box_t> boxes;
+
+static double uniform(double lo, double hi){
+    return lo + (hi - lo)*rand()/(double)RAND_MAX;
+}
+
+// ids of boxes overlapping the query, by looking at every box
+static std::vector<uint64_t> brute_force(double t0, double t1, double f0, double f1){
+    std::vector<uint64_t> ids;
+    for(auto &b : boxes){
+        if(b.t0 < t1 && t0 < b.t1 && b.f0 < f1 && f0 < b.f1) ids.push_back(b.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+static int check_queries(burst_index bi){
+    std::vector<uint64_t> ids(BI_BOXES);
+    for(int q = 0; q < BI_QUERIES; q++){
+        double t0 = uniform(-1.0, 11.0), t1 = t0 + uniform(0.0, (q % 10) ? 0.5 : 5.0);
+        double f0 = uniform(-2e6, 2e6), f1 = f0 + uniform(0.0, 1e6);
+        uint64_t hits = burst_index_query(bi, t0, t1, f0, f1, ids.data(), ids.size());
+        std::vector<uint64_t> got(ids.begin(), ids.begin() + hits);
+        std::sort(got.begin(), got.end());
+        if(got != brute_force(t0, t1, f0, f1)) return q + 1;
+    }
+    // more hits than room for ids still counts them all
+    uint64_t few[4];
+    if(burst_index_query(bi, -1.0, 11.0, -3e6, 3e6, few, 4) != boxes.size()) return -1;
+    return 0;
+}
+
+static void add(burst_index bi, double t0){
+    burst_box_t b;
+    b.t0 = t0;
+    b.t1 = t0 + uniform(1e-4, (rand() % 50) ? 0.05 : 2.0);
+    double fc = uniform(-2e6, 2e6), bw = uniform(1e3, 2e5);
+    b.f0 = fc - 0.5*bw;
+    b.f1 = fc + 0.5*bw;
+    b.id = boxes.size();
+    boxes.push_back(b);
+    burst_index_add(bi, t0, b.t1 - t0, fc, bw, b.id);
+}
+
+int test_in_order(){
+    srand(1);
+    boxes.clear();
+    burst_index bi = burst_index_create(16);
+    double t = 0.0;
+    for(int i = 0; i < BI_BOXES; i++){
+        t += uniform(0.0, 0.006);
+        add(bi, t);
+        // queries in between the batches merge the new boxes in
+        int res = (i % 1000 == 999) ? check_queries(bi) : 0;
+        if(res){
+            burst_index_destroy(&bi);
+            return 1000*(i/1000 + 1) + res;
+        }
+    }
+    int res = check_queries(bi);
+    burst_index_destroy(&bi);
+    return res;
+}
+
+int test_out_of_order(){
+    srand(2);
+    boxes.clear();
+    burst_index bi = burst_index_create(0);
+    for(int batch = 0; batch < 6; batch++){
+        // each batch is spread over the whole span, so it lands before
+        // boxes already in the tree
+        for(int i = 0; i < BI_BOXES/6; i++) add(bi, uniform(0.0, 10.0));
+        int res = check_queries(bi);
+        if(res){
+            burst_index_destroy(&bi);
+            return 1000*(batch + 1) + res;
+        }
+    }
+    // sorted by start time after all that
+    for(uint64_t i = 1; i < burst_index_count(bi); i++){
+        if(burst_index_get(bi, i - 1)->t0 > burst_index_get(bi, i)->t0){
+            burst_index_destroy(&bi);
+            return -2;
+        }
+    }
+    burst_index_destroy(&bi);
+    return 0;
+}
+
+int test_save_load(){
+    srand(3);
+    boxes.clear();
+    burst_index bi = burst_index_create(0);
+    for(int i = 0; i < BI_BOXES; i++) add(bi, uniform(0.0, 10.0));
+    char path[] = "/tmp/test_burst_index_XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0) return 1;
+    close(fd);
+    int res = 0;
+    if(burst_index_save(bi, path)) res = 2;
+    burst_index loaded = (res) ? NULL : burst_index_load(path);
+    unlink(path);
+    if(res == 0 && loaded == NULL) res = 3;
+    if(res == 0 && burst_index_count(loaded) != burst_index_count(bi)) res = 4;
+    for(uint64_t i = 0; res == 0 && i < burst_index_count(bi); i++){
+        const burst_box_t *a = burst_index_get(bi, i), *b = burst_index_get(loaded, i);
+        if(memcmp(a, b, sizeof(burst_box_t))) res = 5;
+    }
+    if(res == 0 && check_queries(loaded)) res = 6;
+    burst_index_destroy(&bi);
+    burst_index_destroy(&loaded);
+    return res;
+}
+
+int test_empty(){
+    burst_index bi = burst_index_create(0);
+    uint64_t id;
+    int res = (burst_index_query(bi, 0.0, 1.0, -1.0, 1.0, &id, 1) != 0);
+    res += 2*(burst_index_get(bi, 0) != NULL);
+    burst_index_destroy(&bi);
+    res += 4*(bi != NULL);
+    return res;
+}
+
+int main(){
+    int res=0;
+    if((res+=test_empty())){
+        printf("Test Burst Index Empty -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Burst Index Empty -- Passed\n");
+    }
+    if((res+=test_in_order())){
+        printf("Test Burst Index In Order -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Burst Index In Order -- Passed\n");
+    }
+    if((res+=test_out_of_order())){
+        printf("Test Burst Index Out Of Order -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Burst Index Out Of Order -- Passed\n");
+    }
+    if((res+=test_save_load())){
+        printf("Test Burst Index Save Load -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Burst Index Save Load -- Passed\n");
+    }
+    return res;
+}
+#endif
@@ -0,0 +1,105 @@
+#ifdef __cplusplus
+#include <stdio.h>
+#include <vector>
+#include "iq_gain.hh"
+
+#define IQ_LEN 1001         // odd, so no loop ends on a whole vector
+
+int test_peak(){
+    std::vector<liquid_float_complex> x(IQ_LEN, liquid_float_complex(0.1f, -0.1f));
+    if(iq_peak(x.data(), 0, 0.0f) != 0.0f) return 1;
+    if(iq_peak(x.data(), IQ_LEN, 0.0f) != 0.1f) return 2;
+    // the largest |I| or |Q| of either sign, wherever it is
+    x[IQ_LEN-1] = liquid_float_complex(0.2f, -0.7f);
+    if(iq_peak(x.data(), IQ_LEN, 0.0f) != 0.7f) return 3;
+    x[IQ_LEN/2] = liquid_float_complex(-0.9f, 0.0f);
+    if(iq_peak(x.data(), IQ_LEN, 0.0f) != 0.9f) return 4;
+    // a larger running peak carries through, a smaller one does not
+    if(iq_peak(x.data(), IQ_LEN, 2.0f) != 2.0f) return 5;
+    if(iq_peak(x.data(), IQ_LEN/2, 0.5f) != 0.5f) return 6;
+    return 0;
+}
+
+int test_gain(){
+    if(iq_gain(0.0f, 0.5f) != 1.0f) return 1;// silence is left alone
+    if(iq_gain(2.0f, 0.5f) != 0.25f) return 2;
+    if(iq_gain(0.25f, 1.0f) != 4.0f) return 3;
+    // the peak lands on the level
+    float peak = 0.37f, level = 0.8f;
+    if(fabsf(iq_gain(peak, level)*peak - level) > 1e-6f) return 4;
+    return 0;
+}
+
+int test_scale(){
+    std::vector<liquid_float_complex> x(IQ_LEN);
+    for(int i = 0; i < IQ_LEN; i++){
+        float v = (float)(i - IQ_LEN/2)/(IQ_LEN/2);// -1 to 1
+        x[i] = liquid_float_complex(v, -0.5f*v);
+    }
+    std::vector<int16_t> y(2*IQ_LEN);
+    iq_to_sc16(x.data(), IQ_LEN, 1.0f, y.data());
+    for(int i = 0; i < IQ_LEN; i++){
+        if(y[2*i]   != (int16_t)lrintf(x[i].real()*IQ_SC16_FULL_SCALE)) return 1;
+        if(y[2*i+1] != (int16_t)lrintf(x[i].imag()*IQ_SC16_FULL_SCALE)) return 2;
+    }
+    if(y[0] != -32767 || y[2*(IQ_LEN-1)] != 32767 || y[IQ_LEN-1] != 0) return 3;
+    // a gain from the peak fills the level without clipping
+    float gain = iq_gain(iq_peak(x.data(), IQ_LEN, 0.0f), 0.5f);
+    iq_to_sc16(x.data(), IQ_LEN, gain, y.data());
+    for(int i = 0; i < 2*IQ_LEN; i++){
+        if(abs(y[i]) > 16384) return 4;
+    }
+    if(y[2*(IQ_LEN-1)] != 16384) return 5;// rounds 16383.5 to even
+    return 0;
+}
+
+int test_clip(){
+    // past full scale saturates instead of wrapping round
+    liquid_float_complex x[4] = {
+        liquid_float_complex(1.5f, -1.5f),
+        liquid_float_complex(1e9f, -1e9f),
+        liquid_float_complex(1.0f, -1.0f),
+        liquid_float_complex(0.99999f, -0.99999f),
+    };
+    int16_t y[8];
+    iq_to_sc16(x, 4, 1.0f, y);
+    for(int i = 0; i < 6; i += 2){
+        if(y[i] != 32767 || y[i+1] != -32767) return 1 + i/2;
+    }
+    if(y[6] != 32767 || y[7] != -32767) return 4;
+    iq_to_sc16(x, 1, 100.0f, y);
+    if(y[0] != 32767 || y[1] != -32767) return 5;
+    iq_to_sc16(x, 1, 0.0f, y);
+    if(y[0] != 0 || y[1] != 0) return 6;
+    return 0;
+}
+
+int main(){
+    int res=0;
+    if((res+=test_peak())){
+        printf("Test IQ Peak -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test IQ Peak -- Passed\n");
+    }
+    if((res+=test_gain())){
+        printf("Test IQ Gain -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test IQ Gain -- Passed\n");
+    }
+    if((res+=test_scale())){
+        printf("Test IQ SC16 Scale -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test IQ SC16 Scale -- Passed\n");
+    }
+    if((res+=test_clip())){
+        printf("Test IQ SC16 Clip -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test IQ SC16 Clip -- Passed\n");
+    }
+    return res;
+}
+#endif
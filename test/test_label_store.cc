@@ -0,0 +1,166 @@
+#ifdef __cplusplus
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "label_store.hh"
+
+#define LS_BLOCK   100      // records per block, small so there are many
+#define LS_RECORDS 1050     // ends in a part filled block
+
+static const char *ls_meta[] = {"", "burst a", "burst a", "burst b", "", "burst a"};
+#define LS_META_LEN (sizeof(ls_meta)/sizeof(ls_meta[0]))
+
+static int make_path(char *path){
+    int fd = mkstemp(path);
+    if(fd < 0) return 1;
+    close(fd);
+    return 0;
+}
+
+static int write_records(const char *path){
+    label_writer w = label_writer_create(path, LS_BLOCK);
+    if(w == NULL) return 1;
+    for(int i = 0; i < LS_RECORDS; i++){
+        // meta repeats in runs and comes back after another string
+        const char *meta = ls_meta[(i/7) % LS_META_LEN];
+        if(label_writer_append(w, 0.001*i, 1e-4*(i % 13 + 1), 1e3*i - 5e5, 2e4 + i,
+                (i % 5) ? (uint16_t)(i % 5) : LABEL_STORE_MOD_UNSET, meta)){
+            label_writer_destroy(&w);
+            return 2;
+        }
+    }
+    label_writer_set_attr(w, "signal", "GT SIG 0000042");
+    label_writer_set_attr(w, "protocol", "first");
+    label_writer_set_attr(w, "protocol", "second");
+    label_writer_set_attr(w, "empty", NULL);
+    label_writer_destroy(&w);
+    return (w != NULL) ? 3 : 0;
+}
+
+static int check_record(label_reader r, int i){
+    label_record_t rec;
+    if(label_reader_get(r, i, &rec)) return 1;
+    if(rec.t0 != 0.001*i || rec.dur != 1e-4*(i % 13 + 1)) return 2;
+    if(rec.fc != 1e3*i - 5e5 || rec.bw != 2e4 + i) return 3;
+    if(rec.mod != ((i % 5) ? (uint16_t)(i % 5) : LABEL_STORE_MOD_UNSET)) return 4;
+    if(strcmp(rec.meta, ls_meta[(i/7) % LS_META_LEN])) return 5;
+    return 0;
+}
+
+int test_round_trip(){
+    char path[] = "/tmp/test_label_store_XXXXXX";
+    if(make_path(path)) return 1;
+    int res = 10*write_records(path);
+    label_reader r = (res) ? NULL : label_reader_open(path);
+    unlink(path);
+    if(res) return res;
+    if(r == NULL) return 2;
+    if(label_reader_count(r) != LS_RECORDS) res = 3;
+    else if(label_reader_num_blocks(r) != (LS_RECORDS + LS_BLOCK - 1)/LS_BLOCK) res = 4;
+    for(int i = 0; res == 0 && i < LS_RECORDS; i++){
+        int rc = check_record(r, i);
+        if(rc) res = 100 + rc;
+    }
+    // the columns of a block line up with the records
+    const label_block_t *b = label_reader_block(r, 3);
+    if(res == 0 && (b == NULL || b->first != 3*LS_BLOCK || b->count != LS_BLOCK)) res = 5;
+    if(res == 0 && (b->t0[7] != 0.001*(3*LS_BLOCK + 7) || b->bw[7] != 2e4 + 3*LS_BLOCK + 7)) res = 6;
+    if(res == 0 && label_reader_block(r, label_reader_num_blocks(r)) != NULL) res = 7;
+    label_record_t rec;
+    if(res == 0 && label_reader_get(r, LS_RECORDS, &rec) == 0) res = 8;
+    // attributes, the last one set wins
+    const char *value = label_reader_attr(r, "protocol");
+    if(res == 0 && (value == NULL || strcmp(value, "second"))) res = 9;
+    value = label_reader_attr(r, "signal");
+    if(res == 0 && (value == NULL || strcmp(value, "GT SIG 0000042"))) res = 10;
+    value = label_reader_attr(r, "empty");
+    if(res == 0 && (value == NULL || value[0] != '\0')) res = 11;
+    if(res == 0 && label_reader_attr(r, "missing") != NULL) res = 12;
+    label_reader_destroy(&r);
+    if(r != NULL) res = 13;
+    return res;
+}
+
+int test_truncated(){
+    // a file cut short in the middle of a block keeps the blocks before it
+    char path[] = "/tmp/test_label_store_XXXXXX";
+    if(make_path(path)) return 1;
+    int res = 10*write_records(path);
+    FILE *fid = (res) ? NULL : fopen(path, "rb");
+    if(res == 0 && fid == NULL) res = 2;
+    // walk the block headers to the sixth record block, cut it in half
+    size_t cut = sizeof(label_store_header_t);
+    long len = 0;
+    if(res == 0){
+        fseek(fid, 0, SEEK_END);
+        len = ftell(fid);
+        int records = 0;
+        label_block_header_t h;
+        while(fseek(fid, cut, SEEK_SET) == 0 && fread(&h, sizeof(h), 1, fid) == 1){
+            if(h.kind == LABEL_BLOCK_RECORDS && ++records == 6){
+                cut += sizeof(h) + h.bytes/2;
+                break;
+            }
+            cut += sizeof(h) + h.bytes;
+        }
+        fclose(fid);
+        if(records != 6) res = 3;
+    }
+    if(res == 0 && (long)cut >= len) res = 4;
+    if(res == 0 && truncate(path, cut)) res = 5;
+    label_reader r = (res) ? NULL : label_reader_open(path);
+    unlink(path);
+    if(res) return res;
+    if(r == NULL) return 6;
+    if(label_reader_count(r) != 5*LS_BLOCK) res = 7;
+    for(int i = 0; res == 0 && i < 5*LS_BLOCK; i++){
+        int rc = check_record(r, i);
+        if(rc) res = 100 + rc;
+    }
+    if(res == 0 && label_reader_attr(r, "signal") != NULL) res = 8;
+    label_reader_destroy(&r);
+    return res;
+}
+
+int test_empty(){
+    char path[] = "/tmp/test_label_store_XXXXXX";
+    if(make_path(path)) return 1;
+    label_writer w = label_writer_create(path, 0);
+    if(w == NULL){
+        unlink(path);
+        return 2;
+    }
+    label_writer_destroy(&w);
+    label_reader r = label_reader_open(path);
+    unlink(path);
+    if(r == NULL) return 3;
+    label_record_t rec;
+    int res = (label_reader_count(r) != 0 || label_reader_num_blocks(r) != 0) ? 4 : 0;
+    if(res == 0 && label_reader_get(r, 0, &rec) == 0) res = 5;
+    label_reader_destroy(&r);
+    return res;
+}
+
+int main(){
+    int res=0;
+    if((res+=test_round_trip())){
+        printf("Test Label Store Round Trip -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Label Store Round Trip -- Passed\n");
+    }
+    if((res+=test_truncated())){
+        printf("Test Label Store Truncated -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Label Store Truncated -- Passed\n");
+    }
+    if((res+=test_empty())){
+        printf("Test Label Store Empty -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Label Store Empty -- Passed\n");
+    }
+    return res;
+}
+#endif
@@ -0,0 +1,108 @@
+#ifdef __cplusplus
+#include <stdio.h>
+#include <string>
+#include "modulation.hh"
+#include "name_hash.hh"
+
+struct name_entry_s{
+    const char *name;
+    int value;
+};
+
+// "b" and "" come back later on, the first entry must keep the name
+static constexpr name_entry_s name_entries[] = {
+    {"a", 0}, {"b", 1}, {"", 2}, {"ab", 3}, {"b", 4}, {"ba", 5}, {"", 6}, {"abc", 7},
+};
+
+static constexpr auto name_entry_table = name_hash::make_table<32>(name_entries, &name_entry_s::name);
+
+static const char *unknown_names[] = {"c", "aa", "abcd", "A", "b ", " b", "unknown_name", "qpsk\n"};
+#define UNKNOWN_NAMES_LEN (sizeof(unknown_names)/sizeof(unknown_names[0]))
+
+// first entry of a table named s, as the linear scans did it
+template<class T>
+int first_named(const T *items, size_t num, const char * const T::*field, const char *s){
+    for(size_t i = 0; i < num; i++){
+        if(strcmp(items[i].*field, s) == 0) return (int)i;
+    }
+    return -1;
+}
+
+int test_table(){
+    size_t num = sizeof(name_entries)/sizeof(name_entries[0]);
+    for(size_t i = 0; i < num; i++){
+        int idx = name_entry_table.find(name_entries[i].name);
+        if(idx != first_named(name_entries, num, &name_entry_s::name, name_entries[i].name)) return 1;
+    }
+    if(name_entry_table.find("b") != 1 || name_entry_table.find("") != 2) return 2;
+    for(size_t i = 0; i < UNKNOWN_NAMES_LEN; i++){
+        if(name_entry_table.find(unknown_names[i]) != -1) return 3;
+    }
+    return 0;
+}
+
+int test_lookups(){
+    // every name of the scheme tables finds its first entry
+    for(unsigned int i = 0; i < FSK_TYPE_COUNT; i++){
+        if(fsk_type_lookup(fsk_types[i].name) != first_named(fsk_types, FSK_TYPE_COUNT, &fsk_type_s::name, fsk_types[i].name)) return 1;
+    }
+    for(unsigned int i = 0; i < ANALOG_TYPE_COUNT; i++){
+        if(analog_type_lookup(analog_types[i].name) != (int)i) return 2;
+    }
+    for(unsigned int i = 0; i < noise_type_count; i++){
+        if(noise_type_lookup(noise_types[i].name) != (int)i) return 3;
+    }
+    for(size_t i = 0; i < UNKNOWN_NAMES_LEN; i++){
+        if(fsk_type_lookup(unknown_names[i]) != -1) return 4;
+        if(analog_type_lookup(unknown_names[i]) != -1) return 5;
+        if(noise_type_lookup(unknown_names[i]) != -1) return 6;
+    }
+    if(fsk_type_lookup("") != -1) return 7;
+    return 0;
+}
+
+int test_labels(){
+    // every label finds its own entry and an unknown label maps to the
+    // closing "unknown" entry
+    for(unsigned int i = 0; i < SIGNAL_MODULATION_LIST_LEN; i++){
+        const char *label = signal_modulation_list[i].name_label;
+        int first = first_named(signal_modulation_list, SIGNAL_MODULATION_LIST_LEN, &signal_modulation_s::name_label, label);
+        if(signal_modulation_map_label_to_index(label) != (unsigned int)first) return 1;
+    }
+    for(size_t i = 0; i < UNKNOWN_NAMES_LEN; i++){
+        if(signal_modulation_map_label_to_index(unknown_names[i]) != SIGNAL_MODULATION_LIST_LEN-1) return 2;
+    }
+    // the scheme maps land on an entry of that scheme
+    for(unsigned int i = 0; i < SIGNAL_MODULATION_LIST_LEN; i++){
+        const signal_modulation_s &m = signal_modulation_list[i];
+        if(m.scheme != LIQUID_MODEM_UNKNOWN &&
+           signal_modulation_list[signal_modulation_map_ms_to_index(m.scheme)].scheme != m.scheme) return 3;
+        if(m.f_scheme != LIQUID_FSK_UNKNOWN &&
+           signal_modulation_list[signal_modulation_map_msf_to_index(m.f_scheme)].f_scheme != m.f_scheme) return 4;
+    }
+    return 0;
+}
+
+int main(){
+    int res=0;
+    if((res+=test_table())){
+        printf("Test Name Hash Table -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Name Hash Table -- Passed\n");
+    }
+    if((res+=test_lookups())){
+        printf("Test Name Hash Lookups -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Name Hash Lookups -- Passed\n");
+    }
+    if((res+=test_labels())){
+        printf("Test Name Hash Labels -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Name Hash Labels -- Passed\n");
+    }
+    return res;
+}
+#endif
@@ -0,0 +1,153 @@
+#ifdef __cplusplus
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "spsc_ring.hh"
+
+#define RING_FLOATS 1000        // rounded up to whole pages by the ring
+#define RING_TOTAL  (1 << 20)   // floats pushed through in the threaded test
+
+int test_capacity(){
+    spsc_ring ring = spsc_ring_create(RING_FLOATS);
+    if(ring == NULL) return 1;
+    uint64_t capacity = spsc_ring_capacity(ring);
+    int res = 0;
+    if(capacity < RING_FLOATS || (capacity & (capacity - 1))) res = 2;
+    else if(spsc_ring_size(ring) != 0 || spsc_ring_space(ring) != capacity) res = 3;
+    spsc_ring_destroy(&ring);
+    if(ring != NULL) res = 4;
+    return res;
+}
+
+int test_wraparound(){
+    // odd sized writes and reads walk the start of the data round the ring
+    // many times; every readable span must be contiguous and in order
+    spsc_ring ring = spsc_ring_create(RING_FLOATS);
+    if(ring == NULL) return 1;
+    uint64_t capacity = spsc_ring_capacity(ring);
+    float next_in = 0.0f, next_out = 0.0f;
+    float *ptr;
+    for(int round = 0; round < 2000; round++){
+        uint64_t n = spsc_ring_write_ptr(ring, &ptr);
+        if(n != spsc_ring_space(ring)){
+            spsc_ring_destroy(&ring);
+            return 2;
+        }
+        uint64_t want = (round*337) % (capacity/2) + 1;
+        if(want > n) want = n;
+        for(uint64_t i = 0; i < want; i++) ptr[i] = next_in++;
+        if(spsc_ring_commit(ring, want)){
+            spsc_ring_destroy(&ring);
+            return 3;
+        }
+        uint64_t have = spsc_ring_read_ptr(ring, &ptr);
+        uint64_t take = (round*211) % have + 1;
+        for(uint64_t i = 0; i < take; i++){
+            if(ptr[i] != next_out++){
+                spsc_ring_destroy(&ring);
+                return 4;
+            }
+        }
+        if(spsc_ring_release(ring, take)){
+            spsc_ring_destroy(&ring);
+            return 5;
+        }
+    }
+    int res = (next_in < 4.0f*capacity) ? 6 : 0;// went round a few times
+    spsc_ring_destroy(&ring);
+    return res;
+}
+
+int test_limits(){
+    // no committing past the free space or releasing past the data
+    spsc_ring ring = spsc_ring_create(RING_FLOATS);
+    if(ring == NULL) return 1;
+    uint64_t capacity = spsc_ring_capacity(ring);
+    float *ptr;
+    int res = 0;
+    spsc_ring_write_ptr(ring, &ptr);
+    if(spsc_ring_commit(ring, capacity + 1) == 0) res = 2;
+    else if(spsc_ring_commit(ring, capacity)) res = 3;
+    else if(spsc_ring_space(ring) != 0) res = 4;
+    else if(spsc_ring_release(ring, capacity + 1) == 0) res = 5;
+    else if(spsc_ring_release(ring, capacity)) res = 6;
+    else if(spsc_ring_size(ring) != 0) res = 7;
+    spsc_ring_reset(ring);
+    if(res == 0 && spsc_ring_read_ptr(ring, &ptr) != 0) res = 8;
+    spsc_ring_destroy(&ring);
+    return res;
+}
+
+static void* ring_producer(void *arg){
+    spsc_ring ring = (spsc_ring)arg;
+    float value = 0.0f;
+    uint64_t sent = 0;
+    float *ptr;
+    while(sent < RING_TOTAL){
+        uint64_t n = spsc_ring_write_ptr(ring, &ptr);
+        if(n > RING_TOTAL - sent) n = RING_TOTAL - sent;
+        if(n > 777) n = 777;
+        if(n == 0) sched_yield();// full, let the consumer run
+        for(uint64_t i = 0; i < n; i++) ptr[i] = value++;
+        spsc_ring_commit(ring, n);
+        sent += n;
+    }
+    return NULL;
+}
+
+int test_threads(){
+    spsc_ring ring = spsc_ring_create(RING_FLOATS);
+    if(ring == NULL) return 1;
+    pthread_t producer;
+    if(pthread_create(&producer, NULL, ring_producer, ring)){
+        spsc_ring_destroy(&ring);
+        return 2;
+    }
+    int res = 0;
+    float expect = 0.0f;
+    uint64_t received = 0;
+    float *ptr;
+    while(received < RING_TOTAL){
+        uint64_t n = spsc_ring_read_ptr(ring, &ptr);
+        if(n == 0) sched_yield();// empty, let the producer run
+        for(uint64_t i = 0; i < n && res == 0; i++){
+            // floats count exactly up to 2^24
+            if(ptr[i] != expect++) res = 3;
+        }
+        spsc_ring_release(ring, n);
+        received += n;// drain even after a mismatch, the producer waits on us
+    }
+    pthread_join(producer, NULL);
+    spsc_ring_destroy(&ring);
+    return res;
+}
+
+int main(){
+    int res=0;
+    if((res+=test_capacity())){
+        printf("Test Ring Capacity -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Ring Capacity -- Passed\n");
+    }
+    if((res+=test_wraparound())){
+        printf("Test Ring Wraparound -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Ring Wraparound -- Passed\n");
+    }
+    if((res+=test_limits())){
+        printf("Test Ring Limits -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Ring Limits -- Passed\n");
+    }
+    if((res+=test_threads())){
+        printf("Test Ring Threads -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Ring Threads -- Passed\n");
+    }
+    return res;
+}
+#endif
@@ -0,0 +1,115 @@
+#ifdef __cplusplus
+#include <stdio.h>
+#include <complex>
+#include <vector>
+#include "generator.hh"
+
+using namespace wfgen::generators;
+
+#define WARM_PRIME 1000     // samples written before the snapshot
+#define WARM_LEN   4096     // samples compared after it
+
+// what a stream writes after restoring s, which must match what it wrote
+// the first time from that point
+template<class API>
+int check_replay(stream<API> & gen, stream<API> & other){
+    std::vector<std::complex<float> > a(WARM_LEN), b(WARM_LEN), c(WARM_LEN);
+    gen.set_gain(0.5f);
+    other.set_gain(0.5f);
+    if(gen.write(a.data(), WARM_PRIME)) return 1;
+    warm_start<API> s(gen);
+    if(gen.write(a.data(), WARM_LEN)) return 2;
+    s.restore(gen);
+    if(gen.write(b.data(), WARM_LEN)) return 3;
+    s.restore(other);
+    if(other.write(c.data(), WARM_LEN)) return 4;
+    for(unsigned int idx = 0; idx < WARM_LEN; idx++){
+        if(a[idx] != b[idx]) return 5;
+        if(a[idx] != c[idx]) return 6;
+    }
+    return 0;
+}
+
+int test_fsk_replay(){
+    fsk_generator gen(symstreamrfcf_create_fsk(LIQUID_FIRFILT_ARKAISER, 4, 0.5f, 12, 0.2f, 0.35f,
+        LIQUID_CPFSK_SQUARE, LIQUID_MODEM_CPFSK4));
+    fsk_generator other(symstreamrfcf_create_fsk(LIQUID_FIRFILT_ARKAISER, 4, 0.5f, 12, 0.2f, 0.35f,
+        LIQUID_CPFSK_SQUARE, LIQUID_MODEM_CPFSK4));
+    symstreamrfcf_set_seed(gen.get(), 1234);
+    symstreamrfcf_set_seed(other.get(), 99);// the snapshot's seed wins
+    return check_replay(gen, other);
+}
+
+int test_noise_replay(){
+    noise_generator gen(symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, 0.2f, 12, 0.25f, LIQUID_NOISE_AWGN));
+    noise_generator other(symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, 0.2f, 12, 0.25f, LIQUID_NOISE_AWGN));
+    symstreamrncf_set_seed(gen.get(), 1234);
+    return check_replay(gen, other);
+}
+
+int test_noise_seeded(){
+    // two streams of one seed write the same noise, another seed does not
+    noise_generator a(symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, 0.2f, 12, 0.25f, LIQUID_NOISE_AWGN));
+    noise_generator b(symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, 0.2f, 12, 0.25f, LIQUID_NOISE_AWGN));
+    noise_generator c(symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, 0.2f, 12, 0.25f, LIQUID_NOISE_AWGN));
+    symstreamrncf_set_seed(a.get(), 7);
+    symstreamrncf_set_seed(b.get(), 7);
+    symstreamrncf_set_seed(c.get(), 8);
+    std::vector<std::complex<float> > x(WARM_LEN), y(WARM_LEN), z(WARM_LEN);
+    a.write(x.data(), WARM_LEN);
+    b.write(y.data(), WARM_LEN);
+    c.write(z.data(), WARM_LEN);
+    if(x != y) return 1;
+    if(x == z) return 2;
+    return 0;
+}
+
+int test_mismatch_rejected(){
+    // a snapshot of a narrower stream has a longer buffer and another
+    // resampler, it must not be restored
+    noise_generator narrow(symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, 0.01f, 12, 0.25f, LIQUID_NOISE_AWGN));
+    noise_generator wide(symstreamrncf_create_noise(LIQUID_FIRFILT_ARKAISER, 0.2f, 12, 0.25f, LIQUID_NOISE_AWGN));
+    std::vector<std::complex<float> > x(WARM_LEN);
+    narrow.write(x.data(), WARM_LEN);
+    symstreamrncf_state s = symstreamrncf_snapshot(narrow.get());
+    int res = (symstreamrncf_restore(wide.get(), s) == LIQUID_OK);
+    symstreamrncf_state_destroy(s);
+    fsk_generator f2(symstreamrfcf_create_fsk(LIQUID_FIRFILT_ARKAISER, 4, 0.5f, 12, 0.2f, 0.35f,
+        LIQUID_CPFSK_SQUARE, LIQUID_MODEM_CPFSK4));
+    fsk_generator f1(symstreamrfcf_create_fsk(LIQUID_FIRFILT_ARKAISER, 4, 0.5f, 12, 0.05f, 0.35f,
+        LIQUID_CPFSK_SQUARE, LIQUID_MODEM_CPFSK4));
+    symstreamrfcf_state t = symstreamrfcf_snapshot(f1.get());
+    res += 2*(symstreamrfcf_restore(f2.get(), t) == LIQUID_OK);
+    symstreamrfcf_state_destroy(t);
+    return res;
+}
+
+int main(){
+    int res=0;
+    if((res+=test_fsk_replay())){
+        printf("Test FSK Snapshot Replay -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test FSK Snapshot Replay -- Passed\n");
+    }
+    if((res+=test_noise_replay())){
+        printf("Test Noise Snapshot Replay -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Noise Snapshot Replay -- Passed\n");
+    }
+    if((res+=test_noise_seeded())){
+        printf("Test Noise Seeded -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Noise Seeded -- Passed\n");
+    }
+    if((res+=test_mismatch_rejected())){
+        printf("Test Snapshot Mismatch Rejected -- Failed(%d)\n",res);
+    }
+    else{
+        printf("Test Snapshot Mismatch Rejected -- Passed\n");
+    }
+    return res;
+}
+#endif